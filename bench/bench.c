@@ -0,0 +1,350 @@
+/*
+ *  freakyfetch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// end-to-end latency harness run by `make bench`: every scenario runs freakyfetch (or get_info() in a child) many
+// times and reports the wall time percentiles and peak RSS, then one more traced run gives the forks and system calls.
+// the numbers are compared to a stored baseline, exceeding it by more than the margin is a failure.
+// HOME and XDG_RUNTIME_DIR point to a scratch directory, so the user cache is under control, but a running daemon or
+// the host cache published by root are still used: run it as a regular user without freakyfetchd for cold numbers.
+
+#define _GNU_SOURCE // for CLONE_THREAD
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+  #include <sys/ptrace.h>
+  #include <sys/resource.h>
+  #include <sys/stat.h>
+  #include <sys/syscall.h>
+  #include <sys/wait.h>
+#endif
+
+#include "../fetch.h"
+
+#ifdef __linux__
+  #define MAX_RUNS 100000
+
+static struct scenario {
+  const char* name;
+  bool library;        // get_info() in a child instead of freakyfetch
+  bool cold;           // the cache files are removed before every run
+  bool all_off;        // every field disabled
+  const char* args[3]; // freakyfetch arguments
+} scenarios[] = {
+    {"cold", false, true, false, {NULL}},
+    {"ascii", false, false, false, {NULL}},
+    {"read-cache", false, false, false, {"-r", NULL}},
+    {"write-cache", false, false, false, {"-w", NULL}},
+    {"image", false, false, false, {"-i", "res/freaky.png", NULL}},
+    {"flags-off", false, false, true, {NULL}},
+    {"get_info", true, false, false, {NULL}},
+    {"get_info-off", true, false, true, {NULL}},
+};
+
+// what one scenario measured, times in microseconds, -1 if not known
+struct result {
+  long long p50, p95, p99;
+  long forks, syscalls, rss_kb;
+};
+
+static char scratch[64] = "/tmp/freakyfetch-bench-XXXXXX", off_config[128];
+static const char* freakyfetch;
+
+static long long now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void remove_cache_files(void) {
+  const char* files[] = {"freakyfetch.cache", "freakyfetch.pciids", "freakyfetch.motd"};
+  char path[256];
+  for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+    snprintf(path, sizeof(path), "%s/.cache/%s", scratch, files[i]);
+    unlink(path);
+  }
+}
+
+static int remove_entry(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+  (void)st, (void)type, (void)ftw;
+  return remove(path);
+}
+
+static bool make_scratch(void) {
+  char path[128];
+  if (!mkdtemp(scratch)) return false;
+  snprintf(path, sizeof(path), "%s/.cache", scratch);
+  snprintf(off_config, sizeof(off_config), "%s/off.config", scratch);
+  FILE* config = fopen(off_config, "w");
+  if (mkdir(path, 0700) != 0 || !config) return false;
+  fputs("user=false\nos=false\nhost=false\nkernel=false\ncpu=false\ngpus=false\nram=false\nresolution=false\n"
+        "shell=false\npkgs=false\nuptime=false\ncolors=false\n",
+        config);
+  fclose(config);
+  setenv("HOME", scratch, 1);
+  setenv("XDG_RUNTIME_DIR", scratch, 1);
+  return true;
+}
+
+// the child side of a run, never returns
+static void run_child(const struct scenario* scenario, bool traced) {
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (null_fd >= 0) dup2(null_fd, STDOUT_FILENO);
+  if (traced) {
+    ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+    raise(SIGSTOP); // waits for the tracer to set its options
+  }
+  if (scenario->library) {
+    struct info* user_info = malloc(sizeof(*user_info));
+    struct flags flags;
+    memset(&flags, !scenario->all_off, sizeof(flags));
+    if (user_info) {
+      init_info(user_info);
+      get_info(flags, user_info);
+    }
+    _exit(user_info ? 0 : 1);
+  }
+  const char* argv[8] = {freakyfetch};
+  int argc            = 1;
+  for (int i = 0; scenario->args[i]; i++) argv[argc++] = scenario->args[i];
+  if (scenario->all_off) {
+    argv[argc++] = "-c";
+    argv[argc++] = off_config;
+  }
+  execv(freakyfetch, (char**)argv);
+  _exit(127);
+}
+
+// counts a system call of a traced thread, and the processes it creates
+static void count_syscall(pid_t tid, struct result* result) {
+  #ifdef PTRACE_GET_SYSCALL_INFO
+  struct __ptrace_syscall_info info;
+  if (ptrace(PTRACE_GET_SYSCALL_INFO, tid, sizeof(info), &info) <= 0 || info.op != PTRACE_SYSCALL_INFO_ENTRY) return;
+  result->syscalls++;
+  unsigned long long nr = info.entry.nr, clone_flags = info.entry.args[0];
+    #ifdef SYS_clone3
+  if (nr == SYS_clone3) clone_flags = ptrace(PTRACE_PEEKDATA, tid, info.entry.args[0], NULL); // struct clone_args starts with the flags
+  if (nr == SYS_clone3 && !(clone_flags & CLONE_THREAD)) result->forks++;
+    #endif
+  if (nr == SYS_clone && !(clone_flags & CLONE_THREAD)) result->forks++;
+    #ifdef SYS_fork
+  if (nr == SYS_fork || nr == SYS_vfork) result->forks++;
+    #endif
+  #else
+  (void)tid, (void)result;
+  #endif
+}
+
+// follows every thread of the child (not the processes it starts) until it exits, false if it can't be traced
+static bool trace_child(pid_t pid, struct result* result) {
+  int status;
+  if (waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status) ||
+      ptrace(PTRACE_SETOPTIONS, pid, NULL, PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL) != 0) {
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    return false;
+  }
+  result->forks = result->syscalls = 0;
+  ptrace(PTRACE_SYSCALL, pid, NULL, 0);
+  for (pid_t tid; (tid = waitpid(-1, &status, __WALL)) > 0;) {
+    if (!WIFSTOPPED(status)) {
+      if (tid == pid) break; // the leader is reported after all its threads
+      continue;
+    }
+    int signal = WSTOPSIG(status);
+    if (signal == (SIGTRAP | 0x80))
+      count_syscall(tid, result);
+    if (signal == (SIGTRAP | 0x80) || status >> 16 || signal == SIGSTOP || signal == SIGTRAP)
+      signal = 0; // tracing stops, and the stop of the new threads
+    ptrace(PTRACE_SYSCALL, tid, NULL, signal);
+  }
+  #ifndef PTRACE_GET_SYSCALL_INFO
+  result->forks = result->syscalls = -1;
+  #endif
+  return true;
+}
+
+// one run of a scenario, its wall time in microseconds or -1
+static long long run_once(const struct scenario* scenario, long* rss_kb, struct result* traced) {
+  if (scenario->cold) remove_cache_files();
+  fflush(stdout);
+  long long start = now_us();
+  pid_t pid       = fork();
+  if (pid < 0) return -1;
+  if (pid == 0) run_child(scenario, traced != NULL);
+  if (traced) return trace_child(pid, traced) ? now_us() - start : -1;
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) != pid) return -1;
+  long long elapsed = now_us() - start;
+  if (rss_kb && usage.ru_maxrss > *rss_kb) *rss_kb = usage.ru_maxrss;
+  return WIFEXITED(status) && WEXITSTATUS(status) != 127 ? elapsed : -1;
+}
+
+static int compare_times(const void* a, const void* b) {
+  long long time_a = *(const long long*)a, time_b = *(const long long*)b;
+  return (time_a > time_b) - (time_a < time_b);
+}
+
+// nearest rank percentile of sorted times
+static long long percentile(const long long* times, int count, int p) {
+  int rank = (p * count + 99) / 100;
+  return times[rank > 0 ? rank - 1 : 0];
+}
+
+static bool run_scenario(const struct scenario* scenario, int runs, struct result* result) {
+  long long* times = malloc(runs * sizeof(*times));
+  if (!times) return false;
+  *result = (struct result){.rss_kb = 0};
+  if (!scenario->cold) run_once(scenario, NULL, NULL); // fills the caches
+  for (int i = 0; i < runs; i++) {
+    if ((times[i] = run_once(scenario, &result->rss_kb, NULL)) < 0) {
+      fprintf(stderr, "%s: run %d failed\n", scenario->name, i + 1);
+      free(times);
+      return false;
+    }
+  }
+  qsort(times, runs, sizeof(*times), compare_times);
+  result->p50 = percentile(times, runs, 50);
+  result->p95 = percentile(times, runs, 95);
+  result->p99 = percentile(times, runs, 99);
+  if (run_once(scenario, NULL, result) < 0) result->forks = result->syscalls = -1; // ptrace may not be allowed
+  free(times);
+  return true;
+}
+
+// finds the line of a scenario in the baseline file
+static bool read_baseline(FILE* baseline, const char* name, struct result* result) {
+  char line[256], scenario[64];
+  rewind(baseline);
+  while (fgets(line, sizeof(line), baseline))
+    if (line[0] != '#' && sscanf(line, "%63s %lld %lld %lld %ld %ld %ld", scenario, &result->p50, &result->p95, &result->p99,
+                                 &result->forks, &result->syscalls, &result->rss_kb) == 7 &&
+        strcmp(scenario, name) == 0)
+      return true;
+  return false;
+}
+
+// true if measured goes over baseline by more than margin percent, unknown values are not compared
+static bool exceeds(const char* scenario, const char* metric, long long measured, long long baseline, int margin) {
+  if (measured < 0 || baseline < 0 || measured * 100 <= baseline * (100 + margin)) return false;
+  printf("%s: %s is %lld, the baseline is %lld (margin %d%%)\n", scenario, metric, measured, baseline, margin);
+  return true;
+}
+
+// the p99 of a few hundred runs is a handful of samples, it is reported but not compared
+static bool regressed(const char* scenario, const struct result* measured, const struct result* baseline, int margin) {
+  bool regression = exceeds(scenario, "p50 (us)", measured->p50, baseline->p50, margin);
+  regression |= exceeds(scenario, "p95 (us)", measured->p95, baseline->p95, margin);
+  regression |= exceeds(scenario, "forks", measured->forks, baseline->forks, margin);
+  regression |= exceeds(scenario, "syscalls", measured->syscalls, baseline->syscalls, margin);
+  regression |= exceeds(scenario, "peak RSS (kB)", measured->rss_kb, baseline->rss_kb, margin);
+  return regression;
+}
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [-n RUNS] [-m MARGIN] [-b BASELINE | -s BASELINE] FREAKYFETCH\n"
+          "    -n  runs of every scenario (200 by default)\n"
+          "    -m  percentage over the baseline that is still accepted (20 by default)\n"
+          "    -b  compares the results with this baseline and fails if one of them is exceeded\n"
+          "    -s  saves the results as the new baseline\n",
+          program);
+}
+
+int main(int argc, char* argv[]) {
+  int runs = 200, margin = 20, opt;
+  const char *baseline_path = NULL, *save_path = NULL;
+  while ((opt = getopt(argc, argv, "n:m:b:s:")) != -1) {
+    switch (opt) {
+    case 'n':
+      runs = atoi(optarg);
+      break;
+    case 'm':
+      margin = atoi(optarg);
+      break;
+    case 'b':
+      baseline_path = optarg;
+      break;
+    case 's':
+      save_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (optind != argc - 1 || runs < 1 || runs > MAX_RUNS || margin < 0) {
+    usage(argv[0]);
+    return 2;
+  }
+  static char path[4096];
+  freakyfetch = realpath(argv[optind], path);
+  if (!freakyfetch || access(freakyfetch, X_OK) != 0) {
+    fprintf(stderr, "%s: %s can't be run\n", argv[0], argv[optind]);
+    return 2;
+  }
+  if (!make_scratch()) {
+    perror(scratch);
+    return 2;
+  }
+  FILE* baseline = baseline_path ? fopen(baseline_path, "r") : NULL;
+  if (baseline_path && !baseline) { // a gate without numbers to compare to would always pass
+    fprintf(stderr, "%s: no baseline in %s, `make bench_baseline` stores one\n", argv[0], baseline_path);
+    nftw(scratch, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return 2;
+  }
+  FILE* save = save_path ? fopen(save_path, "w") : NULL;
+  if (save) fprintf(save, "# scenario p50_us p95_us p99_us forks syscalls peak_rss_kb (%d runs)\n", runs);
+
+  printf("%-14s %9s %9s %9s %6s %9s %9s\n", "scenario", "p50 ms", "p95 ms", "p99 ms", "forks", "syscalls", "rss kB");
+  int failures = 0;
+  for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    struct result result, expected;
+    if (!run_scenario(&scenarios[i], runs, &result)) {
+      failures++;
+      continue;
+    }
+    printf("%-14s %9.2f %9.2f %9.2f %6ld %9ld %9ld\n", scenarios[i].name, result.p50 / 1000.0, result.p95 / 1000.0,
+           result.p99 / 1000.0, result.forks, result.syscalls, result.rss_kb);
+    if (save)
+      fprintf(save, "%s %lld %lld %lld %ld %ld %ld\n", scenarios[i].name, result.p50, result.p95, result.p99, result.forks,
+              result.syscalls, result.rss_kb);
+    if (baseline && !read_baseline(baseline, scenarios[i].name, &expected)) {
+      printf("%s: not in the baseline, `make bench_baseline` stores it\n", scenarios[i].name);
+      failures++;
+    } else if (baseline && regressed(scenarios[i].name, &result, &expected, margin))
+      failures++;
+  }
+  if (baseline) fclose(baseline);
+  if (save && fclose(save) != 0) failures++;
+  nftw(scratch, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+  if (failures) printf("%d scenario(s) failed\n", failures);
+  return failures ? 1 : 0;
+}
+#else  // __linux__
+int main(void) {
+  fprintf(stderr, "the benchmark harness only runs on linux\n");
+  return 1;
+}
+#endif // __linux__
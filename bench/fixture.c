@@ -0,0 +1,341 @@
+/*
+ *  freakyfetch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// synthetic hosts for `make scale`: writes fake /proc, /sys, /etc, /usr/share and package database trees at the chosen
+// scale, and runs a command with such a tree mounted over the system in a private user and mount namespace, so the
+// collectors read it through their usual paths without root.
+
+#define _GNU_SOURCE // for unshare
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+  #include <sys/mount.h>
+  #include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+// what the generated host has
+struct scale {
+  int cpus, gpus, connectors, dpkg, pacman, flatpak;
+  bool arm; // cpuinfo without model name, like arm boards
+};
+
+// the files and directories that are mounted over the system, in this order; the rest of /usr/share and /var/lib
+// stays the one of the system
+static const char* mounted[] = {"proc/cpuinfo",     "proc/meminfo", "sys",           "etc/os-release",
+                                "usr/share/hwdata", "var/lib/dpkg", "var/lib/pacman", "var/lib/flatpak"};
+// the directories that get an empty tmpfs
+static const char* scratch[] = {"/run", "/dev/shm"};
+
+static char root[PATH_MAX];
+
+// creates the parent directories of path (relative to root), path itself too if it ends with a slash
+static bool make_parents(const char* path) {
+  char full[PATH_MAX];
+  snprintf(full, sizeof(full), "%s/%s", root, path);
+  for (char* slash = strchr(full + strlen(root) + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    if (mkdir(full, 0755) != 0 && errno != EEXIST) return false;
+    *slash = '/';
+  }
+  return true;
+}
+
+// opens root/path for writing, the format arguments build path
+static FILE* create(const char* format, ...) __attribute__((format(printf, 1, 2)));
+static FILE* create(const char* format, ...) {
+  char path[PATH_MAX], full[PATH_MAX];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(path, sizeof(path), format, args);
+  va_end(args);
+  snprintf(full, sizeof(full), "%s/%s", root, path);
+  FILE* file = make_parents(path) ? fopen(full, "w") : NULL;
+  if (!file) perror(full);
+  return file;
+}
+
+static bool close_file(FILE* file) { return file && fclose(file) == 0; }
+
+static bool write_cpuinfo(const struct scale* scale) {
+  FILE* file = create("proc/cpuinfo");
+  for (int i = 0; file && i < scale->cpus; i++) {
+    if (scale->arm)
+      fprintf(file, "processor\t: %d\nBogoMIPS\t: 50.00\nFeatures\t: fp asimd evtstrm aes pmull sha1 sha2 crc32 atomics fphp "
+                    "asimdhp cpuid asimdrdm lrcpc dcpop asimddp ssbs\nCPU implementer\t: 0x41\nCPU architecture: 8\n"
+                    "CPU variant\t: 0x1\nCPU part\t: 0xd40\nCPU revision\t: 1\n\n",
+              i);
+    else
+      fprintf(file,
+              "processor\t: %d\nvendor_id\t: AuthenticAMD\ncpu family\t: 25\nmodel\t\t: 17\n"
+              "model name\t: AMD EPYC 9654 96-Core Processor\nstepping\t: 1\ncpu MHz\t\t: 2400.000\ncache size\t: 1024 KB\n"
+              "physical id\t: %d\nsiblings\t: %d\ncore id\t\t: %d\ncpu cores\t: %d\n"
+              "flags\t\t: fpu vme de pse tsc msr pae mce cx8 apic sep mtrr pge mca cmov pat pse36 clflush mmx fxsr sse sse2 "
+              "ht syscall nx mmxext fxsr_opt pdpe1gb rdtscp lm constant_tsc rep_good nopl nonstop_tsc cpuid extd_apicid "
+              "aperfmperf rapl pni pclmulqdq monitor ssse3 fma cx16 pcid sse4_1 sse4_2 x2apic movbe popcnt aes xsave avx "
+              "f16c rdrand lahf_lm cmp_legacy svm extapic cr8_legacy abm sse4a misalignsse 3dnowprefetch osvw ibs skinit "
+              "wdt tce topoext perfctr_core perfctr_nb bpext perfctr_llc mwaitx cpb cat_l3 cdp_l3 avx512f avx512dq\n"
+              "bogomips\t: 4800.00\nTLB size\t: 3584 4K pages\naddress sizes\t: 52 bits physical, 57 bits virtual\n\n",
+              i, i * 2 / scale->cpus, scale->cpus / 2, i % (scale->cpus / 2 > 0 ? scale->cpus / 2 : 1),
+              scale->cpus / 4 > 0 ? scale->cpus / 4 : 1);
+  }
+  return close_file(file);
+}
+
+static bool write_meminfo(void) {
+  FILE* file = create("proc/meminfo");
+  if (file)
+    fputs("MemTotal:       1584835412 kB\nMemFree:        1203848124 kB\nMemAvailable:   1398347788 kB\n"
+          "Buffers:         2934812 kB\nCached:         184723984 kB\nSwapCached:            0 kB\n"
+          "Shmem:            4829384 kB\nSReclaimable:    12938472 kB\nSUnreclaim:       3847284 kB\n",
+          file);
+  return close_file(file);
+}
+
+static bool write_attr(const char* value, const char* format, ...) __attribute__((format(printf, 2, 3)));
+static bool write_attr(const char* value, const char* format, ...) {
+  char path[PATH_MAX];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(path, sizeof(path), format, args);
+  va_end(args);
+  FILE* file = create("%s", path);
+  if (file) fprintf(file, "%s\n", value);
+  return close_file(file);
+}
+
+// gpus between network and storage controllers, named by a pci.ids of their own; half of the names are long and full
+// of brackets, like the ones of datacenter cards
+static bool write_pci(const struct scale* scale) {
+  FILE* ids = create("usr/share/hwdata/pci.ids");
+  if (!ids) return false;
+  fputs("# synthetic pci.ids\n10de  NVIDIA Corporation\n", ids);
+  for (int i = 0; i < scale->gpus; i++)
+    if (i % 2)
+      fprintf(ids, "\t%04x  GH100 [H100 SXM5 80GB] [HBM3] [NVLink 4.0] [PCIe 5.0 x16] [MIG 7g.80gb] [Confidential Computing] "
+                   "[Hopper] [SXM5] [Board %d]\n",
+              0x2300 + i, i);
+    else
+      fprintf(ids, "\t%04x  AD102GL [L40S]\n", 0x2300 + i);
+  fputs("15b3  Mellanox Technologies\n\t101d  MT2892 Family [ConnectX-6 Dx]\n"
+        "144d  Samsung Electronics Co Ltd\n\ta80a  NVMe SSD Controller PM9A1/PM9A3/980PRO\n",
+        ids);
+  if (!close_file(ids)) return false;
+
+  char address[64], driver[PATH_MAX];
+  for (int i = 0; i < scale->gpus * 4 + 8; i++) {
+    bool gpu = i % 4 == 1 && i / 4 < scale->gpus;
+    snprintf(address, sizeof(address), "sys/bus/pci/devices/0000:%02x:%02x.0", i / 32, i % 32);
+    const char* class = gpu ? "0x030200" : i % 2 ? "0x020000" : "0x010802";
+    char device[16];
+    snprintf(device, sizeof(device), "0x%04x", gpu ? 0x2300 + i / 4 : i % 2 ? 0x101d : 0xa80a);
+    if (!write_attr(class, "%s/class", address) || !write_attr(gpu ? "0x10de" : i % 2 ? "0x15b3" : "0x144d", "%s/vendor", address) ||
+        !write_attr(device, "%s/device", address) || !write_attr("0x10de", "%s/subsystem_vendor", address) ||
+        !write_attr("0x16c1", "%s/subsystem_device", address))
+      return false;
+    snprintf(driver, sizeof(driver), "%s/%s/driver", root, address);
+    if (symlink(gpu ? "../../../../bus/pci/drivers/nvidia" : "../../../../bus/pci/drivers/mlx5_core", driver) != 0) return false;
+  }
+  return true;
+}
+
+// one card per eight connectors, three out of four are connected
+static bool write_drm(const struct scale* scale) {
+  const char* kinds[] = {"DP", "HDMI-A", "DVI-D", "eDP"};
+  for (int i = 0; i < scale->connectors; i++) {
+    char name[64];
+    snprintf(name, sizeof(name), "sys/class/drm/card%d-%s-%d", i / 8, kinds[i % 4], i);
+    if (!write_attr(i % 4 == 3 ? "disconnected" : "connected", "%s/status", name) ||
+        !write_attr("enabled", "%s/enabled", name) || !write_attr("3840x2160\n2560x1440\n1920x1080", "%s/modes", name))
+      return false;
+  }
+  return true;
+}
+
+static bool write_system(void) {
+  return write_attr("ID=debian\nNAME=\"Debian GNU/Linux\"\nPRETTY_NAME=\"Debian GNU/Linux 12 (bookworm)\"\nVERSION_ID=\"12\"",
+                    "etc/os-release") &&
+         write_attr("PowerEdge XE9680", "sys/devices/virtual/dmi/id/product_name") &&
+         write_attr("0XD4KR", "sys/devices/virtual/dmi/id/board_name");
+}
+
+static bool write_packages(const struct scale* scale) {
+  FILE* status = scale->dpkg ? create("var/lib/dpkg/status") : NULL;
+  if (scale->dpkg && !status) return false;
+  for (int i = 0; i < scale->dpkg; i++)
+    fprintf(status,
+            "Package: lib-synthetic-%d\nStatus: install ok %s\nPriority: optional\nSection: libs\nInstalled-Size: %d\n"
+            "Maintainer: Synthetic Maintainers <synthetic@example.org>\nArchitecture: amd64\nVersion: 1.%d-1\n"
+            "Depends: libc6 (>= 2.36)\nDescription: synthetic package %d\n generated to measure the package counters\n\n",
+            i, i % 50 == 49 ? "config-files" : "installed", 100 + i % 900, i, i);
+  if (status && !close_file(status)) return false;
+
+  for (int i = 0; i < scale->pacman; i++) {
+    FILE* desc = create("var/lib/pacman/local/synthetic-%d-1.%d-1/desc", i, i);
+    if (desc) fprintf(desc, "%%NAME%%\nsynthetic-%d\n\n%%VERSION%%\n1.%d-1\n", i, i);
+    if (!close_file(desc)) return false;
+  }
+  if (scale->pacman && !write_attr("9", "var/lib/pacman/local/ALPM_DB_VERSION")) return false;
+
+  // refs are <kind>/<name>/<arch>/<branch>, a locale extension for every tenth one
+  for (int i = 0; i < scale->flatpak; i++) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "var/lib/flatpak/%s/org.synthetic.App%d%s/x86_64/stable/active", i % 3 ? "app" : "runtime", i,
+             i % 10 == 9 ? ".Locale" : "");
+    if (!write_attr("", "%s/files", path)) return false;
+  }
+  return true;
+}
+
+static bool generate(const struct scale* scale) {
+  // the mounted directories exist even when there is nothing in them, to hide what the system has there
+  if ((mkdir(root, 0755) != 0 && errno != EEXIST) || !make_parents("sys/") || !make_parents("usr/share/hwdata/") ||
+      !make_parents("var/lib/dpkg/") || !make_parents("var/lib/pacman/") || !make_parents("var/lib/flatpak/"))
+    return false;
+  return write_cpuinfo(scale) && write_meminfo() && write_pci(scale) && write_drm(scale) && write_system() &&
+         write_packages(scale);
+}
+
+static bool write_map(const char* file, const char* map) {
+  int fd = open(file, O_WRONLY);
+  bool written = fd >= 0 && write(fd, map, strlen(map)) == (ssize_t)strlen(map);
+  if (fd >= 0) close(fd);
+  return written;
+}
+
+// lays the parent of source over the parent of target, so that target exists and the system keeps the rest
+static void overlay_parent(const char* source, const char* target) {
+  char lower[2 * PATH_MAX + 16], parent[PATH_MAX];
+  snprintf(parent, sizeof(parent), "%s", target);
+  *strrchr(parent, '/') = '\0';
+  snprintf(lower, sizeof(lower), "lowerdir=%.*s:%s", (int)(strrchr(source, '/') - source), source, parent);
+  if (mount("overlay", parent, "overlay", 0, lower) != 0) fprintf(stderr, "fixture: %s not mounted: %s\n", target, strerror(errno));
+}
+
+// mounts the tree over the system in new namespaces and runs the command, the ids stay the same in there
+static int run_in_fixture(char* argv[]) {
+  char map[64];
+  uid_t uid = getuid();
+  gid_t gid = getgid();
+  if (unshare(CLONE_NEWUSER | CLONE_NEWNS) != 0) {
+    perror("unshare");
+    return 1;
+  }
+  snprintf(map, sizeof(map), "%u %u 1", (unsigned)uid, (unsigned)uid);
+  write_map("/proc/self/setgroups", "deny");
+  if (!write_map("/proc/self/uid_map", map)) return perror("uid_map"), 1;
+  snprintf(map, sizeof(map), "%u %u 1", (unsigned)gid, (unsigned)gid);
+  if (!write_map("/proc/self/gid_map", map)) return perror("gid_map"), 1;
+  if (mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) != 0) return perror("mount --make-rprivate /"), 1;
+  // a bind mount needs its target, the ones the system does not have come from an overlay of the tree over their
+  // parent first, so that the overlays do not cover the bind mounts
+  for (int pass = 0; pass < 2; pass++)
+    for (size_t i = 0; i < sizeof(mounted) / sizeof(mounted[0]); i++) {
+      char source[PATH_MAX], target[PATH_MAX];
+      snprintf(source, sizeof(source), "%s/%s", root, mounted[i]);
+      snprintf(target, sizeof(target), "/%s", mounted[i]);
+      if (access(source, F_OK) != 0) continue;
+      if (pass == 0) {
+        if (access(target, F_OK) != 0) overlay_parent(source, target);
+      } else if (mount(source, target, NULL, MS_BIND | MS_REC, NULL) != 0)
+        fprintf(stderr, "fixture: %s not mounted: %s\n", target, strerror(errno));
+    }
+  // the host cache and the daemon snapshot of the fixture must not be the ones of the system
+  for (size_t i = 0; i < sizeof(scratch) / sizeof(scratch[0]); i++)
+    if (mount("tmpfs", scratch[i], "tmpfs", 0, "mode=0755") != 0)
+      fprintf(stderr, "fixture: %s not mounted: %s\n", scratch[i], strerror(errno));
+  execvp(argv[0], argv);
+  perror(argv[0]);
+  return 127;
+}
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [-c CPUS] [-a] [-g GPUS] [-o CONNECTORS] [-d DPKG] [-p PACMAN] [-f FLATPAK] DIR\n"
+          "       %s -r DIR COMMAND [ARGS...]\n"
+          "    -c  logical cpus in /proc/cpuinfo (384 by default), -a without model name like arm boards\n"
+          "    -g  gpus on the pci bus (16), -o drm connectors (48)\n"
+          "    -d  dpkg packages (12000), -p pacman packages (0), -f flatpak refs (3000)\n"
+          "    -r  runs COMMAND with the tree in DIR mounted over /proc/cpuinfo, /proc/meminfo, /sys, /etc/os-release,\n"
+          "        /usr/share/hwdata and /var/lib/{dpkg,pacman,flatpak}, with an empty /run and /dev/shm\n",
+          program, program);
+}
+
+int main(int argc, char* argv[]) {
+  struct scale scale = {.cpus = 384, .gpus = 16, .connectors = 48, .dpkg = 12000, .pacman = 0, .flatpak = 3000};
+  bool run           = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "+c:ag:o:d:p:f:r")) != -1) {
+    switch (opt) {
+    case 'c':
+      scale.cpus = atoi(optarg);
+      break;
+    case 'a':
+      scale.arm = true;
+      break;
+    case 'g':
+      scale.gpus = atoi(optarg);
+      break;
+    case 'o':
+      scale.connectors = atoi(optarg);
+      break;
+    case 'd':
+      scale.dpkg = atoi(optarg);
+      break;
+    case 'p':
+      scale.pacman = atoi(optarg);
+      break;
+    case 'f':
+      scale.flatpak = atoi(optarg);
+      break;
+    case 'r':
+      run = true;
+      break;
+    default:
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (optind >= argc || (run ? argc - optind < 2 : argc - optind != 1) || scale.cpus < 1 || scale.gpus < 0 || scale.gpus > 256 ||
+      scale.connectors < 0 || scale.dpkg < 0 || scale.pacman < 0 || scale.flatpak < 0) {
+    usage(argv[0]);
+    return 2;
+  }
+  if (run) {
+    if (!realpath(argv[optind], root)) return perror(argv[optind]), 1;
+    return run_in_fixture(argv + optind + 1);
+  }
+  snprintf(root, sizeof(root), "%s", argv[optind]);
+  if (!generate(&scale)) {
+    fprintf(stderr, "%s: could not write %s\n", argv[0], root);
+    return 1;
+  }
+  return 0;
+}
+#else  // __linux__
+int main(void) {
+  fprintf(stderr, "the fixtures only run on linux\n");
+  return 1;
+}
+#endif // __linux__
@@ -0,0 +1,323 @@
+/*
+ *  freakyfetch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// microbenchmarks of the parsers and text transforms, run by `make microbench`: every benchmark repeats one operation
+// on a realistic or adversarial input until it ran long enough, then prints the time, the bytes allocated and the
+// allocations per operation. freakyfetch.c is built in, for its parsers.
+
+#define main freakyfetch_main
+#include "../freakyfetch.c"
+#undef main
+
+#ifdef __linux__
+  #include <ftw.h>
+  #include <sys/stat.h>
+
+void remove_brackets(char* str); // not in fetch.h, only get_gpu() uses it
+
+// every allocation goes through here (libc included) to be counted, glibc exports the real allocator
+  #ifdef __GLIBC__
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+static unsigned long long allocated_bytes = 0, allocations = 0;
+
+void* malloc(size_t size) {
+  allocated_bytes += size;
+  allocations++;
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  allocated_bytes += count * size;
+  allocations++;
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  allocated_bytes += size;
+  allocations++;
+  return __libc_realloc(ptr, size);
+}
+    #define ALLOCATIONS_COUNTED true
+  #else
+static unsigned long long allocated_bytes = 0, allocations = 0;
+    #define ALLOCATIONS_COUNTED false
+  #endif
+
+static char scratch[64] = "/tmp/freakyfetch-microbench-XXXXXX";
+static char cpuinfo_x86[256 << 10], cpuinfo_arm[64 << 10], config_default[128], config_500[128];
+static char text[1024], long_gpu[256], bracketed[256], kernel_tokens[256];
+static FILE* null_stream;
+static const char* cpuinfo; // of the running benchmark
+static size_t cpuinfo_len;
+static struct info bench_info;
+static char* cache_blob;
+static size_t cache_blob_len;
+
+static long long now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// /proc/cpuinfo of a 256 cpu x86 server, model name in every block like the kernel prints it
+static void make_cpuinfo_x86(void) {
+  size_t len = 0;
+  for (int i = 0; i < 256; i++)
+    len += snprintf(cpuinfo_x86 + len, sizeof(cpuinfo_x86) - len,
+                    "processor\t: %d\nvendor_id\t: GenuineIntel\ncpu family\t: 6\nmodel\t\t: 143\n"
+                    "model name\t: Intel(R) Xeon(R) Platinum 8480+\nstepping\t: 8\ncpu MHz\t\t: 2000.000\n"
+                    "cache size\t: 107520 KB\nphysical id\t: %d\nsiblings\t: 128\ncore id\t\t: %d\ncpu cores\t: 64\n"
+                    "flags\t\t: fpu vme de pse tsc msr pae mce cx8 apic sep mtrr pge mca cmov pat pse36 clflush dts acpi mmx "
+                    "fxsr sse sse2 ss ht tm pbe syscall nx pdpe1gb rdtscp lm constant_tsc arch_perfmon pebs bts rep_good "
+                    "nopl xtopology nonstop_tsc cpuid aperfmperf pni pclmulqdq dtes64 monitor ds_cpl vmx smx est tm2 "
+                    "ssse3 sdbg fma cx16 xtpr pdcm pcid dca sse4_1 sse4_2 x2apic movbe popcnt avx512f amx_tile\n"
+                    "bogomips\t: 4000.00\naddress sizes\t: 46 bits physical, 57 bits virtual\n\n",
+                    i, i / 128, i % 64);
+}
+
+// an arm board has no model name, parse_cpuinfo() falls back to counting the processors
+static void make_cpuinfo_arm(void) {
+  size_t len = 0;
+  for (int i = 0; i < 256; i++)
+    len += snprintf(cpuinfo_arm + len, sizeof(cpuinfo_arm) - len,
+                    "processor\t: %d\nBogoMIPS\t: 50.00\nFeatures\t: fp asimd evtstrm aes pmull sha1 sha2 crc32 atomics\n"
+                    "CPU implementer\t: 0x41\nCPU architecture: 8\nCPU variant\t: 0x3\nCPU part\t: 0xd0c\n\n",
+                    i);
+}
+
+static bool write_file(const char* path, const char* content) {
+  FILE* file = fopen(path, "w");
+  if (!file) return false;
+  fputs(content, file);
+  return fclose(file) == 0;
+}
+
+// 500 lines of every key, with comments and gpu entries
+static bool make_config_500(void) {
+  const char* lines[] = {"user=true", "os=true", "host=false", "kernel=true", "cpu=true", "gpus=true", "ram=false",
+                         "resolution=true", "shell=true", "pkgs=true", "uptime=true", "colors=true", "cache=false",
+                         "distro=arch", "image=\"~/Pictures/picture.png\""};
+  FILE* file = fopen(config_500, "w");
+  if (!file) return false;
+  for (int i = 0; i < 500; i++) {
+    if (i % 5 == 4)
+      fprintf(file, "gpu=%d # hides a gpu\n", i % 256);
+    else if (i % 7 == 6)
+      fprintf(file, "# comment line %d, explaining the options around\n", i);
+    else
+      fprintf(file, "%s\n", lines[i % (sizeof(lines) / sizeof(lines[0]))]);
+  }
+  return fclose(file) == 0;
+}
+
+static bool setup(void) {
+  char path[128];
+  if (!mkdtemp(scratch)) return false;
+  setenv("HOME", scratch, 1);
+  snprintf(path, sizeof(path), "%s/.cache", scratch);
+  mkdir(path, 0700);
+  snprintf(config_default, sizeof(config_default), "%s/default.config", scratch);
+  snprintf(config_500, sizeof(config_500), "%s/500.config", scratch);
+  make_cpuinfo_x86();
+  make_cpuinfo_arm();
+  if (!write_file(config_default, "user=true\nos=true\nhost=true\nkernel=true\ncpu=true\ngpu=1\ngpus=true\nram=true\n"
+                                  "resolution=false\nshell=true\npkgs=true\nuptime=true\ncolors=true\ncache=true\n") ||
+      !make_config_500() || !(null_stream = fopen("/dev/null", "w")))
+    return false;
+
+  // a cache file of a filled struct info
+  struct flags all;
+  memset(&all, true, sizeof(all));
+  init_info(&bench_info);
+  set_infof(&bench_info, &bench_info.os_name, "arch");
+  set_infof(&bench_info, &bench_info.cpu_model, "Intel(R) Xeon(R) Platinum 8480+");
+  for (int i = 0; i < 4; i++) {
+    char gpu[64];
+    int len = snprintf(gpu, sizeof(gpu), "NVIDIA Corporation GH100 [H100 SXM5 80GB] #%d", i);
+    add_gpu(&bench_info, gpu, len);
+  }
+  set_infof(&bench_info, &bench_info.kernel, "Linux 6.8.0-45-generic");
+  set_infof(&bench_info, &bench_info.pkgman_name, "1523 (pacman) 12 (flatpak)");
+  cache_blob = pack_info(&bench_info, all, &cache_blob_len);
+  snprintf(path, sizeof(path), "%s/.cache/freakyfetch.cache", scratch);
+  FILE* cache = fopen(path, "wb");
+  if (!cache_blob || !cache) return false;
+  fwrite(cache_blob, 1, cache_blob_len, cache);
+  fclose(cache);
+
+  sprintf(long_gpu, "Advanced Micro Devices, Inc. [AMD/ATI] Navi 21 [Radeon RX 6800/6800 XT / 6900 XT] (rev c1) "
+                    "NVIDIA Corporation GA102GL [RTX A6000] Intel Corporation Raptor Lake-S GT1 [UHD Graphics 770]");
+  for (size_t i = 0; i + 1 < sizeof(bracketed); i++) bracketed[i] = i % 3 == 1 ? 'x' : "[]"[i % 3 / 2];
+  sprintf(kernel_tokens, "linux arch gentoo debian fedora ubuntu void nixos manjaro solus rocky pop neon guix gnu ios");
+  return true;
+}
+
+static int remove_scratch_entry(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+  (void)st, (void)type, (void)ftw;
+  return remove(path);
+}
+
+static void parse_cpuinfo_text(void) {
+  struct info user_info;
+  init_info(&user_info);
+  parse_cpuinfo(&user_info, cpuinfo, cpuinfo_len);
+  free_info(&user_info);
+}
+
+static void get_ram_meminfo(void) {
+  char buffer[BUFFER_SIZE];
+  struct thread_varg args = {buffer, &bench_info, NULL, {false, true}};
+  get_ram(&args);
+}
+
+static void bench_parse_config(char* path) {
+  struct user_config user_config_file = {.config_directory = path};
+  struct info user_info;
+  init_info(&user_info);
+  parse_config(&user_info, &user_config_file);
+  free_info(&user_info);
+}
+
+static void parse_config_default(void) { bench_parse_config(config_default); }
+static void parse_config_500(void) { bench_parse_config(config_500); }
+
+static void read_cache_home(void) {
+  struct info user_info;
+  struct flags stale, cached;
+  init_info(&user_info);
+  read_cache(&user_info, &stale, &cached);
+  free_info(&user_info);
+}
+
+static void unpack_cache_blob(void) {
+  struct info user_info;
+  struct flags stale, cached;
+  init_info(&user_info);
+  unpack_info(cache_blob, cache_blob_len, &user_info, &stale, &cached);
+  free_info(&user_info);
+}
+
+static void print_ascii_logo(void) {
+  rewind(null_stream);
+  print_ascii(null_stream, &bench_info);
+}
+
+static void freak_hw_cpu(void) {
+  sprintf(text, "Intel(R) Core(TM) i7-8565U CPU @ 1.80GHz");
+  freak_hw(text);
+}
+
+static void freak_hw_long_gpu(void) {
+  sprintf(text, "%s", long_gpu);
+  freak_hw(text);
+}
+
+static void remove_brackets_gpu(void) {
+  sprintf(text, "NVIDIA Corporation GA104 [GeForce RTX 3070 Lite Hash Rate]");
+  remove_brackets(text);
+}
+
+static void remove_brackets_adversarial(void) {
+  sprintf(text, "%s", bracketed);
+  remove_brackets(text);
+}
+
+static void freak_kernel_release(void) {
+  sprintf(text, "Linux 6.8.0-45-generic");
+  freak_kernel(text);
+}
+
+static void freak_kernel_16_tokens(void) {
+  sprintf(text, "%s", kernel_tokens);
+  freak_kernel(text);
+}
+
+static struct benchmark {
+  const char* name;
+  void (*op)(void);
+  const char* cpuinfo; // the text given to parse_cpuinfo()
+} benchmarks[] = {
+    {"parse_cpuinfo/x86-256", parse_cpuinfo_text, cpuinfo_x86},
+    {"parse_cpuinfo/arm-256-no-model", parse_cpuinfo_text, cpuinfo_arm},
+    {"get_ram/proc-meminfo", get_ram_meminfo, NULL},
+    {"parse_config/default", parse_config_default, NULL},
+    {"parse_config/500-lines", parse_config_500, NULL},
+    {"read_cache", read_cache_home, NULL},
+    {"unpack_info", unpack_cache_blob, NULL},
+    {"print_ascii", print_ascii_logo, NULL},
+    {"freak_hw/cpu", freak_hw_cpu, NULL},
+    {"freak_hw/long-gpu", freak_hw_long_gpu, NULL},
+    {"remove_brackets/gpu", remove_brackets_gpu, NULL},
+    {"remove_brackets/adversarial", remove_brackets_adversarial, NULL},
+    {"freak_kernel/release", freak_kernel_release, NULL},
+    {"freak_kernel/16-tokens", freak_kernel_16_tokens, NULL},
+};
+
+// doubles the operations until they last min_ns, the last round is reported
+static void run_benchmark(const struct benchmark* benchmark, long long min_ns) {
+  cpuinfo     = benchmark->cpuinfo;
+  cpuinfo_len = cpuinfo ? strlen(cpuinfo) : 0;
+  benchmark->op(); // warms the caches
+  long long ops = 1, elapsed;
+  unsigned long long bytes, count;
+  for (;; ops *= 2) {
+    bytes           = allocated_bytes;
+    count           = allocations;
+    long long start = now_ns();
+    for (long long i = 0; i < ops; i++) benchmark->op();
+    elapsed = now_ns() - start;
+    bytes   = allocated_bytes - bytes;
+    count   = allocations - count;
+    if (elapsed >= min_ns || ops >= 1LL << 40) break;
+  }
+  if (ALLOCATIONS_COUNTED)
+    printf("%-32s %10lld %12.1f %10llu %10.2f\n", benchmark->name, ops, (double)elapsed / ops, bytes / ops, (double)count / ops);
+  else
+    printf("%-32s %10lld %12.1f %10s %10s\n", benchmark->name, ops, (double)elapsed / ops, "-", "-");
+}
+
+int main(int argc, char* argv[]) {
+  long long min_ns = 200000000; // per benchmark
+  int opt;
+  while ((opt = getopt(argc, argv, "t:")) != -1) {
+    if (opt != 't') {
+      fprintf(stderr, "usage: %s [-t MIN_MS] [NAME_PREFIX...]\n", argv[0]);
+      return 2;
+    }
+    min_ns = atoll(optarg) * 1000000LL;
+  }
+  if (!setup()) {
+    perror("microbench setup");
+    return 1;
+  }
+  printf("%-32s %10s %12s %10s %10s\n", "benchmark", "ops", "ns/op", "B/op", "allocs/op");
+  for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+    bool selected = optind == argc;
+    for (int arg = optind; arg < argc && !selected; arg++) selected = strncmp(benchmarks[i].name, argv[arg], strlen(argv[arg])) == 0;
+    if (selected) run_benchmark(&benchmarks[i], min_ns);
+  }
+  fclose(null_stream);
+  free(cache_blob);
+  nftw(scratch, remove_scratch_entry, 16, FTW_DEPTH | FTW_PHYS);
+  return 0;
+}
+#else  // __linux__
+int main(void) {
+  fprintf(stderr, "the microbenchmarks only run on linux\n");
+  return 1;
+}
+#endif // __linux__
@@ -13,10 +13,16 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE // for pipe2
+
 #ifdef __APPLE__
   #include <TargetConditionals.h> // for checking iOS
 #endif
 #include <dirent.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -42,9 +48,34 @@
   #endif   // defined(__BSD__) || defined(_WIN32)
 #endif     // defined(__APPLE__) || defined(__BSD__)
 #ifndef _WIN32
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <limits.h>
+  #include <poll.h>
   #include <pthread.h> // linux only right now
+  #include <signal.h>
+  #include <spawn.h>
   #include <sys/ioctl.h>
+  #include <sys/mman.h>
+  #include <sys/resource.h>
+  #include <sys/stat.h>
   #include <sys/utsname.h>
+  #include <sys/wait.h>
+  #include <time.h>
+  #ifdef __linux__
+    #include <linux/io_uring.h> // for the batched reads of get_info()
+    #if defined(IORING_SETUP_SUBMIT_ALL) && defined(IORING_FEAT_LINKED_FILE)
+      #define HAVE_PREFETCH // the batched reads need the io_uring of linux 5.18, older headers build without them
+    #endif
+    #include <linux/netlink.h> // for the drm and pci uevents
+    #include <linux/openat2.h> // for the sysroot scans
+    #ifdef HAVE_ZLIB
+      #include <zlib.h> // gzip image layers
+    #endif
+    #include <sys/inotify.h>
+    #include <sys/socket.h>
+    #include <sys/syscall.h> // for getdents64
+  #endif
 #else // _WIN32
   #include <windows.h>
 CONSOLE_SCREEN_BUFFER_INFO csbi;
@@ -52,7 +83,6 @@ CONSOLE_SCREEN_BUFFER_INFO csbi;
 
 #define LIBFETCH_INTERNAL // to do certain things only when included from the library itself
 #include "fetch.h"
-#define BUFFER_SIZE 256
 #ifdef __DEBUG__
 static bool verbose_enabled = false;
 bool* get_verbose_handle() { return &verbose_enabled; }
@@ -66,6 +96,10 @@ bool* get_verbose_handle() { return &verbose_enabled; }
   #endif
 #endif
 
+#ifndef PKGDB_PREFIX // where the package databases are read from
+  #define PKGDB_PREFIX ""
+#endif
+
 #ifdef __APPLE__
 // buffers where data fetched from sysctl are stored
   #define CPUBUFFERLEN 128
@@ -84,8 +118,14 @@ size_t time_buffer_len = sizeof(time_buffer);
 
 struct package_manager {
   char* command_path;
-  char* command_string; // command to get number of packages installed
-  char* pkgman_name;    // name of the package manager
+  const char* command_argv[4]; // command printing one line per installed package
+  int header_lines;            // lines printed before the package list
+  bool prints_directory;       // the command prints the directory holding one subdirectory per package instead
+  char* pkgman_name;           // name of the package manager
+  char* db_path;        // package database read by native_count
+  // counts the packages by reading db_path directly, returns -1 if the database is not there
+  int (*native_count)(const char* db_path);
+  const char* home_db_path; // the database of the user relative to HOME native_count also reads, NULL if none
 };
 
 // truncates the given string
@@ -97,374 +137,3462 @@ void truncate_str(char* string, int target_width) {
 
 // remove square brackets (for gpu names)
 void remove_brackets(char* str) {
-  int i = 0, j = 0;
-  while (i < (int)strlen(str))
-    if (str[i] == '[' || str[i] == ']')
-      for (j = i; j < (int)strlen(str); j++) str[j] = str[j + 1];
-    else
-      i++;
+  char* dst = str;
+  for (; *str; str++)
+    if (*str != '[' && *str != ']') *dst++ = *str;
+  *dst = '\0';
 }
 
-void get_twidth(struct info* user_info) {
-  LOG_I("getting terminal width");
-  // get terminal width used to truncate long names
-#ifndef _WIN32
-  ioctl(STDOUT_FILENO, TIOCGWINSZ, &user_info->win);
-  user_info->target_width = user_info->win.ws_col - 30;
-  LOG_V(user_info->target_width);
-#else  // _WIN32
-  GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
-  user_info->ws_col  = csbi.srWindow.Right - csbi.srWindow.Left - 29;
-  user_info->ws_rows = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
-  LOG_V(user_info->ws_col);
-  LOG_V(user_info->ws_rows);
-#endif // _WIN32
+// reads what is left of stream, NUL terminated; the result must be freed
+char* read_stream(FILE* stream, size_t* len) {
+  char* data = NULL;
+  size_t cap = 0, nread;
+  *len       = 0;
+  do {
+    if (*len + 4096 + 1 > cap) {
+      char* grown = realloc(data, cap = cap ? cap * 2 : 8192);
+      if (!grown) break;
+      data = grown;
+    }
+    *len += nread = fread(data + *len, 1, cap - *len - 1, stream);
+  } while (nread > 0);
+  if (data) data[*len] = '\0';
+  return data;
 }
 
-void get_sys(struct info* user_info) {
-  LOG_I("getting sys_var struct");
-#ifndef _WIN32
-  uname(&user_info->sys_var);
-#endif // _WIN32
-#ifndef __APPLE__
-  #ifndef __BSD__
-    #ifndef _WIN32
-  sysinfo(&user_info->sys);
-    #else
-  GetSystemInfo(&user_info->sys);
-    #endif
-  #endif
-#endif
+static size_t trim_blanks(const char** str, size_t len) {
+  while (len > 0 && (**str == ' ' || **str == '\t')) (*str)++, len--;
+  while (len > 0 && ((*str)[len - 1] == ' ' || (*str)[len - 1] == '\t' || (*str)[len - 1] == '\r')) len--;
+  return len;
 }
 
-// tries to get cpu name
-void* get_cpu(void* argp) {
-  if (!((struct thread_varg*)argp)->thread_flags[0]) return 0;
-  char* buffer           = ((struct thread_varg*)argp)->buffer;
-  struct info* user_info = ((struct thread_varg*)argp)->user_info;
-  FILE* cpuinfo          = ((struct thread_varg*)argp)->cpuinfo;
-  LOG_I("getting cpu name");
-  if (cpuinfo) {
-    while (fgets(buffer, BUFFER_SIZE, cpuinfo)) {
-#ifdef __BSD__
-      if (sscanf(buffer, "hw.model"
-  #ifdef __FREEBSD__
-                         ": "
-  #elif defined(__OPENBSD__)
-                         "="
-  #endif
-                         "%[^\n]",
-                 user_info->cpu_model))
+static uint32_t key_hash(const char* key, size_t len) {
+  uint32_t hash = 2166136261u;
+  while (len--) hash = (hash ^ (unsigned char)*key++) * 16777619u; // fnv-1a
+  return hash;
+}
+
+static void build_field_table(const struct field_table* table, signed char* slots, size_t* key_lens) {
+  memset(slots, -1, FIELD_SLOTS);
+  for (int i = 0; i < table->key_count && i < FIELD_SLOTS / 2; i++) {
+    key_lens[i]   = strlen(table->keys[i].key);
+    uint32_t slot = key_hash(table->keys[i].key, key_lens[i]) % FIELD_SLOTS;
+    while (slots[slot] >= 0) slot = (slot + 1) % FIELD_SLOTS;
+    slots[slot] = i;
+  }
+}
+
+void scan_fields(const char* data, size_t len, char separator, struct field_table* table,
+                 bool (*field_fn)(void*, int, const char*, size_t), void* ctx) {
+  // a line costs one hash and usually one comparison. The table is built once, a scan that finds another one
+  // building it builds a copy of its own rather than waiting
+  const struct field_key* keys = table->keys;
+  const signed char* slots     = table->slots;
+  const size_t* key_lens       = table->key_lens;
+  signed char own_slots[FIELD_SLOTS];
+  size_t own_key_lens[FIELD_SLOTS / 2];
+  int state = atomic_load_explicit(&table->state, memory_order_acquire);
+  if (state != 2) {
+    if (state == 0 && atomic_compare_exchange_strong(&table->state, &state, 1)) {
+      build_field_table(table, table->slots, table->key_lens);
+      atomic_store_explicit(&table->state, 2, memory_order_release);
+    } else {
+      build_field_table(table, own_slots, own_key_lens);
+      slots    = own_slots;
+      key_lens = own_key_lens;
+    }
+  }
+  const char* end = data + len;
+  for (const char* line = data; line < end;) {
+    // memchr is vectorized by the c library (sse2, avx2, neon, picked at run time)
+    const char* nl        = memchr(line, '\n', end - line);
+    if (!nl) nl = end;
+    const char* separator_pos = memchr(line, separator, nl - line);
+    if (separator_pos) {
+      const char* key = line;
+      size_t key_len  = trim_blanks(&key, separator_pos - line);
+      for (uint32_t slot = key_hash(key, key_len) % FIELD_SLOTS; slots[slot] >= 0; slot = (slot + 1) % FIELD_SLOTS) {
+        int i = slots[slot];
+        if (key_lens[i] != key_len || memcmp(keys[i].key, key, key_len) != 0) continue;
+        const char* value = separator_pos + 1;
+        size_t value_len  = trim_blanks(&value, nl - value);
+        if (!field_fn(ctx, keys[i].id, value, value_len)) return;
         break;
-#else
-      if (sscanf(buffer, "model name    : %[^\n]", user_info->cpu_model)) break;
-#endif // __BSD__
+      }
     }
+    line = nl + 1;
   }
-  if (strlen(user_info->cpu_model) == 0) {
-    LOG_E("failed to get cpu name");
-    rewind(cpuinfo);
-    char cores[4] = "";
-    while (fgets(buffer, BUFFER_SIZE, cpuinfo)) // get the last core number
-      sscanf(buffer, "processor%*[    |	]: %[^\n]", cores);
-    cores[strlen(cores) - 1] += 1; // should be a number
-    sprintf(user_info->cpu_model, "%s Cores", cores);
+}
+
+size_t unquote(const char** value, size_t len) {
+  if (len >= 2 && (**value == '"' || **value == '\'') && (*value)[len - 1] == **value) {
+    (*value)++;
+    len -= 2;
   }
-  LOG_V(user_info->cpu_model);
-  return 0;
+  return len;
 }
 
-// tries to get memory usage
-void* get_ram(void* argp) {
-  if (!((struct thread_varg*)argp)->thread_flags[1]) return 0;
-  LOG_I("getting ram");
-  struct info* user_info = ((struct thread_varg*)argp)->user_info;
-#ifndef __APPLE__
-  #ifdef _WIN32
-  FILE* mem_used_fp      = popen("wmic os get freevirtualmemory", "r");      // free memory
-  FILE* mem_total_fp     = popen("wmic os get totalvirtualmemorysize", "r"); // total memory
-  char mem_used_ch[2137] = {0}, mem_total_ch[2137] = {0};
+#define ARENA_BLOCK_SIZE 512 // enough for the strings of a collector, most take a few dozen bytes
 
-  while (fgets(mem_total_ch, sizeof(mem_total_ch), mem_total_fp) != NULL) {
-    if (strstr(mem_total_ch, "TotalVirtualMemorySize") != 0)
-      continue;
-    else if (strstr(mem_total_ch, "  ") == 0)
-      continue;
-    else
-      user_info->ram_total = atoi(mem_total_ch) / 1024;
+struct arena_block {
+  struct arena_block* next;
+  size_t used, size;
+  char data[]; // aligned like a pointer, as are the allocations
+};
+
+static struct arena_block* add_arena_block(struct arena* arena, size_t size) {
+  struct arena_block* block = malloc(sizeof(*block) + size);
+  if (!block) return NULL;
+  *block      = (struct arena_block){arena->head, 0, size};
+  arena->head = block;
+  return block;
+}
+
+void* arena_alloc(struct arena* arena, size_t size) {
+  size                      = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  struct arena_block* block = arena->head;
+  if ((!block || block->size - block->used < size) &&
+      !(block = add_arena_block(arena, size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE)))
+    return NULL;
+  void* allocation = block->data + block->used;
+  block->used += size;
+  return allocation;
+}
+
+void arena_free(struct arena* arena) {
+  for (struct arena_block *block = arena->head, *next; block; block = next) {
+    next = block->next;
+    free(block);
   }
-  LOG_V(user_info->ram_total);
-  while (fgets(mem_used_ch, sizeof(mem_used_ch), mem_used_fp) != NULL) {
-    if (strstr(mem_used_ch, "FreeVirtualMemory") != 0)
-      continue;
-    else if (strstr(mem_used_ch, "  ") == 0)
-      continue;
-    else
-      user_info->ram_used = user_info->ram_total - (atoi(mem_used_ch) / 1024);
+  arena->head = NULL;
+}
+
+// moves the blocks of src to dst, what was allocated from src stays valid until dst is freed
+static void merge_arena(struct arena* dst, struct arena* src) {
+  if (!src->head) return;
+  struct arena_block* oldest = src->head;
+  while (oldest->next) oldest = oldest->next;
+  oldest->next = dst->head;
+  dst->head    = src->head;
+  src->head    = NULL;
+}
+
+// the empty string every field starts with, it is not in any arena
+static const struct {
+  uint32_t len;
+  char str[4];
+} empty_info_str = {0, ""};
+
+// the arena of the collector running on this thread, the strings it sets go there instead of the one of struct info
+static __thread struct arena* collector_arena = NULL;
+
+#define INFO_STR_SIZE(len) (sizeof(uint32_t) + (len) + 1) // length, bytes and NUL
+
+// a length prefixed copy of value, NULL if it could not be allocated
+static const char* arena_str(struct arena* arena, const char* value, size_t len) {
+  if (len == 0) return empty_info_str.str;
+  if (len > UINT32_MAX) len = UINT32_MAX;
+  char* copy = arena_alloc(arena, INFO_STR_SIZE(len));
+  if (!copy) return NULL;
+  uint32_t prefix = len;
+  memcpy(copy, &prefix, sizeof(prefix));
+  memcpy(copy + sizeof(prefix), value, len);
+  copy[sizeof(prefix) + len] = '\0';
+  return copy + sizeof(prefix);
+}
+
+size_t info_len(const char* str) {
+  uint32_t len;
+  memcpy(&len, str - sizeof(len), sizeof(len));
+  return len;
+}
+
+void set_info(struct info* user_info, const char** field, const char* value, size_t len) {
+  const char* copy = arena_str(collector_arena ? collector_arena : &user_info->arena, value, len);
+  *field           = copy ? copy : empty_info_str.str;
+}
+
+void set_infof(struct info* user_info, const char** field, const char* format, ...) {
+  char value[BUFFER_SIZE];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(value, sizeof(value), format, args);
+  va_end(args);
+  if (len < 0) return;
+  if ((size_t)len < sizeof(value)) {
+    set_info(user_info, field, value, len);
+    return;
   }
-  LOG_V(user_info->ram_used);
-  pclose(mem_used_fp);
-  pclose(mem_total_fp);
-  #else // if not _WIN32
-  char* buffer = ((struct thread_varg*)argp)->buffer;
-  FILE* meminfo;
+  char* long_value = malloc(len + 1);
+  if (!long_value) return;
+  va_start(args, format);
+  vsnprintf(long_value, len + 1, format, args);
+  va_end(args);
+  set_info(user_info, field, long_value, len);
+  free(long_value);
+}
 
-    #ifdef __BSD__
-      #ifndef __OPENBSD__
-  meminfo = popen("LANG=EN_us freecolor -om 2> /dev/null", "r"); // free alternative for freebsd
-      #else
-  meminfo = popen("LANG=EN_us vmstat 2> /dev/null | grep -v 'procs' | grep -v 'r' | awk '{print $3 "
-                  "\" / \" $4}'",
-                  "r"); // free alternative for openbsd
-      #endif
-    #else
-  // getting memory info from /proc/meminfo: https://github.com/KittyKatt/screenFetch/issues/386#issuecomment-249312716
-  meminfo = fopen("/proc/meminfo",
-                  "r"); // popen("LANG=EN_us free -m 2> /dev/null", "r"); // get ram info with free
-    #endif
-  // brackets are here to restrict the access to this int variables, which are temporary
-  {
-    #ifndef __OPENBSD__
-    int memtotal = 0, shmem = 0, memfree = 0, buffers = 0, cached = 0, sreclaimable = 0;
-    #endif
-    while (fgets(buffer, BUFFER_SIZE, meminfo)) {
-    #ifndef __OPENBSD__
-      sscanf(buffer, "MemTotal:       %d", &memtotal);
-      sscanf(buffer, "Shmem:             %d", &shmem);
-      sscanf(buffer, "MemFree:        %d", &memfree);
-      sscanf(buffer, "Buffers:          %d", &buffers);
-      sscanf(buffer, "Cached:          %d", &cached);
-      sscanf(buffer, "SReclaimable:     %d", &sreclaimable);
-    #else
-      sscanf(buffer, "%dM / %dM", &user_info->ram_used, &user_info->ram_total);
-    #endif
-    }
-    #ifndef __OPENBSD__
-    user_info->ram_total = memtotal / 1024;
-    user_info->ram_used = ((memtotal + shmem) - (memfree + buffers + cached + sreclaimable)) / 1024;
-    #endif
-    LOG_V(user_info->ram_total);
-    LOG_V(user_info->ram_used);
+// memory to build a string of user_info in, it lives in the same arena and compact_info() drops it
+static void* info_scratch(struct info* user_info, size_t size) {
+  return arena_alloc(collector_arena ? collector_arena : &user_info->arena, size);
+}
+
+void add_gpu(struct info* user_info, const char* name, size_t len) {
+  struct arena* arena = collector_arena ? collector_arena : &user_info->arena;
+  if (user_info->gpu_count == user_info->gpu_capacity) { // the old list stays in the arena until it is compacted
+    int capacity      = user_info->gpu_capacity ? user_info->gpu_capacity * 2 : 4;
+    const char** gpus = arena_alloc(arena, capacity * sizeof(*gpus));
+    if (!gpus) return;
+    if (user_info->gpu_count > 0) memcpy(gpus, user_info->gpu_model, user_info->gpu_count * sizeof(*gpus));
+    user_info->gpu_model    = gpus;
+    user_info->gpu_capacity = capacity;
   }
+  const char* copy = arena_str(arena, name, len);
+  if (copy) user_info->gpu_model[user_info->gpu_count++] = copy;
+}
 
-  fclose(meminfo);
-  #endif
-#else // if __APPLE__
-  // Used
-  FILE *mem_wired_fp, *mem_active_fp, *mem_compressed_fp;
-  mem_wired_fp      = popen("vm_stat | awk '/wired/ { printf $4 }' | cut -d '.' -f 1", "r");
-  mem_active_fp     = popen("vm_stat | awk '/active/ { printf $3 }' | cut -d '.' -f 1", "r");
-  mem_compressed_fp = popen("vm_stat | awk '/occupied/ { printf $5 }' | cut -d '.' -f 1", "r");
-  char mem_wired_ch[2137], mem_active_ch[2137], mem_compressed_ch[2137];
-  while (fgets(mem_wired_ch, sizeof(mem_wired_ch), mem_wired_fp) != NULL)
-    while (fgets(mem_active_ch, sizeof(mem_active_ch), mem_active_fp) != NULL)
-      while (fgets(mem_compressed_ch, sizeof(mem_compressed_ch), mem_compressed_fp) != NULL)
-        ;
-
-  pclose(mem_wired_fp);
-  pclose(mem_active_fp);
-  pclose(mem_compressed_fp);
+// the single strings of struct info, the lists are walked by visit_info_strings()
+static const size_t info_strings[] = {
+    offsetof(struct info, user),      offsetof(struct info, host),        offsetof(struct info, shell),
+    offsetof(struct info, model),     offsetof(struct info, kernel),      offsetof(struct info, os_name),
+    offsetof(struct info, cpu_model), offsetof(struct info, pkgman_name), offsetof(struct info, image_name)};
 
-  int mem_wired      = atoi(mem_wired_ch);
-  int mem_active     = atoi(mem_active_ch);
-  int mem_compressed = atoi(mem_compressed_ch);
+static void visit_info_strings(struct info* user_info, void (*visit)(const char** str, void* ctx), void* ctx) {
+  for (size_t i = 0; i < sizeof(info_strings) / sizeof(info_strings[0]); i++)
+    visit((const char**)((char*)user_info + info_strings[i]), ctx);
+  for (size_t i = 0; i < sizeof(user_info->pkgman_list) / sizeof(user_info->pkgman_list[0]); i++)
+    visit(&user_info->pkgman_list[i], ctx);
+  for (size_t i = 0; i < sizeof(user_info->screen_names) / sizeof(user_info->screen_names[0]); i++)
+    visit(&user_info->screen_names[i], ctx);
+  for (int i = 0; i < user_info->gpu_count; i++) visit(&user_info->gpu_model[i], ctx);
+}
 
-  // Total
-  sysctlbyname("hw.memsize", &mem_buffer, &mem_buffer_len, NULL, 0);
-  user_info->ram_used  = ((mem_wired + mem_active + mem_compressed) * 4 / 1024);
-  user_info->ram_total = mem_buffer / 1024 / 1024;
-  LOG_V(user_info->ram_total);
-  LOG_V(user_info->ram_used);
-#endif
-  return 0;
+static void clear_str(const char** str, void* ctx) {
+  (void)ctx;
+  *str = empty_info_str.str;
+}
+
+void init_info(struct info* user_info) {
+  memset(user_info, 0, sizeof(*user_info));
+  visit_info_strings(user_info, clear_str, NULL);
+}
+
+void free_info(struct info* user_info) {
+  arena_free(&user_info->arena);
+  init_info(user_info);
+}
+
+static void measure_str(const char** str, void* size) {
+  size_t len = info_len(*str);
+  if (len > 0) *(size_t*)size += (INFO_STR_SIZE(len) + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+}
+
+static void move_str(const char** str, void* arena) { *str = arena_str(arena, *str, info_len(*str)); }
+
+void compact_info(struct info* user_info) {
+  size_t size = user_info->gpu_count * sizeof(*user_info->gpu_model);
+  visit_info_strings(user_info, measure_str, &size);
+  struct arena compact = {NULL};
+  if (size > 0 && !add_arena_block(&compact, size)) return; // everything stays where it is
+  const char** gpus = user_info->gpu_count > 0 ? arena_alloc(&compact, user_info->gpu_count * sizeof(*gpus)) : NULL;
+  if (gpus) memcpy(gpus, user_info->gpu_model, user_info->gpu_count * sizeof(*gpus));
+  user_info->gpu_model    = gpus;
+  user_info->gpu_capacity = user_info->gpu_count;
+  visit_info_strings(user_info, move_str, &compact);
+  arena_free(&user_info->arena);
+  user_info->arena = compact;
 }
 
-// tries to get installed gpu(s)
-void* get_gpu(void* argp) {
-  if (!((struct thread_varg*)argp)->thread_flags[2]) return 0;
-  LOG_I("getting gpu(s)");
-  char* buffer           = ((struct thread_varg*)argp)->buffer;
-  struct info* user_info = ((struct thread_varg*)argp)->user_info;
-  int gpuc               = 0; // gpu counter
-#ifndef _WIN32
-  setenv("LANG", "en_US", 1); // force language to english
-#endif
-  FILE* gpu;
 #ifndef _WIN32
-  LOG_I("getting gpus with lshw");
-  gpu = popen("lshw -class display 2> /dev/null", "r");
+  #define PROBE_TIMEOUT_MS 2000      // default deadline of a single command
+  #define PROBE_RUN_TIMEOUT_MS 4000  // deadline of all the commands started by get_info()
+  #define PROBE_OUTPUT_MAX (4 << 20) // output past this size is read and thrown away
+extern char** environ;
+static long long probe_run_deadline = 0; // deadline of all the commands of a run (monotonic ms), 0 if there is none
 
-  // add all gpus to the array gpu_model
-  while (fgets(buffer, BUFFER_SIZE, gpu))
-    if (sscanf(buffer, "    product: %[^\n]", user_info->gpu_model[gpuc])) gpuc++;
-#endif
+static long long monotonic_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
 
-  if (strlen(user_info->gpu_model[0]) < 2) {
-    // get gpus with lspci command
-    if (strcmp(user_info->os_name, "android") != 0) {
-#ifndef __APPLE__
-  #ifdef _WIN32
-      gpu = popen("wmic PATH Win32_VideoController GET Name", "r");
-  #else
-      gpu = popen("lspci -mm 2> /dev/null | grep \"VGA\" | awk -F '\"' '{print $4 $5 $6}'", "r");
+void set_probe_deadline(int timeout_ms) { probe_run_deadline = timeout_ms > 0 ? monotonic_ms() + timeout_ms : 0; }
+
+// phases of a run recorded with --timings (collectors, commands, cache, render), with the minor page faults, context
+// switches and forks of the thread. A command span has the usage of the command itself, its cpu time included. The
+// system calls are not counted here: that takes a tracer (ptrace, perf tracepoints), bench/bench counts them per run
+  #define SPAN_MAX 256
+  #ifndef RUSAGE_THREAD
+    #define RUSAGE_THREAD RUSAGE_SELF // only linux counts per thread
   #endif
-#else
-      gpu = popen(
-          "system_profiler SPDisplaysDataType | awk -F ': ' '/Chipset Model: /{ print $2 }'", "r");
-#endif
-    } else
-      gpu = popen("getprop ro.hardware.vulkan 2> /dev/null", "r"); // for android
+struct span {
+  const char* category;
+  char name[48];
+  long long start_us, end_us, cpu_us; // cpu_us of a command, -1 for the spans of our threads
+  long minor_faults, context_switches, forks;
+  int thread; // trace lane: a thread of ours, or the pid of a command
+};
+static struct {
+  bool enabled;
+  long long origin_us;
+  struct span spans[SPAN_MAX];
+  int count, threads;
+  pthread_mutex_t lock;
+} timings = {.lock = PTHREAD_MUTEX_INITIALIZER};
+static __thread int span_thread = 0;
+static __thread long span_forks = 0; // commands this thread started
+
+static long long monotonic_us(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+static long long cpu_us(const struct rusage* usage) {
+  return (usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * 1000000LL + usage->ru_utime.tv_usec + usage->ru_stime.tv_usec;
+}
+
+void enable_timings(void) {
+  timings.origin_us = monotonic_us();
+  timings.enabled   = true;
+}
+
+static struct span* add_span(const char* category, const char* name) {
+  pthread_mutex_lock(&timings.lock);
+  struct span* span = timings.count < SPAN_MAX ? &timings.spans[timings.count++] : NULL;
+  if (span_thread == 0) span_thread = ++timings.threads;
+  pthread_mutex_unlock(&timings.lock);
+  if (span) {
+    *span = (struct span){.category = category, .thread = span_thread};
+    snprintf(span->name, sizeof(span->name), "%s", name);
   }
+  return span;
+}
 
-  // get all the gpus
-  while (fgets(buffer, BUFFER_SIZE, gpu)) {
-    // windows
-    if (strstr(buffer, "Name") || (strlen(buffer) == 2))
-      continue;
-    else if (sscanf(buffer, "%[^\n]", user_info->gpu_model[gpuc]))
-      gpuc++;
+// starts a span that end_span() closes, -1 while timings are not enabled
+int begin_span(const char* category, const char* name) {
+  if (!timings.enabled) return -1;
+  struct span* span = add_span(category, name);
+  if (!span) return -1;
+  struct rusage thread;
+  getrusage(RUSAGE_THREAD, &thread);
+  span->minor_faults     = -thread.ru_minflt;
+  span->context_switches = -(thread.ru_nvcsw + thread.ru_nivcsw);
+  span->forks            = -span_forks;
+  span->cpu_us           = -1; // RUSAGE_CHILDREN is process-wide, it would count the commands of the other threads
+  span->start_us         = monotonic_us();
+  return span - timings.spans;
+}
+
+void end_span(int id) {
+  if (id < 0) return;
+  struct span* span = &timings.spans[id];
+  struct rusage thread;
+  span->end_us = monotonic_us();
+  getrusage(RUSAGE_THREAD, &thread);
+  span->minor_faults += thread.ru_minflt;
+  span->context_switches += thread.ru_nvcsw + thread.ru_nivcsw;
+  span->forks += span_forks;
+}
+
+// a command that was reaped, its usage is its own; NULL usage for one that could not be started
+static void add_command_span(const struct probe* probe, long long start_us, const struct rusage* usage) {
+  struct span* span = timings.enabled ? add_span("command", probe->argv[0]) : NULL;
+  if (!span) return;
+  span->start_us = start_us;
+  span->end_us   = monotonic_us();
+  span->cpu_us   = -1;
+  if (!usage) return;
+  span->thread           = probe->pid;
+  span->minor_faults     = usage->ru_minflt;
+  span->context_switches = usage->ru_nvcsw + usage->ru_nivcsw;
+  span->forks            = 1;
+  span->cpu_us           = cpu_us(usage);
+}
+
+static int compare_spans(const void* a, const void* b) {
+  const struct span *span_a = a, *span_b = b;
+  return (span_a->start_us > span_b->start_us) - (span_a->start_us < span_b->start_us);
+}
+
+// the spans in the order they started, on stderr usually
+void print_timings(FILE* out) {
+  pthread_mutex_lock(&timings.lock);
+  qsort(timings.spans, timings.count, sizeof(struct span), compare_spans);
+  long forks = 0;
+  fprintf(out, "%-24s %-10s %9s %9s %7s %6s %5s %9s\n", "span", "category", "start ms", "time ms", "minflt", "ctxsw",
+          "forks", "cpu ms");
+  for (int i = 0; i < timings.count; i++) {
+    struct span* span = &timings.spans[i];
+    if (span->end_us == 0) continue; // still running
+    char cpu[16] = "-";
+    if (span->cpu_us >= 0) snprintf(cpu, sizeof(cpu), "%.3f", span->cpu_us / 1000.0);
+    fprintf(out, "%-24s %-10s %9.3f %9.3f %7ld %6ld %5ld %9s\n", span->name, span->category,
+            (span->start_us - timings.origin_us) / 1000.0, (span->end_us - span->start_us) / 1000.0, span->minor_faults,
+            span->context_switches, span->forks, cpu);
+    if (strcmp(span->category, "command") == 0) forks += span->forks; // the other spans nest, they would count twice
   }
-  fclose(gpu);
+  fprintf(out, "%ld fork(s), cpu ms is the time of a command\n", forks);
+  pthread_mutex_unlock(&timings.lock);
+}
 
-  // format gpu names
-  for (int i = 0; i < gpuc; i++) {
-    remove_brackets(user_info->gpu_model[i]);
-    truncate_str(user_info->gpu_model[i], user_info->target_width);
-    LOG_V(user_info->gpu_model[i]);
+// writes str as a json string
+static void write_json_string(FILE* out, const char* str, size_t len) {
+  fputc('"', out);
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = str[i];
+    if (c == '"' || c == '\\')
+      fprintf(out, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(out, "\\u%04x", c);
+    else
+      fputc(c, out);
   }
-  return 0;
+  fputc('"', out);
 }
 
-// tries to get screen resolution
-#ifndef _WIN32
-void* get_res(void* argp) {
-  if (!((struct thread_varg*)argp)->thread_flags[3]) return 0;
-  LOG_I("getting resolution");
-  char* buffer           = ((struct thread_varg*)argp)->buffer;
-  struct info* user_info = ((struct thread_varg*)argp)->user_info;
-  FILE* resolution       = popen("xwininfo -root 2> /dev/null | grep -E 'Width|Height'", "r");
-  while (fgets(buffer, BUFFER_SIZE, resolution)) {
-    sscanf(buffer, "  Width: %d", &user_info->screen_width);
-    sscanf(buffer, "  Height: %d", &user_info->screen_height);
+// writes the spans as chrome trace events (chrome://tracing, perfetto), commands get a lane each
+bool write_timings_trace(const char* path) {
+  FILE* out = fopen(path, "w");
+  if (!out) return false;
+  pthread_mutex_lock(&timings.lock);
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out);
+  for (int i = 0, first = 1; i < timings.count; i++) {
+    struct span* span = &timings.spans[i];
+    if (span->end_us == 0) continue;
+    fputs(first ? "\n{\"name\":" : ",\n{\"name\":", out);
+    write_json_string(out, span->name, strlen(span->name));
+    fprintf(out,
+            ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"minor_faults\":%ld,\"context_switches\":%ld,\"forks\":%ld",
+            span->category, span->start_us - timings.origin_us, span->end_us - span->start_us, (int)getpid(), span->thread,
+            span->minor_faults, span->context_switches, span->forks);
+    if (span->cpu_us >= 0) fprintf(out, ",\"cpu_us\":%lld", span->cpu_us);
+    fputs("}}", out);
+    first = 0;
   }
-  LOG_V(user_info->screen_width);
-  LOG_V(user_info->screen_height);
-#else
-void* get_res() {
-  // TODO: get resolution on windows
-#endif
-  return 0;
+  fputs("\n]}\n", out);
+  pthread_mutex_unlock(&timings.lock);
+  return fclose(out) == 0;
 }
 
-// tries to get the installed package count and package managers name
-void* get_pkg(void* argp) { // this is just a function that returns the total of installed packages
-  if (!((struct thread_varg*)argp)->thread_flags[4]) return 0;
-  LOG_I("getting pkgs");
-  struct info* user_info = ((struct thread_varg*)argp)->user_info;
-  user_info->pkgs        = 0;
-#ifndef __APPLE__
-  #ifndef _WIN32
-  // all supported package managers
-  struct package_manager pkgmans[] = {
-      {PKGPATH "apt", "apt list --installed 2> /dev/null | wc -l", "(apt)"},
-      {PKGPATH "apk", "apk info 2> /dev/null | wc -l", "(apk)"},
-      // {PKGPATH"dnf","dnf list installed 2> /dev/null | wc -l", "(dnf)"}, // according to https://stackoverflow.com/questions/48570019/advantages-of-dnf-vs-rpm-on-fedora, dnf and rpm return the same number of packages
-      {PKGPATH "qlist", "qlist -I 2> /dev/null | wc -l", "(emerge)"},
-      {PKGPATH "flatpak", "flatpak list 2> /dev/null | wc -l", "(flatpak)"},
-      {PKGPATH "snap", "snap list 2> /dev/null | wc -l", "(snap)"},
-      {PKGPATH "guix", "guix package --list-installed 2> /dev/null | wc -l", "(guix)"},
-      {PKGPATH "nix-store", "nix-store -q --requisites /run/current-system/sw 2> /dev/null | wc -l", "(nix)"},
-      {PKGPATH "pacman", "pacman -Qq 2> /dev/null | wc -l", "(pacman)"},
-      {PKGPATH "pkg", "pkg info 2>/dev/null | wc -l", "(pkg)"},
-      {PKGPATH "pkg_info", "pkg_info 2>/dev/null | wc -l | sed \"s/ //g\"", "(pkg)"},
-      {PKGPATH "port", "port installed 2> /dev/null | tail -n +2 | wc -l", "(port)"},
-      {PKGPATH "brew", "find $(brew --cellar 2>/dev/stdout) -maxdepth 1 -type d 2> /dev/null | wc -l | awk '{print $1}'", "(brew-cellar)"},
-      {PKGPATH "brew", "find $(brew --caskroom 2>/dev/stdout) -maxdepth 1 -type d 2> /dev/null | wc -l | awk '{print $1}'", "(brew-cask)"},
-      {PKGPATH "rpm", "rpm -qa --last 2> /dev/null | wc -l", "(rpm)"},
-      {PKGPATH "xbps-query", "xbps-query -l 2> /dev/null | wc -l", "(xbps)"}};
-  #endif
-#else
-  struct package_manager pkgmans[] = {{"/usr/local/bin/brew", "find $(brew --cellar 2>/dev/stdout) -maxdepth 1 -type d 2> /dev/null | wc -l | awk '{print $1}' > /tmp/uwufetch_brew_tmp", "(brew-cellar)"},
-                                      {"/usr/local/bin/brew", "find $(brew --caskroom 2>/dev/stdout) -maxdepth 1 -type d 2> /dev/null | wc -l | awk '{print $1}' > /tmp/uwufetch_brew_tmp", "(brew-cask)"}};
-#endif
-#ifndef _WIN32
-  const int pkgman_count = sizeof(pkgmans) / sizeof(pkgmans[0]); // number of package managers
-  int comma_separator    = 0;
-  for (int i = 0; i < pkgman_count; i++) {
-    struct package_manager* current = &pkgmans[i]; // pointer to current package manager
+// every input of the collectors (files, directory listings, links, commands, system calls) can be recorded in an
+// archive with --capture and served back from it with --replay, through the same code paths
+  #define INPUTS_MAGIC "FFINPUT"
+  #define INPUTS_VERSION 1
+  #define INPUT_DIR_FD (-1000) // replayed directories have no descriptor, they get fake ones from here down
 
-    unsigned int pkg_count = 0;
-    LOG_I("trying pkgman %d: %s", i, current->pkgman_name);
-    LOG_V(current->command_path);
-    if (access(current->command_path, F_OK) != -1) {
-  #ifndef __APPLE__
-      FILE* fp = popen(current->command_string, "r"); // trying current package manager
-  #else
-      system(current->command_string); // writes to a temporary file: for some reason popen() does not intercept the stdout, so i have to read from a temporary file
-      FILE* fp = fopen("/tmp/uwufetch_brew_tmp", "r");
-  #endif
-      if (fscanf(fp, "%u", &pkg_count) == 3) continue;
+enum { INPUTS_LIVE, INPUTS_CAPTURE, INPUTS_REPLAY };
+enum { INPUT_FILE = 'f', INPUT_DIR = 'd', INPUT_LINK = 'l', INPUT_EXISTS = 'x', INPUT_ENV = 'e', INPUT_VALUE = 'v', INPUT_PROBE = 'p' };
+
+struct inputs_header {
+  char magic[8];
+  uint32_t version, count;
+  uint64_t index_offset; // count record offsets, sorted by record hash
+};
+
+// followed by the key (NUL terminated) and the data (also NUL terminated), padded to 8 bytes
+struct input_record {
+  uint64_t hash;
+  uint64_t len;
+  uint32_t key_len; // with its NUL
+  int32_t status;   // -1 if the input could not be read, the exit status for commands
+  uint32_t duration_ms;
+  uint8_t kind;
+  uint8_t padding[3];
+};
+
+static int input_mode = INPUTS_LIVE;
+static struct {
+  char* path;
+  struct captured_input {
+    struct input_record record;
+    char *key, *data;
+    int sequence; // order of the reads
+  }* inputs;
+  int count, capacity;
+  pthread_mutex_t lock;
+} capture = {.lock = PTHREAD_MUTEX_INITIALIZER};
+static struct {
+  const char* map;
+  size_t len;
+  const uint64_t* index;
+  uint32_t count;
+} replay;
+
+static uint64_t input_hash(char kind, const char* key) {
+  uint64_t hash = (1469598103934665603ULL ^ (unsigned char)kind) * 1099511628211ULL;
+  for (; *key; key++) hash = (hash ^ (unsigned char)*key) * 1099511628211ULL;
+  return hash;
+}
+
+bool capture_inputs(const char* path) {
+  capture.path = strdup(path);
+  input_mode   = capture.path ? INPUTS_CAPTURE : INPUTS_LIVE;
+  return capture.path != NULL;
+}
+
+static void capture_input(char kind, const char* key, const void* data, size_t len, int status, unsigned duration_ms) {
+  struct captured_input input = {
+      .record = {.hash        = input_hash(kind, key),
+                 .len         = len,
+                 .key_len     = strlen(key) + 1,
+                 .status      = status,
+                 .duration_ms = duration_ms,
+                 .kind        = kind},
+      .key    = strdup(key),
+      .data   = malloc(len + 1),
+  };
+  if (!input.key || !input.data) {
+    free(input.key);
+    free(input.data);
+    return;
+  }
+  if (len) memcpy(input.data, data, len);
+  input.data[len] = '\0';
+  pthread_mutex_lock(&capture.lock);
+  if (capture.count == capture.capacity) {
+    int capacity                  = capture.capacity ? capture.capacity * 2 : 256;
+    struct captured_input* inputs = realloc(capture.inputs, capacity * sizeof(*inputs));
+    if (inputs) {
+      capture.inputs   = inputs;
+      capture.capacity = capacity;
+    }
+  }
+  input.sequence = capture.count;
+  if (capture.count < capture.capacity)
+    capture.inputs[capture.count++] = input;
+  else {
+    free(input.key);
+    free(input.data);
+  }
+  pthread_mutex_unlock(&capture.lock);
+}
+
+static bool same_input(const struct captured_input* a, const struct captured_input* b) {
+  return a->record.hash == b->record.hash && a->record.kind == b->record.kind && strcmp(a->key, b->key) == 0;
+}
+
+static int compare_captured_inputs(const void* a, const void* b) {
+  const struct captured_input *input_a = a, *input_b = b;
+  if (input_a->record.hash != input_b->record.hash) return input_a->record.hash < input_b->record.hash ? -1 : 1;
+  if (input_a->record.kind != input_b->record.kind) return input_a->record.kind - input_b->record.kind;
+  int order = strcmp(input_a->key, input_b->key);
+  return order ? order : input_a->sequence - input_b->sequence;
+}
+
+static size_t input_record_size(const struct input_record* record) {
+  return (sizeof(*record) + record->key_len + record->len + 1 + 7) & ~(size_t)7;
+}
+
+bool save_captured_inputs(void) {
+  if (input_mode != INPUTS_CAPTURE) return false;
+  qsort(capture.inputs, capture.count, sizeof(*capture.inputs), compare_captured_inputs);
+  char tmp_path[4096];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.%d", capture.path, (int)getpid());
+  FILE* out = fopen(tmp_path, "wb");
+  if (!out) return false;
+  struct inputs_header header = {INPUTS_MAGIC, INPUTS_VERSION, 0, 0};
+  uint64_t* index             = malloc((capture.count + 1) * sizeof(*index));
+  uint64_t offset             = sizeof(header);
+  const char padding[8]       = {0};
+  fwrite(&header, sizeof(header), 1, out);
+  for (int i = 0; index && i < capture.count; i++) {
+    struct captured_input* input = &capture.inputs[i];
+    if (i + 1 < capture.count && same_input(input, input + 1)) continue; // an input read twice keeps what was read last
+    size_t size           = input_record_size(&input->record);
+    index[header.count++] = offset;
+    fwrite(&input->record, sizeof(input->record), 1, out);
+    fwrite(input->key, 1, input->record.key_len, out);
+    fwrite(input->data, 1, input->record.len + 1, out);
+    fwrite(padding, 1, size - (sizeof(input->record) + input->record.key_len + input->record.len + 1), out);
+    offset += size;
+  }
+  header.index_offset = offset;
+  if (index) fwrite(index, sizeof(*index), header.count, out);
+  rewind(out);
+  fwrite(&header, sizeof(header), 1, out);
+  bool written = index && !ferror(out);
+  written      = fclose(out) == 0 && written && rename(tmp_path, capture.path) == 0;
+  if (!written) unlink(tmp_path);
+  free(index);
+  return written;
+}
+
+bool replay_inputs(const char* path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0) return false;
+  void* map = fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(struct inputs_header)
+                ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)
+                : MAP_FAILED;
+  close(fd);
+  if (map == MAP_FAILED) return false;
+  const struct inputs_header* header = map;
+  if (memcmp(header->magic, INPUTS_MAGIC, 8) != 0 || header->version != INPUTS_VERSION ||
+      header->index_offset % 8 || header->index_offset > (uint64_t)st.st_size ||
+      (st.st_size - header->index_offset) / sizeof(uint64_t) < header->count) {
+    munmap(map, st.st_size);
+    return false;
+  }
+  replay.map   = map;
+  replay.len   = st.st_size;
+  replay.index = (const uint64_t*)((const char*)map + header->index_offset);
+  replay.count = header->count;
+  input_mode   = INPUTS_REPLAY;
+  return true;
+}
+
+static const char* input_key(const struct input_record* record) { return (const char*)(record + 1); }
+static const char* input_data(const struct input_record* record) { return input_key(record) + record->key_len; }
+
+// the record at index i, NULL if it does not fit in the file or its key or data are not NUL terminated
+static const struct input_record* replay_record(uint32_t i) {
+  uint64_t offset = replay.index[i];
+  if (offset % 8 || offset > replay.len || replay.len - offset < sizeof(struct input_record)) return NULL;
+  const struct input_record* record = (const struct input_record*)(replay.map + offset);
+  uint64_t space                    = replay.len - offset - sizeof(*record);
+  if (record->key_len == 0 || record->key_len > space || record->len >= space - record->key_len) return NULL;
+  if (input_key(record)[record->key_len - 1] != '\0' || input_data(record)[record->len] != '\0') return NULL;
+  return record;
+}
+
+// finds a recorded input, NULL if the captured run did not read it
+static const struct input_record* replay_input(char kind, const char* key) {
+  uint64_t hash = input_hash(kind, key);
+  uint32_t low = 0, high = replay.count;
+  while (low < high) {
+    uint32_t mid                      = low + (high - low) / 2;
+    const struct input_record* record = replay_record(mid);
+    if (!record) return NULL;
+    if (record->hash < hash)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  for (const struct input_record* record; low < replay.count && (record = replay_record(low)) && record->hash == hash; low++)
+    if (record->kind == kind && strcmp(input_key(record), key) == 0) return record;
+  return NULL;
+}
+
+// the files and existence checks of the collectors of a run, read ahead by get_info() in one batch (prefetch_inputs)
+  #define PREFETCH_MAX 48
+  #define PREFETCH_FILE_SIZE (64 << 10) // a file that fills its buffer is read again by its collector
+struct input_batch {
+  struct prefetched_input {
+    const char* path;
+    char kind;   // INPUT_FILE or INPUT_EXISTS
+    int status;  // 0 if read or found, -1 if missing, 1 if the collector has to read it itself
+    char* data;  // in buffers, NUL terminated
+    size_t len, size;
+  } inputs[PREFETCH_MAX];
+  int count;
+  char* buffers; // taken from spare_buffers and given back by get_info()
+  size_t buffers_size;
+  bool abandoned; // the kernel may still write in it, it is never freed
+  #ifdef __linux__
+  struct statx found[PREFETCH_MAX];
+  #endif
+};
+static __thread const struct input_batch* prefetched; // the batch of the run this thread is working for
+
+static const struct prefetched_input* find_prefetched(char kind, const char* path) {
+  for (int i = 0; prefetched && i < prefetched->count; i++) {
+    const struct prefetched_input* input = &prefetched->inputs[i];
+    if (input->kind == kind && input->status <= 0 && strcmp(input->path, path) == 0) return input;
+  }
+  return NULL;
+}
+
+// reads a whole file (also /proc and /sys ones), *data must be freed; false if it can't be read
+static bool load_input(const char* path, char** data, size_t* len) {
+  *data = NULL;
+  *len  = 0;
+  if (input_mode == INPUTS_REPLAY) {
+    const struct input_record* record = replay_input(INPUT_FILE, path);
+    if (!record || record->status < 0 || !(*data = malloc(record->len + 1))) return false;
+    memcpy(*data, input_data(record), record->len + 1);
+    *len = record->len;
+    return true;
+  }
+  const struct prefetched_input* input = find_prefetched(INPUT_FILE, path);
+  if (input) {
+    bool loaded = input->status == 0 && (*data = malloc(input->len + 1));
+    if (loaded) memcpy(*data, input->data, input->len + 1);
+    *len = loaded ? input->len : 0;
+    if (input_mode == INPUTS_CAPTURE) capture_input(INPUT_FILE, path, *data, *len, loaded ? 0 : -1, 0);
+    return loaded;
+  }
+  int fd        = open(path, O_RDONLY | O_CLOEXEC);
+  size_t cap    = 0;
+  ssize_t nread = 0;
+  while (fd >= 0) {
+    if (*len + 4096 + 1 > cap) {
+      char* grown = realloc(*data, cap = cap ? cap * 2 : 8192);
+      if (!grown) break;
+      *data = grown;
+    }
+    if ((nread = read(fd, *data + *len, cap - *len - 1)) <= 0) break;
+    *len += nread;
+  }
+  if (fd >= 0) close(fd);
+  if (*data) (*data)[*len] = '\0';
+  bool loaded = fd >= 0 && nread == 0 && *data;
+  if (!loaded) {
+    free(*data);
+    *data = NULL;
+    *len  = 0;
+  }
+  if (input_mode == INPUTS_CAPTURE) capture_input(INPUT_FILE, path, *data, *len, loaded ? 0 : -1, 0);
+  return loaded;
+}
+
+// a read only stream over a copy of data, for the parsers reading line by line
+static FILE* memory_stream(const char* data, size_t len) {
+  FILE* stream = fmemopen(NULL, len + 1, "w+");
+  if (stream) {
+    if (len) fwrite(data, 1, len, stream);
+    rewind(stream);
+  }
+  return stream;
+}
+
+// fopen(path, "r") for the files read by the collectors
+static FILE* open_input(const char* path) {
+  if (input_mode == INPUTS_LIVE && !find_prefetched(INPUT_FILE, path)) return fopen(path, "r");
+  char* data;
+  size_t len;
+  FILE* stream = load_input(path, &data, &len) ? memory_stream(data, len) : NULL;
+  free(data);
+  return stream;
+}
+
+// access(path, F_OK) for the existence checks of the collectors
+static bool input_exists(const char* path) {
+  if (input_mode == INPUTS_REPLAY) {
+    const struct input_record* record = replay_input(INPUT_EXISTS, path);
+    return record && record->status == 0;
+  }
+  const struct prefetched_input* input = find_prefetched(INPUT_EXISTS, path);
+  bool exists                          = input ? input->status == 0 : access(path, F_OK) == 0;
+  if (input_mode == INPUTS_CAPTURE) capture_input(INPUT_EXISTS, path, NULL, 0, exists ? 0 : -1, 0);
+  return exists;
+}
+
+// getenv() for the variables read by the collectors
+static const char* input_env(const char* name) {
+  if (input_mode == INPUTS_REPLAY) {
+    const struct input_record* record = replay_input(INPUT_ENV, name);
+    return record && record->status == 0 ? input_data(record) : NULL;
+  }
+  const char* value = getenv(name);
+  if (input_mode == INPUTS_CAPTURE) capture_input(INPUT_ENV, name, value, value ? strlen(value) : 0, value ? 0 : -1, 0);
+  return value;
+}
+
+static void batch_input(struct input_batch* batch, char kind, const char* path, size_t size) {
+  for (int i = 0; i < batch->count; i++)
+    if (batch->inputs[i].kind == kind && strcmp(batch->inputs[i].path, path) == 0) return;
+  if (batch->count < PREFETCH_MAX) batch->inputs[batch->count++] = (struct prefetched_input){path, kind, 1, NULL, 0, size};
+}
+
+// adds a file to read ahead, size 0 for PREFETCH_FILE_SIZE
+static void batch_file(struct input_batch* batch, const char* path, size_t size) {
+  batch_input(batch, INPUT_FILE, path, size ? size : PREFETCH_FILE_SIZE);
+}
+
+static void batch_exists(struct input_batch* batch, const char* path) { batch_input(batch, INPUT_EXISTS, path, 0); }
+
+  #ifdef HAVE_PREFETCH
+    #define PREFETCH_CLOSE (1ULL << 32) // user_data of the operations, the input index is in the low bits
+    #define PREFETCH_READ (1ULL << 33)
+
+// a missing file is known to be missing, the other errors are left to the collector
+static int prefetch_status(int result) { return result == -ENOENT || result == -ENOTDIR ? -1 : 1; }
+
+// the buffers of the last batch, kept for the next get_info() (the daemon fetches every few seconds)
+static struct {
+  pthread_mutex_t lock;
+  char* data;
+  size_t size;
+} spare_buffers = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+// at least size bytes, the spare buffers when they are large enough
+static char* take_buffers(size_t size, size_t* taken_size) {
+  pthread_mutex_lock(&spare_buffers.lock);
+  char* data = spare_buffers.data;
+  if (data && spare_buffers.size >= size) {
+    *taken_size        = spare_buffers.size;
+    spare_buffers.data = NULL;
+  } else
+    data = NULL;
+  pthread_mutex_unlock(&spare_buffers.lock);
+  if (!data && (data = malloc(size))) *taken_size = size;
+  return data;
+}
+
+static void give_back_buffers(char* data, size_t size) {
+  pthread_mutex_lock(&spare_buffers.lock);
+  if (spare_buffers.data && spare_buffers.size >= size)
+    free(data); // another run gave back larger ones meanwhile
+  else {
+    free(spare_buffers.data);
+    spare_buffers.data = data;
+    spare_buffers.size = size;
+  }
+  pthread_mutex_unlock(&spare_buffers.lock);
+}
+
+// submits every input of batch to one io_uring: each file is opened into a registered slot, read and closed by a
+// linked chain, each existence check is a statx. The open and read of a whole run wait on the same round trip, the
+// /proc of hidepid mounts and network home directories are slow to answer. Without io_uring (before linux 5.18,
+// seccomp, kernel.io_uring_disabled) nothing is read and the collectors read their inputs themselves
+static void prefetch_inputs(struct input_batch* batch) {
+  size_t total = 0;
+  int files = 0, operations = 0;
+  for (int i = 0; i < batch->count; i++) {
+    if (batch->inputs[i].kind == INPUT_FILE) total += batch->inputs[i].size + 1, files++;
+    operations += batch->inputs[i].kind == INPUT_FILE ? 3 : 1;
+  }
+  if (operations == 0 || (total && !(batch->buffers = take_buffers(total, &batch->buffers_size)))) return;
+  for (int i = 0, offset = 0; i < batch->count; i++)
+    if (batch->inputs[i].kind == INPUT_FILE) {
+      batch->inputs[i].data = batch->buffers + offset;
+      offset += batch->inputs[i].size + 1;
+    }
+
+  // the submit-all flag and linked file slots came together in 5.18, older kernels fail the setup
+  struct io_uring_params params = {.flags = IORING_SETUP_SUBMIT_ALL};
+  int ring_fd                   = syscall(SYS_io_uring_setup, operations, &params);
+  if (ring_fd < 0) return;
+  size_t ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  if (params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe) > ring_size)
+    ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  size_t sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  char* ring       = MAP_FAILED;
+  struct io_uring_sqe* sqes = MAP_FAILED;
+  int slots[PREFETCH_MAX];
+  for (int i = 0; i < files; i++) slots[i] = -1; // sparse, filled by the opens
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_LINKED_FILE) ||
+      (ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING)) == MAP_FAILED ||
+      (sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES)) == MAP_FAILED ||
+      (files && syscall(SYS_io_uring_register, ring_fd, IORING_REGISTER_FILES, slots, files) != 0))
+    goto out;
+
+  unsigned* sq_array = (unsigned*)(ring + params.sq_off.array);
+  unsigned sq_mask   = *(unsigned*)(ring + params.sq_off.ring_mask);
+  unsigned tail      = *(unsigned*)(ring + params.sq_off.tail);
+  for (int i = 0, slot = 0; i < batch->count; i++) {
+    struct prefetched_input* input = &batch->inputs[i];
+    struct io_uring_sqe* sqe       = &sqes[tail & sq_mask];
+    sq_array[tail & sq_mask]       = tail & sq_mask;
+    tail++;
+    if (input->kind == INPUT_EXISTS) {
+      *sqe = (struct io_uring_sqe){.opcode = IORING_OP_STATX, .fd = AT_FDCWD, .addr = (uintptr_t)input->path,
+                                   .len = STATX_TYPE, .off = (uintptr_t)&batch->found[i], .user_data = i};
+      continue;
+    }
+    *sqe = (struct io_uring_sqe){.opcode = IORING_OP_OPENAT, .flags = IOSQE_IO_LINK, .fd = AT_FDCWD,
+                                 .addr = (uintptr_t)input->path, .open_flags = O_RDONLY, .file_index = slot + 1, .user_data = i};
+    sqe                      = &sqes[tail & sq_mask];
+    sq_array[tail & sq_mask] = tail & sq_mask;
+    tail++;
+    *sqe = (struct io_uring_sqe){.opcode = IORING_OP_READ, .flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK, .fd = slot,
+                                 .addr = (uintptr_t)input->data, .len = input->size, .user_data = PREFETCH_READ | i};
+    sqe                      = &sqes[tail & sq_mask];
+    sq_array[tail & sq_mask] = tail & sq_mask;
+    tail++;
+    *sqe = (struct io_uring_sqe){.opcode = IORING_OP_CLOSE, .file_index = slot + 1, .user_data = PREFETCH_CLOSE | i};
+    slot++;
+  }
+  __atomic_store_n((unsigned*)(ring + params.sq_off.tail), tail, __ATOMIC_RELEASE);
+
+  unsigned* cq_head = (unsigned*)(ring + params.cq_off.head);
+  unsigned* cq_tail = (unsigned*)(ring + params.cq_off.tail);
+  unsigned cq_mask  = *(unsigned*)(ring + params.cq_off.ring_mask);
+  struct io_uring_cqe* cqes = (struct io_uring_cqe*)(ring + params.cq_off.cqes);
+  int to_submit = operations, reaped = 0;
+  while (reaped < operations) {
+    int submitted = syscall(SYS_io_uring_enter, ring_fd, to_submit, operations - reaped, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (submitted < 0 && errno != EINTR) {
+      for (int i = 0; i < batch->count; i++) batch->inputs[i].status = 1;
+      batch->abandoned = true;
+      break;
+    }
+    if (submitted > 0) to_submit -= submitted;
+    unsigned head = *cq_head;
+    for (; head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE); head++, reaped++) {
+      struct io_uring_cqe* cqe       = &cqes[head & cq_mask];
+      struct prefetched_input* input = &batch->inputs[cqe->user_data & 0xffffffff];
+      if (cqe->user_data & PREFETCH_CLOSE) continue;
+      if (cqe->user_data & PREFETCH_READ) {
+        if (cqe->res >= 0 && (size_t)cqe->res < input->size) {
+          input->len             = cqe->res;
+          input->data[input->len] = '\0';
+          input->status          = 0;
+        }
+      } else if (input->kind == INPUT_EXISTS)
+        input->status = cqe->res == 0 ? 0 : prefetch_status(cqe->res);
+      else if (cqe->res < 0)
+        input->status = prefetch_status(cqe->res);
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+  }
+out:
+  if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+  if (ring != MAP_FAILED) munmap(ring, ring_size);
+  close(ring_fd);
+}
+  #endif // HAVE_PREFETCH
+
+// system call results (uname, sysinfo, window size...) are stored as they are: true if value was replayed, otherwise
+// the caller makes the call and passes the result to capture_value(). A value the captured run did not record, or
+// recorded with another size, is replayed as zeros: a replay never reads the live system
+static bool replay_value(const char* name, void* value, size_t size) {
+  if (input_mode != INPUTS_REPLAY) return false;
+  const struct input_record* record = replay_input(INPUT_VALUE, name);
+  if (record && record->len == size)
+    memcpy(value, input_data(record), size);
+  else
+    memset(value, 0, size);
+  return true;
+}
+
+static void capture_value(const char* name, const void* value, size_t size) {
+  if (input_mode == INPUTS_CAPTURE) capture_input(INPUT_VALUE, name, value, size, 0, 0);
+}
+
+// environment given to the commands: english output without setenv() calls from the collector threads
+static char* probe_envp[4];
+static char probe_env_path[4096], probe_env_home[1024];
+static pthread_once_t probe_env_once = PTHREAD_ONCE_INIT;
+
+static void build_probe_env(void) {
+  char* path = getenv("PATH");
+  char* home = getenv("HOME");
+  snprintf(probe_env_path, sizeof(probe_env_path), "PATH=%s", path ? path : "/usr/local/bin:/usr/bin:/bin");
+  probe_envp[0] = "LC_ALL=C";
+  probe_envp[1] = probe_env_path;
+  if (home) { // brew and snap look for their prefix in the home directory
+    snprintf(probe_env_home, sizeof(probe_env_home), "HOME=%s", home);
+    probe_envp[2] = probe_env_home;
+  }
+}
+
+static int spawn_probe(struct probe* probe) {
+  int pipe_fds[2] = {-1, -1};
+  if (!probe->inherit_stdout) {
+  #ifdef __linux__
+    if (pipe2(pipe_fds, O_CLOEXEC) < 0) return -1;
+  #else
+    if (pipe(pipe_fds) < 0) return -1;
+    fcntl(pipe_fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipe_fds[1], F_SETFD, FD_CLOEXEC);
+  #endif
+  }
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+  if (!probe->inherit_stdout) posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+  pthread_once(&probe_env_once, build_probe_env);
+  // commands printing on the terminal need its variables (TERM, COLORTERM...)
+  int err = posix_spawnp(&probe->pid, probe->argv[0], &actions, NULL, (char* const*)probe->argv,
+                         probe->inherit_stdout ? environ : probe_envp);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err == 0) span_forks++;
+  if (pipe_fds[1] >= 0) close(pipe_fds[1]);
+  if (err != 0) {
+    LOG_E("could not run %s", probe->argv[0]);
+    if (pipe_fds[0] >= 0) close(pipe_fds[0]);
+    probe->pid = -1;
+    return -1;
+  }
+  probe->fd = pipe_fds[0];
+  if (probe->fd >= 0) fcntl(probe->fd, F_SETFL, O_NONBLOCK);
+  return 0;
+}
+
+// reads what is available on the probe pipe, returns 0 at the end of the output
+static int read_probe_output(struct probe* probe) {
+  char discard[4096];
+  for (;;) {
+    char* dst    = discard;
+    size_t space = sizeof(discard);
+    if (probe->output_len + 1 < PROBE_OUTPUT_MAX) {
+      if (probe->output_cap - probe->output_len < 4096 + 1) {
+        size_t cap   = probe->output_cap ? probe->output_cap * 2 : 8192;
+        char* output = realloc(probe->output, cap);
+        if (!output) return 0;
+        probe->output     = output;
+        probe->output_cap = cap;
+      }
+      dst   = probe->output + probe->output_len;
+      space = probe->output_cap - probe->output_len - 1;
+    }
+    ssize_t len = read(probe->fd, dst, space);
+    if (len > 0) {
+      if (dst != discard) probe->output_len += len;
+      continue;
+    }
+    if (len < 0 && errno == EINTR) continue;
+    return len < 0 && errno == EAGAIN ? 1 : 0;
+  }
+}
+
+static void kill_probe(struct probe* probe) {
+  LOG_E("%s timed out", probe->argv[0]);
+  kill(probe->pid, SIGKILL);
+  probe->timed_out = true;
+}
+
+// waits for the probe process until its deadline
+static void reap_probe(struct probe* probe, long long start_us) {
+  if (probe->fd >= 0) close(probe->fd);
+  probe->fd = -1;
+  while (probe->pid > 0) {
+    int wstatus;
+    struct rusage usage;
+    pid_t pid = wait4(probe->pid, &wstatus, probe->timed_out ? 0 : WNOHANG, &usage);
+    if (pid == probe->pid) {
+      probe->status = !probe->timed_out && WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : -1;
+      add_command_span(probe, start_us, &usage);
+      break;
+    } else if (pid < 0 && errno != EINTR)
+      break;
+    else if (pid == 0) {
+      if (monotonic_ms() >= probe->deadline)
+        kill_probe(probe);
+      else
+        nanosleep(&(struct timespec){0, 1000000}, NULL);
+    }
+  }
+  probe->pid = -1;
+  if (probe->output) probe->output[probe->output_len] = '\0';
+}
+
+// the command line of a probe, the key of its recorded output
+static void probe_key(const struct probe* probe, char* key, size_t size) {
+  size_t len = 0;
+  key[0]     = '\0';
+  for (int i = 0; probe->argv[i] && len < size; i++)
+    len += snprintf(key + len, size - len, "%s%s", i > 0 ? " " : "", probe->argv[i]);
+}
+
+// serves the recorded outputs, in as much time as the commands took
+static int replay_probes(struct probe* probes, int count) {
+  int succeeded = 0, longest_ms = 0;
+  for (int i = 0; i < count; i++) {
+    struct probe* probe = &probes[i];
+    char key[1024];
+    probe_key(probe, key, sizeof(key));
+    const struct input_record* record = replay_input(INPUT_PROBE, key);
+    probe->output                     = NULL;
+    probe->output_len = probe->output_cap = 0;
+    probe->status                         = record ? record->status : -1;
+    probe->duration_ms                    = record ? (int)record->duration_ms : 0;
+    probe->timed_out                      = false;
+    if (record && record->len > 0 && (probe->output = malloc(record->len + 1))) {
+      memcpy(probe->output, input_data(record), record->len + 1);
+      probe->output_len = record->len;
+      probe->output_cap = record->len + 1;
+    }
+    if (probe->duration_ms > longest_ms) longest_ms = probe->duration_ms;
+    if (probe->status == 0) succeeded++;
+  }
+  nanosleep(&(struct timespec){longest_ms / 1000, longest_ms % 1000 * 1000000L}, NULL);
+  return succeeded;
+}
+
+// runs all the probes at the same time and collects their output, returns how many exited successfully
+int run_probes(struct probe* probes, int count) {
+  if (input_mode == INPUTS_REPLAY) return replay_probes(probes, count);
+  struct pollfd fds[count > 0 ? count : 1];
+  struct probe* polled[count > 0 ? count : 1];
+  long long now = monotonic_ms(), start = now, start_us = monotonic_us();
+  int running   = 0;
+  for (int i = 0; i < count; i++) {
+    struct probe* probe = &probes[i];
+    probe->output       = NULL;
+    probe->output_len = probe->output_cap = 0;
+    probe->status                         = -1;
+    probe->duration_ms                    = -1;
+    probe->timed_out                      = false;
+    probe->pid = probe->fd = -1;
+    probe->deadline                       = now + (probe->timeout_ms > 0 ? probe->timeout_ms : PROBE_TIMEOUT_MS);
+    if (probe_run_deadline && probe_run_deadline < probe->deadline) probe->deadline = probe_run_deadline;
+    LOG_I("running %s", probe->argv[0]);
+    if (spawn_probe(probe) == 0 && probe->fd >= 0)
+      running++;
+    else if (probe->pid < 0)
+      add_command_span(probe, start_us, NULL);
+  }
+
+  // one poll loop for every pipe, commands that pass their deadline are killed
+  while (running > 0) {
+    int nfds               = 0;
+    long long next_timeout = LLONG_MAX;
+    for (int i = 0; i < count; i++) {
+      if (probes[i].fd < 0) continue;
+      fds[nfds]      = (struct pollfd){probes[i].fd, POLLIN, 0};
+      polled[nfds++] = &probes[i];
+      if (probes[i].deadline < next_timeout) next_timeout = probes[i].deadline;
+    }
+    long long wait = next_timeout - monotonic_ms();
+    if (poll(fds, nfds, wait > 0 ? (int)wait : 0) < 0 && errno != EINTR) break;
+    now = monotonic_ms();
+    for (int i = 0; i < nfds; i++) {
+      struct probe* probe = polled[i];
+      if (fds[i].revents && read_probe_output(probe) > 0) continue;
+      if (!fds[i].revents && now < probe->deadline) continue;
+      if (!fds[i].revents) kill_probe(probe);
+      close(probe->fd);
+      probe->fd          = -1;
+      probe->duration_ms = now - start;
+      running--;
+    }
+  }
+
+  int succeeded = 0;
+  for (int i = 0; i < count; i++) {
+    reap_probe(&probes[i], start_us);
+    if (probes[i].duration_ms < 0) probes[i].duration_ms = monotonic_ms() - start;
+    if (probes[i].status == 0) succeeded++;
+    if (input_mode == INPUTS_CAPTURE) {
+      char key[1024];
+      probe_key(&probes[i], key, sizeof(key));
+      capture_input(INPUT_PROBE, key, probes[i].output, probes[i].output_len, probes[i].status, probes[i].duration_ms);
+    }
+  }
+  return succeeded;
+}
+
+void free_probes(struct probe* probes, int count) {
+  for (int i = 0; i < count; i++) {
+    free(probes[i].output);
+    probes[i].output     = NULL;
+    probes[i].output_len = probes[i].output_cap = 0;
+  }
+}
+
+// root the file probes of this thread are resolved in, AT_FDCWD is the host root (see scan_sysroot)
+static __thread int root_fd = AT_FDCWD;
+
+  #define RESOLVE_MAX_DEPTH 64 // directories open at once while a path is resolved by open_components()
+  #define RESOLVE_MAX_LINKS 40 // like the kernel, more symlinks fail with ELOOP
+
+// what openat2() does with RESOLVE_IN_ROOT (in_root) or RESOLVE_BENEATH, for the kernels without it: the path is
+// walked one component at a time with O_NOFOLLOW and the symlinks are read and resolved here. ".." stops at at_fd in
+// root and fails beneath, an absolute symlink starts again from at_fd in root and fails beneath. A component that
+// becomes a symlink between the check and the open fails the open, nothing is ever followed by the kernel
+static int open_components(int at_fd, const char* path, int flags, bool in_root) {
+  char pending[PATH_MAX], joined[PATH_MAX];
+  int dirs[RESOLVE_MAX_DEPTH], depth = 0, links = 0, fd = -1;
+  if (snprintf(pending, sizeof(pending), "%s", path) >= (int)sizeof(pending)) return errno = ENAMETOOLONG, -1;
+  dirs[0]     = at_fd; // never closed here
+  char* rest  = pending;
+  int failure = 0;
+  while (!failure) {
+    while (*rest == '/') rest++;
+    if (!*rest) {
+      fd = openat(dirs[depth], ".", flags);
+      if (fd < 0) failure = errno;
+      break;
+    }
+    char* name = rest;
+    rest += strcspn(rest, "/");
+    bool last = !*rest;
+    if (!last) *rest++ = '\0';
+    if (strcmp(name, ".") == 0) continue;
+    if (strcmp(name, "..") == 0) {
+      if (depth > 0)
+        close(dirs[depth--]);
+      else if (!in_root)
+        failure = EXDEV;
+      continue;
+    }
+    struct stat st;
+    if (fstatat(dirs[depth], name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+      failure = errno;
+      break;
+    }
+    if (S_ISLNK(st.st_mode)) {
+      char target[PATH_MAX];
+      ssize_t len = readlinkat(dirs[depth], name, target, sizeof(target) - 1);
+      if (len <= 0 || ++links > RESOLVE_MAX_LINKS) {
+        failure = len <= 0 ? errno : ELOOP;
+        break;
+      }
+      target[len] = '\0';
+      if (target[0] == '/') {
+        if (!in_root) {
+          failure = EXDEV;
+          break;
+        }
+        while (depth > 0) close(dirs[depth--]);
+      }
+      if (snprintf(joined, sizeof(joined), "%s%s%s", target, last ? "" : "/", last ? "" : rest) >= (int)sizeof(joined)) {
+        failure = ENAMETOOLONG;
+        break;
+      }
+      memcpy(pending, joined, sizeof(pending));
+      rest = pending;
+      continue;
+    }
+    if (last) {
+      fd = openat(dirs[depth], name, flags | O_NOFOLLOW);
+      if (fd < 0) failure = errno;
+      break;
+    }
+    if (depth + 1 == RESOLVE_MAX_DEPTH) {
+      failure = ENAMETOOLONG;
+      break;
+    }
+    int dir_fd = openat(dirs[depth], name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dir_fd < 0)
+      failure = errno;
+    else
+      dirs[++depth] = dir_fd;
+  }
+  while (depth > 0) close(dirs[depth--]);
+  if (failure) errno = failure;
+  return fd;
+}
+
+// openat() that stays inside root_fd: absolute paths are resolved in it and relative ones can't leave their directory,
+// so the symlinks of a container rootfs can't point back into the host
+static int open_at(int at_fd, const char* path, int flags) {
+  if (root_fd == AT_FDCWD) return openat(at_fd, path, flags);
+  if (at_fd == AT_FDCWD || path[0] == '/') {
+    at_fd = root_fd;
+    while (*path == '/') path++;
+    if (!*path) path = ".";
+  }
+  #ifdef __linux__
+  struct open_how how = {.flags = flags, .resolve = (at_fd == root_fd ? RESOLVE_IN_ROOT : RESOLVE_BENEATH) | RESOLVE_NO_MAGICLINKS};
+  int fd              = syscall(SYS_openat2, at_fd, path, &how, sizeof(how));
+  if (fd >= 0 || errno != ENOSYS) return fd;
+  #endif
+  // before linux 5.6 (and elsewhere) the symlinks are resolved here, openat() would follow absolute ones on the host
+  return open_components(at_fd, path, flags, at_fd == root_fd);
+}
+
+// maps a whole file in memory, returns -1 if it can't be opened
+static int map_file(const char* path, char** data, size_t* len) {
+  if (input_mode != INPUTS_LIVE && root_fd == AT_FDCWD) return load_input(path, data, len) ? 0 : -1;
+  int fd = open_at(AT_FDCWD, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return -1;
+  struct stat st;
+  *data = NULL;
+  *len  = 0;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    if (root_fd != AT_FDCWD) {
+      // sysroot scans run on every core, mmap() and munmap() would all wait on the address space lock
+      *data = malloc(st.st_size);
+      ssize_t nread = 0;
+      while (*data && (size_t)nread < (size_t)st.st_size) {
+        ssize_t chunk = pread(fd, *data + nread, st.st_size - nread, nread);
+        if (chunk <= 0) break;
+        nread += chunk;
+      }
+      *len = *data ? nread : 0;
+    } else {
+      *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (*data == MAP_FAILED)
+        *data = NULL;
+      else {
+        *len = st.st_size;
+        madvise(*data, *len, MADV_SEQUENTIAL);
+      }
+    }
+  }
+  close(fd);
+  return 0;
+}
+
+static void unmap_file(char* data, size_t len) {
+  if (root_fd != AT_FDCWD || input_mode != INPUTS_LIVE)
+    free(data);
+  else if (data)
+    munmap(data, len);
+}
+
+// calls line_fn on every line of data (without the newline)
+static void scan_lines(const char* data, size_t len, void (*line_fn)(void*, const char*, size_t), void* ctx) {
+  const char* end = data + len;
+  while (data < end) {
+    const char* nl = memchr(data, '\n', end - data);
+    if (!nl) nl = end;
+    line_fn(ctx, data, nl - data);
+    data = nl + 1;
+  }
+}
+
+static int walk_dir_live(int at_fd, const char* path, void (*entry_fn)(void*, int, const char*, unsigned char), void* ctx) {
+  int fd = open_at(at_fd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) return -1;
+  #ifdef __linux__
+  // reading the entries in big batches, readdir() would use a much smaller buffer
+  struct dirent64_raw {
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+  };
+  const size_t batch_size = 64 * 1024;
+  char* batch             = malloc(batch_size);
+  long nread;
+  while (batch && (nread = syscall(SYS_getdents64, fd, batch, batch_size)) > 0) {
+    for (long pos = 0; pos < nread;) {
+      struct dirent64_raw* entry = (struct dirent64_raw*)(batch + pos);
+      if (entry->d_name[0] != '.') entry_fn(ctx, fd, entry->d_name, entry->d_type);
+      pos += entry->d_reclen;
+    }
+  }
+  free(batch);
+  close(fd);
+  #else
+  DIR* dir = fdopendir(fd);
+  if (!dir) {
+    close(fd);
+    return -1;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)))
+    if (entry->d_name[0] != '.') entry_fn(ctx, fd, entry->d_name, entry->d_type);
+  closedir(dir);
+  #endif
+  return 0;
+}
+
+// directories being walked by this thread, the inputs under them are recorded and replayed by path
+static __thread struct {
+  int fd;
+  char path[1024];
+} walk_frames[16];
+static __thread int walk_depth;
+
+// the path of at_fd/path, the key of a recorded input
+static void input_path(int at_fd, const char* path, char* dst, size_t size) {
+  for (int i = walk_depth - 1; i >= 0 && at_fd != AT_FDCWD && path[0] != '/'; i--) {
+    if (walk_frames[i].fd != at_fd) continue;
+    if (strcmp(path, ".") == 0)
+      snprintf(dst, size, "%s", walk_frames[i].path);
+    else
+      snprintf(dst, size, "%s/%s", walk_frames[i].path, path);
+    return;
+  }
+  snprintf(dst, size, "%s", path);
+}
+
+struct dir_listing {
+  void (*entry_fn)(void*, int, const char*, unsigned char);
+  void* ctx;
+  char* entries; // "<type><name>\0" for every entry
+  size_t len, cap;
+};
+
+static void capture_dir_entry(void* ctx, int dir_fd, const char* name, unsigned char type) {
+  struct dir_listing* listing    = ctx;
+  walk_frames[walk_depth - 1].fd = dir_fd;
+  if (type == DT_UNKNOWN) { // the replayed entries can't be stat()ed
+    struct stat st;
+    type = fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0 ? DT_REG
+           : S_ISDIR(st.st_mode)                                ? DT_DIR
+           : S_ISLNK(st.st_mode)                                ? DT_LNK
+                                                                : DT_REG;
+  }
+  size_t name_len = strlen(name);
+  if (listing->len + name_len + 2 > listing->cap) {
+    size_t cap    = listing->cap ? listing->cap * 2 + name_len : 4096;
+    char* entries = realloc(listing->entries, cap);
+    if (entries) {
+      listing->entries = entries;
+      listing->cap     = cap;
+    }
+  }
+  if (listing->len + name_len + 2 <= listing->cap) {
+    listing->entries[listing->len] = type;
+    memcpy(listing->entries + listing->len + 1, name, name_len + 1);
+    listing->len += name_len + 2;
+  }
+  listing->entry_fn(listing->ctx, dir_fd, name, type);
+}
+
+// calls entry_fn on every non hidden entry of at_fd/path, returns -1 if the directory can't be opened
+static int walk_dir(int at_fd, const char* path, void (*entry_fn)(void*, int, const char*, unsigned char), void* ctx) {
+  if (input_mode == INPUTS_LIVE || root_fd != AT_FDCWD) return walk_dir_live(at_fd, path, entry_fn, ctx);
+  if (walk_depth == sizeof(walk_frames) / sizeof(walk_frames[0])) return -1;
+  int result = -1, depth = walk_depth++;
+  input_path(at_fd, path, walk_frames[depth].path, sizeof(walk_frames[depth].path));
+  walk_frames[depth].fd = INPUT_DIR_FD - depth;
+  if (input_mode == INPUTS_REPLAY) {
+    const struct input_record* record = replay_input(INPUT_DIR, walk_frames[depth].path);
+    if (record && record->status == 0) {
+      result = 0;
+      for (const char* entry = input_data(record); entry < input_data(record) + record->len; entry += strlen(entry + 1) + 2)
+        entry_fn(ctx, INPUT_DIR_FD - depth, entry + 1, (unsigned char)entry[0]);
+    }
+  } else {
+    struct dir_listing listing = {entry_fn, ctx, NULL, 0, 0};
+    result                     = walk_dir_live(at_fd, path, capture_dir_entry, &listing);
+    capture_input(INPUT_DIR, walk_frames[depth].path, listing.entries, listing.len, result, 0);
+    free(listing.entries);
+  }
+  walk_depth--;
+  return result;
+}
+
+// readlinkat() for the links read by the collectors
+static ssize_t read_link(int dir_fd, const char* name, char* dst, size_t size) {
+  if (input_mode == INPUTS_LIVE) return readlinkat(dir_fd, name, dst, size);
+  char path[1024];
+  input_path(dir_fd, name, path, sizeof(path));
+  if (input_mode == INPUTS_REPLAY) {
+    const struct input_record* record = replay_input(INPUT_LINK, path);
+    if (!record || record->status < 0) return -1;
+    size_t len = record->len < size ? record->len : size;
+    memcpy(dst, input_data(record), len);
+    return len;
+  }
+  ssize_t len = readlinkat(dir_fd, name, dst, size);
+  capture_input(INPUT_LINK, path, dst, len > 0 ? len : 0, len < 0 ? -1 : 0, 0);
+  return len;
+}
+
+static bool is_dir_entry(int dir_fd, const char* name, unsigned char type) {
+  if (type != DT_UNKNOWN) return type == DT_DIR;
+  struct stat st; // some filesystems do not fill d_type
+  return fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void count_dir_entry(void* count, int dir_fd, const char* name, unsigned char type) {
+  if (is_dir_entry(dir_fd, name, type)) (*(int*)count)++;
+}
+
+// counts the subdirectories of path, returns -1 if it does not exist
+static int count_subdirs(int at_fd, const char* path) {
+  int count = 0;
+  if (walk_dir(at_fd, path, count_dir_entry, &count) < 0) return -1;
+  return count;
+}
+
+// returns the next line of text (without the newline) and moves *pos after it, NULL at the end
+static const char* next_line(const char** pos, const char* end, size_t* len) {
+  if (!*pos || *pos >= end) return NULL;
+  const char* line = *pos;
+  const char* nl   = memchr(line, '\n', end - line);
+  *len             = (nl ? nl : end) - line;
+  *pos             = nl ? nl + 1 : end;
+  return line;
+}
+
+// counts the lines printed by a probe
+static int count_lines(const struct probe* probe) {
+  int count       = 0;
+  const char* pos = probe->output;
+  size_t len;
+  while (next_line(&pos, probe->output + probe->output_len, &len)) count++;
+  return count;
+}
+
+// copies the value of the first "key value" line (leading blanks ignored) of a probe output
+static bool probe_field(const struct probe* probe, const char* key, char* dst, size_t dst_size) {
+  const char* pos = probe->output;
+  size_t len, key_len = strlen(key);
+  for (const char* line; (line = next_line(&pos, probe->output + probe->output_len, &len));) {
+    while (len > 0 && (*line == ' ' || *line == '\t')) line++, len--;
+    if (len < key_len || memcmp(line, key, key_len) != 0) continue;
+    line += key_len, len -= key_len;
+    while (len > 0 && (*line == ' ' || *line == '\t')) line++, len--;
+    if (len >= dst_size) len = dst_size - 1;
+    memcpy(dst, line, len);
+    dst[len] = '\0';
+    return true;
+  }
+  return false;
+}
+
+  #ifdef __BSD__
+// runs a single command and returns its output as a stream, for the parsers reading line by line
+static FILE* probe_stream(const char** argv) {
+  struct probe probe = {.argv = argv};
+  run_probes(&probe, 1);
+  FILE* stream = memory_stream(probe.output, probe.output_len);
+  free_probes(&probe, 1);
+  return stream;
+}
+  #endif // __BSD__
+#else    // _WIN32
+// no --capture and --replay on windows, the inputs are always read directly
+  #define open_input(path) fopen(path, "r")
+  #define input_exists(path) (access(path, F_OK) == 0)
+#endif   // _WIN32
+
+void get_twidth(struct info* user_info) {
+  LOG_I("getting terminal width");
+  // get terminal width used to truncate long names
+#ifndef _WIN32
+  if (!replay_value("winsize", &user_info->win, sizeof(user_info->win))) {
+    ioctl(STDOUT_FILENO, TIOCGWINSZ, &user_info->win);
+    capture_value("winsize", &user_info->win, sizeof(user_info->win));
+  }
+  user_info->target_width = user_info->win.ws_col - 30;
+  LOG_V(user_info->target_width);
+#else  // _WIN32
+  GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
+  user_info->ws_col  = csbi.srWindow.Right - csbi.srWindow.Left - 29;
+  user_info->ws_rows = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+  LOG_V(user_info->ws_col);
+  LOG_V(user_info->ws_rows);
+#endif // _WIN32
+}
+
+static void get_uname(struct info* user_info) {
+#ifndef _WIN32
+  if (!replay_value("uname", &user_info->sys_var, sizeof(user_info->sys_var))) {
+    uname(&user_info->sys_var);
+    capture_value("uname", &user_info->sys_var, sizeof(user_info->sys_var));
+  }
+#else
+  (void)user_info;
+#endif // _WIN32
+}
+
+static void get_sysinfo(struct info* user_info) {
+#ifndef __APPLE__
+  #ifndef __BSD__
+    #ifndef _WIN32
+  if (!replay_value("sysinfo", &user_info->sys, sizeof(user_info->sys))) {
+    sysinfo(&user_info->sys);
+    capture_value("sysinfo", &user_info->sys, sizeof(user_info->sys));
+  }
+    #else
+  GetSystemInfo(&user_info->sys);
+    #endif
+  #endif
+#endif
+  (void)user_info;
+}
+
+void get_sys(struct info* user_info) {
+  LOG_I("getting sys_var struct");
+  get_uname(user_info);
+  get_sysinfo(user_info);
+}
+
+#ifdef __linux__
+enum { CPUINFO_MODEL, CPUINFO_PROCESSOR };
+
+struct cpuinfo_scan {
+  struct info* user_info;
+  int last_core;
+};
+
+static bool cpuinfo_field(void* ctx, int id, const char* value, size_t len) {
+  struct cpuinfo_scan* scan = ctx;
+  if (id == CPUINFO_PROCESSOR || len == 0) {
+    if (id == CPUINFO_PROCESSOR) scan->last_core = atoi(value); // the number ends the line
+    return true;
+  }
+  set_info(scan->user_info, &scan->user_info->cpu_model, value, len);
+  return false; // every core has the same model name
+}
+
+void parse_cpuinfo(struct info* user_info, const char* data, size_t len) {
+  static const struct field_key cpuinfo_keys[] = {{"model name", CPUINFO_MODEL}, {"processor", CPUINFO_PROCESSOR}};
+  static struct field_table cpuinfo_table       = FIELD_TABLE(cpuinfo_keys);
+  struct cpuinfo_scan scan                      = {user_info, -1};
+  set_info(user_info, &user_info->cpu_model, "", 0);
+  scan_fields(data, len, ':', &cpuinfo_table, cpuinfo_field, &scan);
+  // arm boards have no model name, the last processor number counts the cores
+  if (!user_info->cpu_model[0] && scan.last_core >= 0) set_infof(user_info, &user_info->cpu_model, "%d Cores", scan.last_core + 1);
+}
+#endif
+
+// tries to get cpu name
+void* get_cpu(void* argp) {
+  if (!((struct thread_varg*)argp)->thread_flags[0]) return 0;
+  struct info* user_info = ((struct thread_varg*)argp)->user_info;
+  LOG_I("getting cpu name");
+#ifdef __linux__
+  char* data;
+  size_t len;
+  set_info(user_info, &user_info->cpu_model, "", 0);
+  if (load_input("/proc/cpuinfo", &data, &len)) {
+    parse_cpuinfo(user_info, data, len);
+    free(data);
+  }
+  if (!user_info->cpu_model[0]) {
+    LOG_E("failed to get cpu name");
+  }
+#else
+  char* buffer  = ((struct thread_varg*)argp)->buffer;
+  FILE* cpuinfo = ((struct thread_varg*)argp)->cpuinfo;
+  char cpu_model[BUFFER_SIZE] = "";
+  if (cpuinfo) {
+    while (fgets(buffer, BUFFER_SIZE, cpuinfo)) {
+  #ifdef __BSD__
+      if (sscanf(buffer, "hw.model"
+    #ifdef __FREEBSD__
+                         ": "
+    #elif defined(__OPENBSD__)
+                         "="
+    #endif
+                         "%255[^\n]",
+                 cpu_model))
+        break;
+  #else
+      if (sscanf(buffer, "model name    : %255[^\n]", cpu_model)) break;
+  #endif // __BSD__
+    }
+  }
+  if (cpu_model[0])
+    set_info(user_info, &user_info->cpu_model, cpu_model, strlen(cpu_model));
+  else if (cpuinfo) {
+    LOG_E("failed to get cpu name");
+    rewind(cpuinfo);
+    int last_core = -1;
+    while (fgets(buffer, BUFFER_SIZE, cpuinfo)) // get the last core number
+      sscanf(buffer, "processor%*[    |	]: %d", &last_core);
+    if (last_core >= 0) set_infof(user_info, &user_info->cpu_model, "%d Cores", last_core + 1);
+  }
+#endif // __linux__
+  LOG_V(user_info->cpu_model);
+  return 0;
+}
+
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__OPENBSD__)
+enum { MEM_TOTAL, MEM_SHMEM, MEM_FREE, MEM_BUFFERS, MEM_CACHED, MEM_SRECLAIMABLE, MEM_FIELDS };
+
+static bool meminfo_field(void* kb, int id, const char* value, size_t len) {
+  (void)len; // "<number> kB", the number ends before the unit
+  ((long long*)kb)[id] = atoll(value);
+  return true;
+}
+#endif
+
+// tries to get memory usage
+void* get_ram(void* argp) {
+  if (!((struct thread_varg*)argp)->thread_flags[1]) return 0;
+  LOG_I("getting ram");
+  struct info* user_info = ((struct thread_varg*)argp)->user_info;
+#ifndef __APPLE__
+  #ifdef _WIN32
+  FILE* mem_used_fp      = popen("wmic os get freevirtualmemory", "r");      // free memory
+  FILE* mem_total_fp     = popen("wmic os get totalvirtualmemorysize", "r"); // total memory
+  char mem_used_ch[2137] = {0}, mem_total_ch[2137] = {0};
+
+  while (fgets(mem_total_ch, sizeof(mem_total_ch), mem_total_fp) != NULL) {
+    if (strstr(mem_total_ch, "TotalVirtualMemorySize") != 0)
+      continue;
+    else if (strstr(mem_total_ch, "  ") == 0)
+      continue;
+    else
+      user_info->ram_total = atoi(mem_total_ch) / 1024;
+  }
+  LOG_V(user_info->ram_total);
+  while (fgets(mem_used_ch, sizeof(mem_used_ch), mem_used_fp) != NULL) {
+    if (strstr(mem_used_ch, "FreeVirtualMemory") != 0)
+      continue;
+    else if (strstr(mem_used_ch, "  ") == 0)
+      continue;
+    else
+      user_info->ram_used = user_info->ram_total - (atoi(mem_used_ch) / 1024);
+  }
+  LOG_V(user_info->ram_used);
+  pclose(mem_used_fp);
+  pclose(mem_total_fp);
+  #else // if not _WIN32
+    #ifndef __OPENBSD__
+  // getting memory info from /proc/meminfo: https://github.com/KittyKatt/screenFetch/issues/386#issuecomment-249312716
+  static const struct field_key meminfo_keys[] = {{"MemTotal", MEM_TOTAL}, {"Shmem", MEM_SHMEM},   {"MemFree", MEM_FREE},
+                                                  {"Buffers", MEM_BUFFERS},  {"Cached", MEM_CACHED}, {"SReclaimable", MEM_SRECLAIMABLE}};
+  static struct field_table meminfo_table       = FIELD_TABLE(meminfo_keys);
+  long long kb[MEM_FIELDS] = {0};
+  char* data               = NULL;
+  size_t len               = 0;
+      #ifdef __BSD__
+  const char* freecolor_argv[] = {"freecolor", "-om", NULL};
+  FILE* meminfo                = probe_stream(freecolor_argv); // free alternative for freebsd
+  if (meminfo) {
+    data = read_stream(meminfo, &len);
+    fclose(meminfo);
+  }
+      #else
+  load_input("/proc/meminfo", &data, &len);
+      #endif
+  if (!data) return 0;
+  scan_fields(data, len, ':', &meminfo_table, meminfo_field, kb);
+  free(data);
+  user_info->ram_total = kb[MEM_TOTAL] / 1024;
+  user_info->ram_used  = (kb[MEM_TOTAL] + kb[MEM_SHMEM] - (kb[MEM_FREE] + kb[MEM_BUFFERS] + kb[MEM_CACHED] + kb[MEM_SRECLAIMABLE])) / 1024;
+    #else
+  char* buffer              = ((struct thread_varg*)argp)->buffer;
+  const char* vmstat_argv[] = {"vmstat", NULL};
+  FILE* meminfo             = probe_stream(vmstat_argv); // free alternative for openbsd
+  if (!meminfo) return 0;
+  while (fgets(buffer, BUFFER_SIZE, meminfo))
+    sscanf(buffer, "%*d %*d %dM %dM", &user_info->ram_used, &user_info->ram_total); // avm and fre, headers do not match
+  fclose(meminfo);
+    #endif
+  LOG_V(user_info->ram_total);
+  LOG_V(user_info->ram_used);
+  #endif
+#else // if __APPLE__
+  // Used
+  const char* vm_stat_argv[] = {"vm_stat", NULL};
+  struct probe vm_stat       = {.argv = vm_stat_argv};
+  run_probes(&vm_stat, 1);
+  char mem_wired_ch[64] = "", mem_active_ch[64] = "", mem_compressed_ch[64] = "";
+  probe_field(&vm_stat, "Pages wired down:", mem_wired_ch, sizeof(mem_wired_ch));
+  probe_field(&vm_stat, "Pages active:", mem_active_ch, sizeof(mem_active_ch));
+  probe_field(&vm_stat, "Pages occupied by compressor:", mem_compressed_ch, sizeof(mem_compressed_ch));
+  free_probes(&vm_stat, 1);
+
+  int mem_wired      = atoi(mem_wired_ch);
+  int mem_active     = atoi(mem_active_ch);
+  int mem_compressed = atoi(mem_compressed_ch);
+
+  // Total
+  sysctlbyname("hw.memsize", &mem_buffer, &mem_buffer_len, NULL, 0);
+  user_info->ram_used  = ((mem_wired + mem_active + mem_compressed) * 4 / 1024);
+  user_info->ram_total = mem_buffer / 1024 / 1024;
+  LOG_V(user_info->ram_total);
+  LOG_V(user_info->ram_used);
+#endif
+  return 0;
+}
+
+#ifdef __linux__
+  #define PCI_DEVICES_DIR "/sys/bus/pci/devices"
+  #define PCIIDS_MAGIC "FFPCIID1"
+  #define PCIIDS_NO_DEVICE 0xffffULL        // device id of the vendor entries
+  #define PCIIDS_NO_SUBSYSTEM 0xffffffffULL // subsystem ids of the vendor and device entries
+  #define PCIIDS_KEY(vendor, device, subsystem) ((uint64_t)(vendor) << 48 | (uint64_t)(device) << 32 | (subsystem))
+
+static const char* pciids_paths[] = {"/usr/share/hwdata/pci.ids", "/usr/share/misc/pci.ids", "/usr/share/pci.ids",
+                                     "/usr/local/share/pci.ids"};
+
+// binary index of pci.ids: header, entries sorted by key, then the names
+struct pciids_header {
+  char magic[8];
+  uint32_t entry_count, strings_size;
+  uint64_t source_mtime, source_size, source_ino; // the pci.ids the index was built from
+};
+
+struct pciids_entry {
+  uint64_t key;
+  uint32_t name_offset, name_len;
+};
+
+static struct {
+  const struct pciids_header* header;
+  const struct pciids_entry* entries;
+  const char* strings;
+} pciids;
+static pthread_once_t pciids_once = PTHREAD_ONCE_INIT;
+
+static int parse_hex4(const char* str, size_t len) {
+  if (len < 4) return -1;
+  int value = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = str[i];
+    int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+    if (digit < 0) return -1;
+    value = value << 4 | digit;
+  }
+  return value;
+}
+
+static int compare_pciids_entries(const void* a, const void* b) {
+  uint64_t key_a = ((const struct pciids_entry*)a)->key, key_b = ((const struct pciids_entry*)b)->key;
+  return key_a < key_b ? -1 : key_a > key_b;
+}
+
+// parses the pci.ids text into the binary index, returns NULL on failure
+static char* build_pciids_index(const char* source, const struct stat* source_st, size_t* index_len) {
+  char* data;
+  size_t len;
+  if (map_file(source, &data, &len) < 0 || !data) return NULL;
+  struct pciids_entry* entries = NULL;
+  char* strings                = NULL;
+  size_t entry_count = 0, entry_cap = 0, strings_size = 0, strings_cap = 0;
+  int vendor = -1, device = -1;
+  const char *pos = data, *line;
+  size_t line_len;
+  while ((line = next_line(&pos, data + len, &line_len))) {
+    if (line_len == 0 || line[0] == '#') continue;
+    if (line[0] == 'C' && line_len > 1 && line[1] == ' ') break; // device classes, not needed
+    int tabs = line[0] == '\t' ? (line_len > 1 && line[1] == '\t' ? 2 : 1) : 0;
+    const char* name;
+    uint64_t key;
+    if (tabs == 0) { // "vvvv  vendor name"
+      if ((vendor = parse_hex4(line, line_len)) < 0) continue;
+      device = -1;
+      key    = PCIIDS_KEY(vendor, PCIIDS_NO_DEVICE, PCIIDS_NO_SUBSYSTEM);
+      name   = line + 4;
+    } else if (tabs == 1) { // "\tdddd  device name"
+      if (vendor < 0 || (device = parse_hex4(line + 1, line_len - 1)) < 0) continue;
+      key  = PCIIDS_KEY(vendor, device, PCIIDS_NO_SUBSYSTEM);
+      name = line + 5;
+    } else { // "\t\tssss ssss  subsystem name"
+      int subvendor = line_len > 11 ? parse_hex4(line + 2, line_len - 2) : -1;
+      int subdevice = line_len > 11 ? parse_hex4(line + 7, line_len - 7) : -1;
+      if (vendor < 0 || device < 0 || subvendor < 0 || subdevice < 0) continue;
+      key  = PCIIDS_KEY(vendor, device, (uint64_t)subvendor << 16 | subdevice);
+      name = line + 11;
+    }
+    while (name < line + line_len && *name == ' ') name++;
+    size_t name_len = line + line_len - name;
+    if (entry_count == entry_cap || strings_size + name_len + 1 > strings_cap) {
+      entry_cap   = entry_count == entry_cap ? (entry_cap ? entry_cap * 2 : 4096) : entry_cap;
+      strings_cap = strings_size + name_len + 1 > strings_cap ? (strings_cap ? strings_cap * 2 : 256 * 1024) : strings_cap;
+      struct pciids_entry* new_entries = realloc(entries, entry_cap * sizeof(*entries));
+      if (new_entries) entries = new_entries;
+      char* new_strings = realloc(strings, strings_cap);
+      if (new_strings) strings = new_strings;
+      if (!new_entries || !new_strings) {
+        entry_count = 0;
+        break;
+      }
+    }
+    entries[entry_count++] = (struct pciids_entry){key, strings_size, name_len};
+    memcpy(strings + strings_size, name, name_len);
+    strings[strings_size + name_len] = '\0';
+    strings_size += name_len + 1;
+  }
+  unmap_file(data, len);
+
+  char* index = NULL;
+  if (entry_count > 0) {
+    qsort(entries, entry_count, sizeof(*entries), compare_pciids_entries);
+    *index_len = sizeof(struct pciids_header) + entry_count * sizeof(*entries) + strings_size;
+    index      = malloc(*index_len);
+  }
+  if (index) {
+    struct pciids_header header = {PCIIDS_MAGIC, entry_count, strings_size, source_st->st_mtime, source_st->st_size, source_st->st_ino};
+    memcpy(index, &header, sizeof(header));
+    memcpy(index + sizeof(header), entries, entry_count * sizeof(*entries));
+    memcpy(index + sizeof(header) + entry_count * sizeof(*entries), strings, strings_size);
+  }
+  free(entries);
+  free(strings);
+  return index;
+}
+
+static bool pciids_index_valid(const char* index, size_t index_len, const struct stat* source_st) {
+  const struct pciids_header* header = (const struct pciids_header*)index;
+  return index_len >= sizeof(*header) && memcmp(header->magic, PCIIDS_MAGIC, 8) == 0 &&
+         header->source_mtime == (uint64_t)source_st->st_mtime && header->source_size == (uint64_t)source_st->st_size &&
+         header->source_ino == (uint64_t)source_st->st_ino &&
+         index_len == sizeof(*header) + (size_t)header->entry_count * sizeof(struct pciids_entry) + header->strings_size;
+}
+
+// maps the cached index, (re)building it when pci.ids changed
+static void load_pciids(void) {
+  struct stat source_st = {0};
+  const char* source    = NULL;
+  for (size_t i = 0; i < sizeof(pciids_paths) / sizeof(pciids_paths[0]) && !source; i++)
+    if (input_mode == INPUTS_LIVE ? stat(pciids_paths[i], &source_st) == 0 : input_exists(pciids_paths[i])) source = pciids_paths[i];
+  if (!source) return;
+
+  char index_path[512] = "", *index = NULL;
+  size_t index_len     = 0;
+  // captured and replayed runs build the index in memory, the cached one is not an input
+  if (getenv("HOME") && input_mode == INPUTS_LIVE) snprintf(index_path, sizeof(index_path), "%s/.cache/freakyfetch.pciids", getenv("HOME"));
+  if (index_path[0] && map_file(index_path, &index, &index_len) == 0 && !pciids_index_valid(index, index_len, &source_st)) {
+    unmap_file(index, index_len);
+    index = NULL;
+  }
+  if (!index) {
+    LOG_I("building the pci.ids index from %s", source);
+    if (!(index = build_pciids_index(source, &source_st, &index_len))) return;
+    // written to a temporary file first, so that concurrent runs never map a partial index
+    char tmp_path[532];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", index_path, (int)getpid());
+    int fd = index_path[0] ? open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : -1;
+    if (fd >= 0) {
+      bool written = write(fd, index, index_len) == (ssize_t)index_len;
+      close(fd);
+      if (!written || rename(tmp_path, index_path) != 0) unlink(tmp_path);
+    }
+  }
+  pciids.header  = (const struct pciids_header*)index;
+  pciids.entries = (const struct pciids_entry*)(index + sizeof(struct pciids_header));
+  pciids.strings = index + sizeof(struct pciids_header) + pciids.header->entry_count * sizeof(struct pciids_entry);
+}
+
+static const struct pciids_entry* lookup_pciids(uint64_t key) {
+  pthread_once(&pciids_once, load_pciids);
+  if (!pciids.header) return NULL;
+  size_t low = 0, high = pciids.header->entry_count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (pciids.entries[mid].key == key) return &pciids.entries[mid];
+    if (pciids.entries[mid].key < key)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return NULL;
+}
+
+struct pci_gpu {
+  unsigned int vendor, device, subvendor, subdevice;
+  char driver[64];
+  char address[32]; // "0000:01:00.0", the name of its sysfs directory
+  bool listed;      // lshw or lspci printed its address
+};
+
+// reads a small sysfs attribute, returns its length without the trailing newline or -1
+static int read_attr(int dir_fd, const char* path, char* dst, size_t size) {
+  ssize_t len;
+  if (input_mode != INPUTS_LIVE) {
+    char full_path[1024], *data;
+    size_t data_len;
+    input_path(dir_fd, path, full_path, sizeof(full_path));
+    if (!load_input(full_path, &data, &data_len)) return -1;
+    len = data_len < size - 1 ? data_len : size - 1;
+    memcpy(dst, data, len);
+    free(data);
+  } else {
+    int fd = openat(dir_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    len = read(fd, dst, size - 1);
+    close(fd);
+    if (len < 0) return -1;
+  }
+  dst[len] = '\0';
+  if (len > 0 && dst[len - 1] == '\n') dst[--len] = '\0';
+  return len;
+}
+
+static unsigned int read_sysfs_hex(int dir_fd, const char* device, const char* name) {
+  char path[320], value[32];
+  snprintf(path, sizeof(path), "%s/%s", device, name);
+  return read_attr(dir_fd, path, value, sizeof(value)) > 0 ? strtoul(value, NULL, 16) : 0;
+}
+
+struct pci_scan {
+  struct pci_gpu* gpus;
+  int count, capacity;
+};
+
+static void scan_pci_device(void* ctx, int dir_fd, const char* name, unsigned char type) {
+  (void)type;
+  struct pci_scan* scan = ctx;
+  if (read_sysfs_hex(dir_fd, name, "class") >> 16 == 0x03) { // display controller
+    if (scan->count == scan->capacity) {
+      int capacity          = scan->capacity ? scan->capacity * 2 : 4;
+      struct pci_gpu* grown = realloc(scan->gpus, capacity * sizeof(*grown));
+      if (!grown) return;
+      scan->gpus     = grown;
+      scan->capacity = capacity;
+    }
+    struct pci_gpu* gpu = &scan->gpus[scan->count++];
+    snprintf(gpu->address, sizeof(gpu->address), "%s", name);
+    gpu->listed         = false;
+    gpu->vendor         = read_sysfs_hex(dir_fd, name, "vendor");
+    gpu->device         = read_sysfs_hex(dir_fd, name, "device");
+    gpu->subvendor      = read_sysfs_hex(dir_fd, name, "subsystem_vendor");
+    gpu->subdevice      = read_sysfs_hex(dir_fd, name, "subsystem_device");
+    char driver[256], path[320];
+    snprintf(path, sizeof(path), "%s/driver", name);
+    ssize_t len    = read_link(dir_fd, path, driver, sizeof(driver) - 1);
+    gpu->driver[0] = '\0';
+    if (len > 0) {
+      driver[len]      = '\0';
+      const char* base = strrchr(driver, '/');
+      snprintf(gpu->driver, sizeof(gpu->driver), "%.63s", base ? base + 1 : driver);
+    }
+  }
+}
+
+// lists the display controllers from sysfs, without lshw or lspci; *gpus must be freed
+static int find_pci_gpus(const char* devices_dir, struct pci_gpu** gpus) {
+  struct pci_scan scan = {NULL, 0, 0};
+  walk_dir(AT_FDCWD, devices_dir, scan_pci_device, &scan);
+  *gpus = scan.gpus;
+  return scan.count;
+}
+
+// marks the gpu at an address printed by lshw ("0000:01:00.0") or lspci, which leaves the domain out ("01:00.0")
+static void list_pci_gpu(struct pci_gpu* gpus, int count, const char* address, size_t len) {
+  for (int i = 0; i < count; i++) {
+    size_t gpu_len = strlen(gpus[i].address);
+    if (len > 0 && len <= gpu_len && memcmp(gpus[i].address + gpu_len - len, address, len) == 0 &&
+        (len == gpu_len || gpus[i].address[gpu_len - len - 1] == ':'))
+      gpus[i].listed = true;
+  }
+}
+#endif // __linux__
+
+// formats a gpu name in place and appends it to the gpus
+static void add_gpu_name(struct info* user_info, char* name) {
+  remove_brackets(name);
+  truncate_str(name, user_info->target_width);
+  LOG_V(name);
+  add_gpu(user_info, name, strlen(name));
+}
+
+#ifdef __linux__
+// appends a gpu pci.ids does not know as its ids and driver
+static void add_pci_ids(struct info* user_info, const struct pci_gpu* gpu) {
+  char ids[24 + sizeof(gpu->driver)];
+  snprintf(ids, sizeof(ids), "%04x:%04x %s", gpu->vendor, gpu->device, gpu->driver);
+  add_gpu_name(user_info, ids);
+}
+
+// names the gpus like lspci does ("vendor device"), the ones pci.ids does not know keep their ids. Returns 0 if it
+// knows none of them, lshw and lspci might
+static int name_pci_gpus(struct info* user_info, const struct pci_gpu* gpus, int count) {
+  if (count == 0) return 0;
+  const struct pciids_entry *vendors[count], *devices[count];
+  int named = 0;
+  for (int i = 0; i < count; i++) {
+    vendors[i] = lookup_pciids(PCIIDS_KEY(gpus[i].vendor, PCIIDS_NO_DEVICE, PCIIDS_NO_SUBSYSTEM));
+    devices[i] = lookup_pciids(PCIIDS_KEY(gpus[i].vendor, gpus[i].device, PCIIDS_NO_SUBSYSTEM));
+    if (vendors[i] && devices[i]) named++;
+  }
+  if (named == 0) return 0;
+  for (int i = 0; i < count; i++) {
+    size_t len = vendors[i] && devices[i] ? vendors[i]->name_len + 1 + devices[i]->name_len : 0;
+    char* name = len > 0 ? info_scratch(user_info, len + 1) : NULL;
+    if (!name) {
+      LOG_I("gpu %04x:%04x (%s): not in pci.ids", gpus[i].vendor, gpus[i].device, gpus[i].driver);
+      add_pci_ids(user_info, &gpus[i]);
+      continue;
+    }
+    snprintf(name, len + 1, "%.*s %.*s", (int)vendors[i]->name_len, pciids.strings + vendors[i]->name_offset,
+             (int)devices[i]->name_len, pciids.strings + devices[i]->name_offset);
+    LOG_I("gpu %04x:%04x (%s): %s", gpus[i].vendor, gpus[i].device, gpus[i].driver, name);
+    add_gpu_name(user_info, name);
+  }
+  return count;
+}
+#endif // __linux__
+
+// tries to get installed gpu(s)
+void* get_gpu(void* argp) {
+  if (!((struct thread_varg*)argp)->thread_flags[2]) return 0;
+  LOG_I("getting gpu(s)");
+  struct info* user_info = ((struct thread_varg*)argp)->user_info;
+  int gpuc               = 0; // gpu counter
+  user_info->gpu_count   = 0;
+#ifdef __linux__
+  // sysfs lists the display controllers without running anything, pci.ids names them
+  struct pci_gpu* pci_gpus;
+  int pci_gpuc = find_pci_gpus(PCI_DEVICES_DIR, &pci_gpus);
+  gpuc         = name_pci_gpus(user_info, pci_gpus, pci_gpuc);
+  if (gpuc > 0) {
+    free(pci_gpus);
+    return 0;
+  }
+#endif
+#ifndef _WIN32
+  #ifndef __APPLE__
+  const char* lshw_argv[]    = {"lshw", "-class", "display", NULL};
+  const char* lspci_argv[]   = {"lspci", "-mm", NULL};
+  const char* getprop_argv[] = {"getprop", "ro.hardware.vulkan", NULL}; // for android
+  // lshw is more accurate, the fallback runs at the same time in case lshw finds nothing
+  struct probe probes[] = {{.argv = lshw_argv, .timeout_ms = 3000},
+                           {.argv = strcmp(user_info->os_name, "android") != 0 ? lspci_argv : getprop_argv}};
+  #else
+  const char* profiler_argv[] = {"system_profiler", "SPDisplaysDataType", NULL};
+  struct probe probes[]       = {{.argv = profiler_argv, .timeout_ms = 3000}};
+  #endif
+  const int probe_count = sizeof(probes) / sizeof(probes[0]);
+  run_probes(probes, probe_count);
+
+  for (int i = 0; i < probe_count && gpuc == 0; i++) {
+    const char *pos = probes[i].output, *end = probes[i].output + probes[i].output_len, *line;
+    size_t len;
+    while ((line = next_line(&pos, end, &len))) {
+      const char *name = NULL, *name_end = line + len;
+  #ifndef __APPLE__
+      if (probes[i].argv == lshw_argv) {
+        while (line < name_end && *line == ' ') line++;
+        if (name_end - line > 9 && memcmp(line, "product: ", 9) == 0) name = line + 9;
+    #ifdef __linux__
+        if (name_end - line > 14 && memcmp(line, "bus info: pci@", 14) == 0)
+          list_pci_gpu(pci_gpus, pci_gpuc, line + 14, name_end - line - 14);
+    #endif
+      } else if (probes[i].argv == lspci_argv) {
+        // slot "class" "vendor" "device" ...: keeping what is between the third and the sixth quote
+        if (!memmem(line, len, "VGA", 3)) continue;
+    #ifdef __linux__
+        const char* slot_end = memchr(line, ' ', len);
+        list_pci_gpu(pci_gpus, pci_gpuc, line, slot_end ? (size_t)(slot_end - line) : len);
+    #endif
+        int quotes = 0;
+        for (const char* c = line; c < line + len && quotes < 6; c++) {
+          if (*c != '"') continue;
+          if (++quotes == 3) name = c + 1;
+          if (quotes == 6) name_end = c;
+        }
+        if (quotes < 6) name = NULL;
+      } else if (len > 0)
+        name = line;
+  #else
+      while (line < name_end && *line == ' ') line++;
+      if (name_end - line > 15 && memcmp(line, "Chipset Model: ", 15) == 0) name = line + 15;
+  #endif
+      if (!name) continue;
+      // the quotes between vendor and device are dropped, like awk did
+      char* gpu_name      = info_scratch(user_info, name_end - name + 1);
+      size_t gpu_name_len = 0;
+      if (!gpu_name) continue;
+      for (; name < name_end; name++)
+        if (*name != '"') gpu_name[gpu_name_len++] = *name;
+      gpu_name[gpu_name_len] = '\0';
+      if (gpu_name_len > 0) {
+        add_gpu_name(user_info, gpu_name);
+        gpuc++;
+      }
+    }
+  }
+  free_probes(probes, probe_count);
+  #ifdef __linux__
+  // the ids of the gpus neither lshw nor lspci listed are better than no gpu at all
+  for (int i = 0; i < pci_gpuc; i++)
+    if (!pci_gpus[i].listed) add_pci_ids(user_info, &pci_gpus[i]);
+  free(pci_gpus);
+  #endif
+#else
+  char* buffer = ((struct thread_varg*)argp)->buffer;
+  FILE* gpu    = popen("wmic PATH Win32_VideoController GET Name", "r");
+
+  // get all the gpus
+  while (fgets(buffer, BUFFER_SIZE, gpu)) {
+    buffer[strcspn(buffer, "\n")] = '\0';
+    if (!strstr(buffer, "Name") && strlen(buffer) > 1) add_gpu_name(user_info, buffer); // not the "\r" of blank lines
+  }
+  pclose(gpu);
+#endif
+  return 0;
+}
+
+#ifndef _WIN32
+// strcmp with the runs of digits compared by value, so that DP-2 comes before DP-10
+static int compare_natural(const char* a, const char* b) {
+  while (*a && *b) {
+    if (*a >= '0' && *a <= '9' && *b >= '0' && *b <= '9') {
+      while (*a == '0') a++;
+      while (*b == '0') b++;
+      size_t a_len = strspn(a, "0123456789"), b_len = strspn(b, "0123456789");
+      if (a_len != b_len) return a_len < b_len ? -1 : 1;
+      int cmp = strncmp(a, b, a_len);
+      if (cmp != 0) return cmp;
+      a += a_len;
+      b += b_len;
+    } else if (*a != *b)
+      return (unsigned char)*a - (unsigned char)*b;
+    else {
+      a++;
+      b++;
+    }
+  }
+  return (unsigned char)*a - (unsigned char)*b;
+}
+
+static void add_screen(struct info* user_info, const char* name, int width, int height) {
+  int i = user_info->screen_count;
+  if (i >= (int)(sizeof(user_info->screen_widths) / sizeof(user_info->screen_widths[0]))) {
+    // more outputs than room: the ones that sort first are kept, whatever the directory order
+    i = 0;
+    for (int j = 1; j < user_info->screen_count; j++)
+      if (compare_natural(user_info->screen_names[j], user_info->screen_names[i]) > 0) i = j;
+    if (compare_natural(name, user_info->screen_names[i]) >= 0) return;
+  } else
+    user_info->screen_count++;
+  set_info(user_info, &user_info->screen_names[i], name, strlen(name));
+  user_info->screen_widths[i]  = width;
+  user_info->screen_heights[i] = height;
+}
+
+  #ifdef __linux__
+    #define DRM_CLASS_DIR "/sys/class/drm"
+    #define FB_CLASS_DIR "/sys/class/graphics"
+
+// card<N>-<connector>: connected outputs list their modes, the preferred (native) one first; the mode a compositor or
+// xrandr set instead is not in sysfs
+static void add_drm_screen(void* ctx, int dir_fd, const char* name, unsigned char type) {
+  (void)type;
+  const char* connector = strchr(name, '-');
+  if (strncmp(name, "card", 4) != 0 || !connector) return;
+  char path[320], value[64];
+  snprintf(path, sizeof(path), "%s/status", name);
+  if (read_attr(dir_fd, path, value, sizeof(value)) < 0 || strcmp(value, "connected") != 0) return;
+  snprintf(path, sizeof(path), "%s/enabled", name);
+  if (read_attr(dir_fd, path, value, sizeof(value)) >= 0 && strcmp(value, "disabled") == 0) return;
+  snprintf(path, sizeof(path), "%s/modes", name);
+  int width, height;
+  if (read_attr(dir_fd, path, value, sizeof(value)) > 0 && sscanf(value, "%dx%d", &width, &height) == 2)
+    add_screen(ctx, connector + 1, width, height);
+}
+
+// fb<N>: framebuffer consoles without kms, "width,height"
+static void add_fb_screen(void* ctx, int dir_fd, const char* name, unsigned char type) {
+  (void)type;
+  if (strncmp(name, "fb", 2) != 0) return;
+  char path[320], value[64];
+  snprintf(path, sizeof(path), "%s/virtual_size", name);
+  int width, height;
+  if (read_attr(dir_fd, path, value, sizeof(value)) > 0 && sscanf(value, "%d,%d", &width, &height) == 2)
+    add_screen(ctx, name, width, height);
+}
+
+// directory order is arbitrary, outputs are listed by name (DP-2 before DP-10) so that the first one stays the same
+static void sort_screens(struct info* user_info) {
+  for (int i = 1; i < user_info->screen_count; i++)
+    for (int j = i; j > 0 && compare_natural(user_info->screen_names[j - 1], user_info->screen_names[j]) > 0; j--) {
+      const char* name = user_info->screen_names[j];
+      int width = user_info->screen_widths[j], height = user_info->screen_heights[j];
+      user_info->screen_names[j]     = user_info->screen_names[j - 1];
+      user_info->screen_names[j - 1] = name;
+      user_info->screen_widths[j]      = user_info->screen_widths[j - 1];
+      user_info->screen_heights[j]     = user_info->screen_heights[j - 1];
+      user_info->screen_widths[j - 1]  = width;
+      user_info->screen_heights[j - 1] = height;
+    }
+}
+  #endif // __linux__
+#endif
+
+// tries to get screen resolution
+#ifndef _WIN32
+void* get_res(void* argp) {
+  if (!((struct thread_varg*)argp)->thread_flags[3]) return 0;
+  LOG_I("getting resolution");
+  struct info* user_info = ((struct thread_varg*)argp)->user_info;
+  user_info->screen_count = 0;
+  #ifdef __linux__
+  // the kernel knows every output, with or without a display server
+  walk_dir(AT_FDCWD, DRM_CLASS_DIR, add_drm_screen, user_info);
+  if (user_info->screen_count == 0) walk_dir(AT_FDCWD, FB_CLASS_DIR, add_fb_screen, user_info);
+  if (user_info->screen_count > 1) sort_screens(user_info);
+  #endif
+  if (user_info->screen_count == 0) {
+    const char* xwininfo_argv[] = {"xwininfo", "-root", NULL};
+    struct probe xwininfo       = {.argv = xwininfo_argv};
+    char width[16] = "", height[16] = "";
+    run_probes(&xwininfo, 1);
+    probe_field(&xwininfo, "Width:", width, sizeof(width));
+    probe_field(&xwininfo, "Height:", height, sizeof(height));
+    free_probes(&xwininfo, 1);
+    if (atoi(width) > 0 && atoi(height) > 0) add_screen(user_info, "X", atoi(width), atoi(height));
+  }
+  user_info->screen_width  = user_info->screen_count > 0 ? user_info->screen_widths[0] : 0;
+  user_info->screen_height = user_info->screen_count > 0 ? user_info->screen_heights[0] : 0;
+  LOG_V(user_info->screen_count);
+  LOG_V(user_info->screen_width);
+  LOG_V(user_info->screen_height);
+#else
+void* get_res() {
+  // TODO: get resolution on windows
+#endif
+  return 0;
+}
+
+#ifndef _WIN32
+// pacman: one directory per package in the local database
+static int count_pacman(const char* db_path) { return count_subdirs(AT_FDCWD, db_path); }
+
+// portage: one directory per package in every category directory
+static void count_portage_category(void* count, int dir_fd, const char* name, unsigned char type) {
+  if (!is_dir_entry(dir_fd, name, type)) return;
+  int category_count = count_subdirs(dir_fd, name);
+  if (category_count > 0) *(int*)count += category_count;
+}
+
+static int count_portage(const char* db_path) {
+  int count = 0;
+  if (walk_dir(AT_FDCWD, db_path, count_portage_category, &count) < 0) return -1;
+  return count;
+}
+
+// dpkg: stanzas separated by blank lines, only the ones with an installed status count
+struct dpkg_scan {
+  int count;
+  bool has_package, installed;
+};
+
+static void dpkg_line(void* ctx, const char* line, size_t len) {
+  struct dpkg_scan* scan = ctx;
+  if (len == 0) { // end of the stanza
+    if (scan->has_package && scan->installed) scan->count++;
+    scan->has_package = scan->installed = false;
+  } else if (len > 8 && memcmp(line, "Package:", 8) == 0)
+    scan->has_package = true;
+  else if (len > 7 && memcmp(line, "Status:", 7) == 0) // "Status: <want> <flag> <status>"
+    scan->installed = len >= 10 && memcmp(line + len - 10, " installed", 10) == 0;
+}
+
+static int count_dpkg(const char* db_path) {
+  char* data;
+  size_t len;
+  if (map_file(db_path, &data, &len) < 0) return -1;
+  struct dpkg_scan scan = {0};
+  if (data) scan_lines(data, len, dpkg_line, &scan);
+  dpkg_line(&scan, "", 0); // the last stanza may not end with a blank line
+  unmap_file(data, len);
+  return scan.count;
+}
+
+// apk: every package record starts with a "P:<name>" line
+static void apk_line(void* count, const char* line, size_t len) {
+  if (len > 2 && line[0] == 'P' && line[1] == ':') (*(int*)count)++;
+}
+
+static int count_apk(const char* db_path) {
+  char* data;
+  size_t len;
+  int count = 0;
+  if (map_file(db_path, &data, &len) < 0) return -1;
+  if (data) scan_lines(data, len, apk_line, &count);
+  unmap_file(data, len);
+  return count;
+}
+
+// xbps: the pkgdb plist has a dictionary with a pkgver key for every package
+static int count_xbps(const char* db_path) {
+  char* data;
+  size_t len;
+  int count = 0;
+  if (map_file(db_path, &data, &len) < 0) return -1;
+  const char key[]     = "<key>pkgver</key>";
+  const size_t key_len = sizeof(key) - 1;
+  for (const char* p = data; p && (size_t)(data + len - p) >= key_len; p++) {
+    p = memchr(p, '<', data + len - p);
+    if (!p || (size_t)(data + len - p) < key_len) break;
+    if (memcmp(p, key, key_len) == 0) count++;
+  }
+  unmap_file(data, len);
+  return count;
+}
+
+// builds $HOME/relative_path, returns false if HOME is not set or the probes are in another root
+static bool home_path(char* dst, size_t dst_size, const char* relative_path) {
+  const char* home = input_env("HOME");
+  if (!home || root_fd != AT_FDCWD) return false;
+  return snprintf(dst, dst_size, "%s/%s", home, relative_path) < (int)dst_size;
+}
+
+// flatpak: every installed ref is a <kind>/<name>/<arch>/<branch> directory
+static void count_flatpak_branches(void* count, int dir_fd, const char* name, unsigned char type) {
+  if (!is_dir_entry(dir_fd, name, type)) return;
+  int branch_count = count_subdirs(dir_fd, name);
+  if (branch_count > 0) *(int*)count += branch_count;
+}
+
+static void count_flatpak_ref(void* count, int dir_fd, const char* name, unsigned char type) {
+  if (!is_dir_entry(dir_fd, name, type)) return;
+  size_t len = strlen(name);
+  // locale, debug and source extensions are hidden by "flatpak list"
+  const char* hidden[] = {".Locale", ".Debug", ".Sources"};
+  for (size_t i = 0; i < sizeof(hidden) / sizeof(hidden[0]); i++) {
+    size_t suffix_len = strlen(hidden[i]);
+    if (len > suffix_len && strcmp(name + len - suffix_len, hidden[i]) == 0) return;
+  }
+  int arch_count = 0;
+  walk_dir(dir_fd, name, count_flatpak_branches, &arch_count);
+  *(int*)count += arch_count;
+}
+
+// counts the refs of one installation, returns -1 if there is no installation there
+static int count_flatpak_installation(const char* path) {
+  int count = 0, found = -1;
+  char kind_path[512];
+  const char* kinds[] = {"app", "runtime"};
+  for (int i = 0; i < 2; i++) {
+    if (snprintf(kind_path, sizeof(kind_path), "%s/%s", path, kinds[i]) >= (int)sizeof(kind_path)) continue;
+    if (walk_dir(AT_FDCWD, kind_path, count_flatpak_ref, &count) == 0) found = 0;
+  }
+  return found < 0 ? -1 : count;
+}
+
+static int count_flatpak(const char* db_path) {
+  char user_path[512];
+  int system_count = count_flatpak_installation(db_path), user_count = -1;
+  if (home_path(user_path, sizeof(user_path), ".local/share/flatpak"))
+    user_count = count_flatpak_installation(user_path);
+  if (system_count < 0 && user_count < 0) return -1;
+  return (system_count > 0 ? system_count : 0) + (user_count > 0 ? user_count : 0);
+}
+
+// snap: snapd keeps one <name>_<revision>.snap file per installed revision
+struct snap_scan {
+  char (*names)[128];
+  int count, capacity;
+};
+
+static void collect_snap(void* ctx, int dir_fd, const char* name, unsigned char type) {
+  (void)dir_fd;
+  (void)type;
+  struct snap_scan* scan = ctx;
+  const char* revision   = strrchr(name, '_');
+  size_t len             = strlen(name);
+  if (!revision || len < 5 || strcmp(name + len - 5, ".snap") != 0) return;
+  if ((size_t)(revision - name) >= sizeof(scan->names[0])) return;
+  if (scan->count == scan->capacity) {
+    int capacity     = scan->capacity ? scan->capacity * 2 : 64;
+    char(*names)[128] = realloc(scan->names, capacity * sizeof(scan->names[0]));
+    if (!names) return;
+    scan->names    = names;
+    scan->capacity = capacity;
+  }
+  memcpy(scan->names[scan->count], name, revision - name);
+  scan->names[scan->count++][revision - name] = '\0';
+}
+
+static int compare_names(const void* a, const void* b) { return strcmp(a, b); }
+
+static int count_snap(const char* db_path) {
+  struct snap_scan scan = {0};
+  if (walk_dir(AT_FDCWD, db_path, collect_snap, &scan) < 0) return -1;
+  // a snap with several revisions on disk is still one package
+  qsort(scan.names, scan.count, sizeof(scan.names[0]), compare_names);
+  int count = 0;
+  for (int i = 0; i < scan.count; i++)
+    if (i == 0 || strcmp(scan.names[i], scan.names[i - 1]) != 0) count++;
+  free(scan.names);
+  return count;
+}
+
+// nix: the system profile is a tree of symlinks into the store, every distinct store path is a package
+  #define NIX_STORE_DIR "/nix/store/"
+  #define NIX_HASH_LEN 32
+
+struct nix_scan {
+  unsigned long long* hashes; // open addressing set of store path hashes
+  int count, capacity, depth;
+};
+
+static void nix_add_store_path(struct nix_scan* scan, const char* target) {
+  if (strncmp(target, NIX_STORE_DIR, sizeof(NIX_STORE_DIR) - 1) != 0) return;
+  target += sizeof(NIX_STORE_DIR) - 1;
+  if (strlen(target) < NIX_HASH_LEN) return;
+  unsigned long long hash = 1469598103934665603ULL; // fnv-1a of the store hash
+  for (int i = 0; i < NIX_HASH_LEN; i++) hash = (hash ^ (unsigned char)target[i]) * 1099511628211ULL;
+  if (hash == 0) hash = 1; // 0 marks empty slots
+  if (scan->count * 2 >= scan->capacity) {
+    int capacity                 = scan->capacity ? scan->capacity * 2 : 1024;
+    unsigned long long* hashes   = calloc(capacity, sizeof(*hashes));
+    if (!hashes) return;
+    for (int i = 0; i < scan->capacity; i++) {
+      if (!scan->hashes[i]) continue;
+      int slot = scan->hashes[i] & (capacity - 1);
+      while (hashes[slot]) slot = (slot + 1) & (capacity - 1);
+      hashes[slot] = scan->hashes[i];
+    }
+    free(scan->hashes);
+    scan->hashes   = hashes;
+    scan->capacity = capacity;
+  }
+  int slot = hash & (scan->capacity - 1);
+  while (scan->hashes[slot] && scan->hashes[slot] != hash) slot = (slot + 1) & (scan->capacity - 1);
+  if (!scan->hashes[slot]) {
+    scan->hashes[slot] = hash;
+    scan->count++;
+  }
+}
+
+static void nix_scan_entry(void* ctx, int dir_fd, const char* name, unsigned char type) {
+  struct nix_scan* scan = ctx;
+  if (type == DT_LNK || type == DT_UNKNOWN) {
+    char target[512];
+    ssize_t len = read_link(dir_fd, name, target, sizeof(target) - 1);
+    if (len > 0) {
+      target[len] = '\0';
+      nix_add_store_path(scan, target);
+      return;
+    }
+  }
+  // directories shared by several packages are real directories with links inside
+  if (scan->depth < 8 && is_dir_entry(dir_fd, name, type)) {
+    scan->depth++;
+    walk_dir(dir_fd, name, nix_scan_entry, scan);
+    scan->depth--;
+  }
+}
+
+// counts the elements of a nix profile manifest (manifest.json for nix profile, manifest.nix for nix-env)
+static int count_nix_manifest(const char* profile) {
+  char path[PATH_MAX];
+  const char* manifests[][2] = {{"manifest.json", "\"storePaths\""}, {"manifest.nix", "type = \"derivation\""}};
+  for (int i = 0; i < 2; i++) {
+    char* data;
+    size_t len;
+    if (snprintf(path, sizeof(path), "%s/%s", profile, manifests[i][0]) >= (int)sizeof(path)) continue;
+    if (map_file(path, &data, &len) < 0) continue;
+    int count         = 0;
+    size_t needle_len = strlen(manifests[i][1]);
+    for (size_t pos = 0; data && pos + needle_len <= len; pos++)
+      if (data[pos] == manifests[i][1][0] && memcmp(data + pos, manifests[i][1], needle_len) == 0) count++;
+    unmap_file(data, len);
+    return count;
+  }
+  return -1;
+}
+
+static int count_nix(const char* db_path) {
+  struct nix_scan scan = {0};
+  char user_profile[512];
+  int system_found = walk_dir(AT_FDCWD, db_path, nix_scan_entry, &scan) == 0, user_count = -1;
+  free(scan.hashes);
+  if (home_path(user_profile, sizeof(user_profile), ".nix-profile"))
+    user_count = count_nix_manifest(user_profile);
+  if (!system_found && user_count < 0) return -1;
+  return scan.count + (user_count > 0 ? user_count : 0);
+}
+
+// guix: the profile manifest is an s-expression with one list per package in (packages (...))
+static int count_guix(const char* db_path) {
+  char path[512];
+  char* data;
+  size_t len;
+  if (!home_path(path, sizeof(path), db_path) || map_file(path, &data, &len) < 0) return -1;
+  const char key[] = "(packages";
+  int count = 0, depth = 0, packages_depth = -1;
+  bool in_string = false;
+  for (size_t pos = 0; data && pos < len; pos++) {
+    char c = data[pos];
+    if (in_string) {
+      if (c == '\\')
+        pos++;
+      else if (c == '"')
+        in_string = false;
+    } else if (c == '"')
+      in_string = true;
+    else if (c == '(') {
+      if (packages_depth < 0 && len - pos >= sizeof(key) - 1 && memcmp(data + pos, key, sizeof(key) - 1) == 0)
+        packages_depth = depth + 1;
+      else if (packages_depth >= 0 && depth == packages_depth + 1)
+        count++; // (packages ((entry) (entry) ...))
+      depth++;
+    } else if (c == ')') {
+      if (--depth < packages_depth) break;
+    }
+  }
+  unmap_file(data, len);
+  return count;
+}
+
+// brew: one directory per formula in the Cellar and per cask in the Caskroom, db_path is one of the two
+static int count_brew(const char* db_path) {
+  char path[512];
+  const char* prefixes[] = {input_env("HOMEBREW_PREFIX"), "/home/linuxbrew/.linuxbrew", "/opt/homebrew", "/usr/local"};
+  for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++) {
+    if (!prefixes[i]) continue;
+    snprintf(path, sizeof(path), "%s/%s", prefixes[i], db_path);
+    int count = count_subdirs(AT_FDCWD, path);
+    if (count >= 0) return count;
+  }
+  if (!home_path(path, sizeof(path), ".linuxbrew/")) return -1;
+  strncat(path, db_path, sizeof(path) - strlen(path) - 1);
+  return count_subdirs(AT_FDCWD, path);
+}
+
+struct pkg_count_job {
+  struct package_manager* pkgman;
+  int count;
+};
+
+// whether a package manager has a database for native_count, no thread is started for the ones that are not installed
+static bool pkg_db_present(const struct package_manager* pkgman) {
+  char path[512];
+  if (pkgman->home_db_path && home_path(path, sizeof(path), pkgman->home_db_path) && input_exists(path)) return true;
+  if (pkgman->db_path[0] == '/') return input_exists(pkgman->db_path);
+  return !pkgman->home_db_path; // brew looks its db_path up in its prefixes itself
+}
+
+// runs the native counter of a package manager, the stores are independent so each one gets a thread
+static void* run_native_count(void* argp) {
+  struct pkg_count_job* job = argp;
+  job->count                = job->pkgman->native_count(job->pkgman->db_path);
+  return 0;
+}
+
+  #ifndef __APPLE__
+// all supported package managers
+static struct package_manager pkgmans[] = {
+    {PKGPATH "apt", {"apt", "list", "--installed"}, 1, false, "(apt)", PKGDB_PREFIX "/var/lib/dpkg/status", count_dpkg, NULL},
+    {PKGPATH "apk", {"apk", "info"}, 0, false, "(apk)", PKGDB_PREFIX "/lib/apk/db/installed", count_apk, NULL},
+    // {PKGPATH"dnf",{"dnf", "list", "installed"}, 1, false, "(dnf)"}, // according to https://stackoverflow.com/questions/48570019/advantages-of-dnf-vs-rpm-on-fedora, dnf and rpm return the same number of packages
+    {PKGPATH "qlist", {"qlist", "-I"}, 0, false, "(emerge)", PKGDB_PREFIX "/var/db/pkg", count_portage, NULL},
+    {PKGPATH "flatpak", {"flatpak", "list"}, 0, false, "(flatpak)", PKGDB_PREFIX "/var/lib/flatpak", count_flatpak, ".local/share/flatpak"},
+    {PKGPATH "snap", {"snap", "list"}, 1, false, "(snap)", PKGDB_PREFIX "/var/lib/snapd/snaps", count_snap, NULL},
+    {PKGPATH "guix", {"guix", "package", "--list-installed"}, 0, false, "(guix)", ".guix-profile/manifest", count_guix, ".guix-profile/manifest"},
+    {PKGPATH "nix-store", {"nix-store", "-q", "--requisites", "/run/current-system/sw"}, 0, false, "(nix)", "/run/current-system/sw", count_nix, ".nix-profile"},
+    {PKGPATH "pacman", {"pacman", "-Qq"}, 0, false, "(pacman)", PKGDB_PREFIX "/var/lib/pacman/local", count_pacman, NULL},
+    {PKGPATH "pkg", {"pkg", "info"}, 0, false, "(pkg)", NULL, NULL, NULL},
+    {PKGPATH "pkg_info", {"pkg_info"}, 0, false, "(pkg)", NULL, NULL, NULL},
+    {PKGPATH "port", {"port", "installed"}, 1, false, "(port)", NULL, NULL, NULL},
+    {PKGPATH "brew", {"brew", "--cellar"}, 0, true, "(brew-cellar)", "Cellar", count_brew, NULL},
+    {PKGPATH "brew", {"brew", "--caskroom"}, 0, true, "(brew-cask)", "Caskroom", count_brew, NULL},
+    {PKGPATH "rpm", {"rpm", "-qa"}, 0, false, "(rpm)", NULL, NULL, NULL},
+    {PKGPATH "xbps-query", {"xbps-query", "-l"}, 0, false, "(xbps)", PKGDB_PREFIX "/var/db/xbps/pkgdb-0.38.plist", count_xbps, NULL}};
+  #else
+static struct package_manager pkgmans[] = {{"/usr/local/bin/brew", {"/usr/local/bin/brew", "--cellar"}, 0, true, "(brew-cellar)", "Cellar", count_brew, NULL},
+                                           {"/usr/local/bin/brew", {"/usr/local/bin/brew", "--caskroom"}, 0, true, "(brew-cask)", "Caskroom", count_brew, NULL}};
+  #endif
+#endif // _WIN32
+
+// "count (name), count (name)" like the package managers were found
+void format_pkgman_name(struct info* user_info) {
+  size_t size     = 1;
+  user_info->pkgs = 0;
+  for (int i = 0; i < user_info->pkgman_count; i++)
+    if (user_info->pkgman_pkgs[i] > 0) {
+      user_info->pkgs += user_info->pkgman_pkgs[i];
+      size += sizeof(", 2147483647 ") + info_len(user_info->pkgman_list[i]);
+    }
+  char* pkgman_name = info_scratch(user_info, size);
+  size_t len        = 0;
+  for (int i = 0; pkgman_name && i < user_info->pkgman_count; i++) {
+    if (user_info->pkgman_pkgs[i] <= 0) continue;
+    len += snprintf(pkgman_name + len, size - len, "%s%d %s", len > 0 ? ", " : "", user_info->pkgman_pkgs[i],
+                    user_info->pkgman_list[i]);
+  }
+  set_info(user_info, &user_info->pkgman_name, pkgman_name, len);
+  LOG_V(user_info->pkgman_name);
+}
+
+// tries to get the installed package count and package managers name
+void* get_pkg(void* argp) { // this is just a function that returns the total of installed packages
+  if (!((struct thread_varg*)argp)->thread_flags[4]) return 0;
+  LOG_I("getting pkgs");
+  struct info* user_info = ((struct thread_varg*)argp)->user_info;
+  user_info->pkgs        = 0;
+#ifndef _WIN32
+  const int pkgman_count = sizeof(pkgmans) / sizeof(pkgmans[0]); // number of package managers
+  user_info->pkgman_count = 0;
+
+  // reading all the package databases at the same time
+  struct pkg_count_job jobs[pkgman_count];
+  pthread_t job_tids[pkgman_count];
+  bool started[pkgman_count];
+  for (int i = 0; i < pkgman_count; i++) {
+    jobs[i]    = (struct pkg_count_job){&pkgmans[i], -1};
+    started[i] = false;
+    if (!pkgmans[i].native_count || !pkg_db_present(&pkgmans[i])) continue;
+    started[i] = pthread_create(&job_tids[i], NULL, run_native_count, &jobs[i]) == 0;
+    if (!started[i]) run_native_count(&jobs[i]);
+  }
+  for (int i = 0; i < pkgman_count; i++)
+    if (started[i]) pthread_join(job_tids[i], NULL);
+
+  // the package managers whose database could not be read run all at once
+  struct probe probes[pkgman_count];
+  int probe_of[pkgman_count], probe_count = 0;
+  for (int i = 0; i < pkgman_count; i++) {
+    probe_of[i] = -1;
+    if (jobs[i].count >= 0) continue;
+    if (!input_exists(pkgmans[i].command_path)) {
+      LOG_W("pkgman %s executable not found!", pkgmans[i].pkgman_name);
+      continue;
+    }
+    probe_of[i]            = probe_count;
+    probes[probe_count++] = (struct probe){.argv = pkgmans[i].command_argv};
+  }
+  run_probes(probes, probe_count);
+
+  for (int i = 0; i < pkgman_count; i++) {
+    struct package_manager* current = &pkgmans[i]; // pointer to current package manager
+
+    unsigned int pkg_count = 0;
+    LOG_I("trying pkgman %d: %s", i, current->pkgman_name);
+    if (jobs[i].count >= 0) { // the database could be read directly, no need to run the package manager
+      LOG_I("counted %d packages from %s", jobs[i].count, current->db_path);
+      pkg_count = jobs[i].count;
+    } else if (probe_of[i] >= 0 && probes[probe_of[i]].status == 0) {
+      struct probe* probe = &probes[probe_of[i]];
+      int count           = 0;
+      if (current->prints_directory) {
+        while (probe->output_len > 0 && probe->output[probe->output_len - 1] == '\n') probe->output[--probe->output_len] = '\0';
+        count = probe->output_len > 0 ? count_subdirs(AT_FDCWD, probe->output) : 0;
+      } else
+        count = count_lines(probe) - current->header_lines;
+      if (count > 0) pkg_count = count;
+    }
+
+    // adding a package manager with its package count to the list
+    if (pkg_count > 0 && user_info->pkgman_count < (int)(sizeof(user_info->pkgman_pkgs) / sizeof(user_info->pkgman_pkgs[0]))) {
+      set_info(user_info, &user_info->pkgman_list[user_info->pkgman_count], current->pkgman_name, strlen(current->pkgman_name));
+      user_info->pkgman_pkgs[user_info->pkgman_count++] = pkg_count;
+    }
+  }
+  free_probes(probes, probe_count);
+  format_pkgman_name(user_info);
+#else  // _WIN32
+  // chocolatey for windows
+  FILE* fp = popen("choco list -l --no-color 2> nul", "r");
+  unsigned int pkg_count;
+  char buffer[7562] = {0};
+  while (fgets(buffer, BUFFER_SIZE, fp)) {
+    sscanf(buffer, "%u packages installed.", &pkg_count);
+  }
+  if (fp) pclose(fp);
+
+  user_info->pkgs = pkg_count;
+  set_infof(user_info, &user_info->pkgman_name, "%u (chocolatey)", pkg_count);
+  LOG_V(user_info->pkgman_name);
+#endif // _WIN32
+  return 0;
+}
+
+#ifdef __linux__
+struct os_release_scan {
+  FILE* out;
+  bool first;
+};
+
+// copies the ID, NAME, PRETTY_NAME and VERSION_ID lines of os-release
+static bool os_release_field(void* ctx, int id, const char* value, size_t len) {
+  static const char* names[] = {"id", "name", "pretty_name", "version_id"};
+  struct os_release_scan* scan = ctx;
+  len                          = unquote(&value, len);
+  fprintf(scan->out, "%s\"%s\":", scan->first ? "" : ",", names[id]);
+  write_json_string(scan->out, value, len);
+  scan->first = false;
+  return true;
+}
+
+struct module_tree_scan {
+  char (*names)[128];
+  int count, capacity;
+};
+
+static void collect_module_tree(void* ctx, int dir_fd, const char* name, unsigned char type) {
+  struct module_tree_scan* scan = ctx;
+  if (!is_dir_entry(dir_fd, name, type) || strlen(name) >= sizeof(scan->names[0])) return;
+  for (int i = 0; i < scan->count; i++) // /lib is usually a link to /usr/lib
+    if (strcmp(scan->names[i], name) == 0) return;
+  if (scan->count == scan->capacity) {
+    int capacity      = scan->capacity ? scan->capacity * 2 : 8;
+    char(*names)[128] = realloc(scan->names, capacity * sizeof(scan->names[0]));
+    if (!names) return;
+    scan->names    = names;
+    scan->capacity = capacity;
+  }
+  strcpy(scan->names[scan->count++], name);
+}
+
+// the parts of a sysroot record, in the order they are written
+static void write_os_release(FILE* out, const char* data, size_t len) {
+  struct os_release_scan scan = {out, true};
+  fputs(",\"os\":{", out);
+  static const struct field_key os_release_keys[] = {{"ID", 0}, {"NAME", 1}, {"PRETTY_NAME", 2}, {"VERSION_ID", 3}};
+  static struct field_table os_release_table       = FIELD_TABLE(os_release_keys);
+  if (data) scan_fields(data, len, '=', &os_release_table, os_release_field, &scan);
+  fputs("}", out);
+}
+
+static void write_pkg_count(FILE* out, bool* first, const struct package_manager* pkgman, int count) {
+  const char* name = pkgman->pkgman_name;
+  size_t name_len  = strlen(name);
+  if (name_len >= 2 && name[0] == '(') { // "(apt)"
+    name++;
+    name_len -= 2;
+  }
+  fputs(*first ? ",\"pkgs\":{" : ",", out);
+  write_json_string(out, name, name_len);
+  fprintf(out, ":%d", count);
+  *first = false;
+}
+
+static void write_module_trees(FILE* out, struct module_tree_scan* modules) {
+  fputs(",\"kernel_modules\":[", out);
+  if (modules->count > 0) qsort(modules->names, modules->count, sizeof(modules->names[0]), compare_names);
+  for (int i = 0; i < modules->count; i++) {
+    fputs(i > 0 ? "," : "", out);
+    write_json_string(out, modules->names[i], strlen(modules->names[i]));
+  }
+  fputs("]", out);
+  free(modules->names);
+}
+
+// image tarballs (docker save or an OCI layout) are read as a stream, layer by layer, without extracting anything:
+// only the members the collectors need are looked at and the memory used does not depend on the layer sizes
+  #define TAR_BLOCK_SIZE 512
+  #define TAR_BUFFER_SIZE (64 * 1024)
+
+struct tar_stream {
+  int fd;
+  unsigned long long offset, end; // bytes of the archive (compressed if gzip) not read yet
+  bool gzip;
+  #ifdef HAVE_ZLIB
+  z_stream z;
+  #endif
+  unsigned long long entry_left, entry_pad; // data of the current entry not read yet and its padding
+  unsigned char in[TAR_BUFFER_SIZE];      // compressed input
+  char data[TAR_BUFFER_SIZE];             // entry data, also where skipped data goes
+};
+
+struct tar_entry {
+  char path[512], link[256];
+  char type;
+  unsigned long long size;
+};
+
+// reads up to len bytes of the (uncompressed) archive, returns 0 at its end
+static size_t tar_read(struct tar_stream* tar, void* buf, size_t len) {
+  if (!tar->gzip) {
+    if (len > tar->end - tar->offset) len = tar->end - tar->offset;
+    ssize_t nread = len > 0 ? pread(tar->fd, buf, len, tar->offset) : 0;
+    if (nread <= 0) return 0;
+    tar->offset += nread;
+    return nread;
+  }
+  #ifdef HAVE_ZLIB
+  tar->z.next_out  = buf;
+  tar->z.avail_out = len;
+  while (tar->z.avail_out == len) {
+    if (tar->z.avail_in == 0) {
+      size_t chunk  = tar->end - tar->offset < sizeof(tar->in) ? tar->end - tar->offset : sizeof(tar->in);
+      ssize_t nread = chunk > 0 ? pread(tar->fd, tar->in, chunk, tar->offset) : 0;
+      if (nread <= 0) break;
+      tar->offset += nread;
+      tar->z.next_in  = tar->in;
+      tar->z.avail_in = nread;
+    }
+    int status = inflate(&tar->z, Z_NO_FLUSH);
+    if (status == Z_STREAM_END) // concatenated gzip members
+      inflateReset(&tar->z);
+    else if (status != Z_OK)
+      break;
+  }
+  return len - tar->z.avail_out;
+  #else
+  return 0;
+  #endif
+}
+
+static bool tar_read_full(struct tar_stream* tar, void* buf, size_t len) {
+  for (size_t done = 0, nread; done < len; done += nread)
+    if ((nread = tar_read(tar, (char*)buf + done, len - done)) == 0) return false;
+  return true;
+}
+
+static bool tar_skip(struct tar_stream* tar, unsigned long long len) {
+  if (!tar->gzip) { // nothing to decompress, the data is not even read
+    if (len > tar->end - tar->offset) return false;
+    tar->offset += len;
+    return true;
+  }
+  while (len > 0) {
+    size_t nread = tar_read(tar, tar->data, len < sizeof(tar->data) ? len : sizeof(tar->data));
+    if (nread == 0) return false;
+    len -= nread;
+  }
+  return true;
+}
+
+// reads up to len bytes of the data of the current entry
+static size_t tar_read_data(struct tar_stream* tar, void* buf, size_t len) {
+  if (len > tar->entry_left) len = tar->entry_left;
+  size_t nread = len > 0 ? tar_read(tar, buf, len) : 0;
+  tar->entry_left -= nread;
+  return nread;
+}
+
+// opens the member of fd at offset as a tar stream, false if it is compressed in a way that can't be read
+static bool tar_open(struct tar_stream* tar, int fd, unsigned long long offset, unsigned long long size) {
+  unsigned char magic[4] = {0};
+  tar->fd                = fd;
+  tar->offset            = offset;
+  tar->end               = offset + size;
+  tar->entry_left = tar->entry_pad = 0;
+  tar->gzip                        = pread(fd, magic, sizeof(magic), offset) >= 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+  if (!tar->gzip) return !(magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd); // zstd
+  #ifdef HAVE_ZLIB
+  memset(&tar->z, 0, sizeof(tar->z));
+  return inflateInit2(&tar->z, 16 + MAX_WBITS) == Z_OK; // gzip header
+  #else
+  return false;
+  #endif
+}
+
+static void tar_close(struct tar_stream* tar) {
+  #ifdef HAVE_ZLIB
+  if (tar->gzip) inflateEnd(&tar->z);
+  #endif
+  tar->gzip = false;
+}
+
+// numeric header fields are octal, or base-256 when they do not fit
+static unsigned long long tar_number(const unsigned char* field, size_t len) {
+  unsigned long long value = 0;
+  if (field[0] & 0x80) {
+    value = field[0] & 0x7f;
+    for (size_t i = 1; i < len; i++) value = value << 8 | field[i];
+    return value;
+  }
+  size_t i = 0;
+  while (i < len && field[i] == ' ') i++;
+  for (; i < len && field[i] >= '0' && field[i] <= '7'; i++) value = value * 8 + field[i] - '0';
+  return value;
+}
+
+// "./etc/os-release", "/etc/os-release" and "etc/os-release" are the same member
+static void tar_normalize_path(char* path) {
+  char* start = path;
+  while (start[0] == '/' || (start[0] == '.' && start[1] == '/')) start += start[0] == '/' ? 1 : 2;
+  size_t len = strlen(start);
+  while (len > 0 && start[len - 1] == '/') len--;
+  memmove(path, start, len);
+  path[len] = '\0';
+}
+
+// moves to the next header, skipping the rest of the current entry; false at the end of the archive
+static bool tar_next(struct tar_stream* tar, struct tar_entry* entry) {
+  char long_path[sizeof(entry->path)] = "", long_link[sizeof(entry->link)] = "";
+  for (;;) {
+    unsigned char header[TAR_BLOCK_SIZE];
+    if (!tar_skip(tar, tar->entry_left + tar->entry_pad)) return false;
+    tar->entry_left = tar->entry_pad = 0;
+    if (!tar_read_full(tar, header, sizeof(header)) || header[0] == '\0') return false;
+    unsigned long long checksum = 0;
+    for (int i = 0; i < TAR_BLOCK_SIZE; i++) checksum += i >= 148 && i < 156 ? ' ' : header[i];
+    if (checksum != tar_number(header + 148, 8)) return false;
+
+    entry->type     = header[156];
+    entry->size     = tar_number(header + 124, 12);
+    tar->entry_left = entry->size;
+    tar->entry_pad  = (TAR_BLOCK_SIZE - entry->size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+    if (entry->type == 'L' || entry->type == 'K') { // gnu long names, the name of the next entry is the data
+      char* dst   = entry->type == 'L' ? long_path : long_link;
+      size_t size = entry->type == 'L' ? sizeof(long_path) : sizeof(long_link);
+      dst[tar_read_data(tar, dst, size - 1)] = '\0';
+      continue;
+    }
+    if (entry->type == 'x') { // pax headers, "<length> <key>=<value>\n" records
+      size_t len     = tar_read_data(tar, tar->data, sizeof(tar->data));
+      const char* end = tar->data + len;
+      for (const char* record = tar->data; record < end;) {
+        // the data is not NUL terminated, the length is read within it and every record has to fit in it
+        const char* space = record;
+        size_t record_len = 0;
+        while (space < end && *space >= '0' && *space <= '9' && record_len <= len) record_len = record_len * 10 + (*space++ - '0');
+        if (space == record || space >= end || *space != ' ' || record_len > (size_t)(end - record) ||
+            record_len < (size_t)(space - record) + 2)
+          break;
+        const char* key = space + 1;
+        size_t key_room = record + record_len - 1 - key; // without the newline
+        if (key_room >= 5 && memcmp(key, "path=", 5) == 0 && key_room - 5 < sizeof(long_path))
+          memcpy(long_path, key + 5, key_room - 5), long_path[key_room - 5] = '\0';
+        else if (key_room >= 9 && memcmp(key, "linkpath=", 9) == 0 && key_room - 9 < sizeof(long_link))
+          memcpy(long_link, key + 9, key_room - 9), long_link[key_room - 9] = '\0';
+        record += record_len;
+      }
+      continue;
+    }
+    if (entry->type == 'g') continue; // global pax headers do not name anything
+
+    if (long_path[0])
+      strcpy(entry->path, long_path);
+    else if (memcmp(header + 257, "ustar", 5) == 0 && header[345]) // ustar splits long names in prefix/name
+      snprintf(entry->path, sizeof(entry->path), "%.155s/%.100s", header + 345, header);
+    else
+      snprintf(entry->path, sizeof(entry->path), "%.100s", header);
+    if (long_link[0])
+      strcpy(entry->link, long_link);
+    else
+      snprintf(entry->link, sizeof(entry->link), "%.100s", header + 157);
+    tar_normalize_path(entry->path);
+    return true;
+  }
+}
+
+// a set of member paths with the layer they come from
+struct image_paths {
+  char (*paths)[192];
+  int* layers;
+  int count, capacity;
+  int* slots; // 2 * capacity, open addressing on the path hashes: 0 if free, else the position of the path + 1
+};
+
+// the slot of path, or the free one where it goes
+static int* image_paths_slot(const struct image_paths* set, const char* path) {
+  unsigned mask = 2 * set->capacity - 1;
+  for (unsigned slot = key_hash(path, strlen(path)) & mask;; slot = (slot + 1) & mask)
+    if (!set->slots[slot] || strcmp(set->paths[set->slots[slot] - 1], path) == 0) return &set->slots[slot];
+}
+
+static void image_paths_index(struct image_paths* set) {
+  memset(set->slots, 0, 2 * set->capacity * sizeof(*set->slots));
+  for (int i = 0; i < set->count; i++) *image_paths_slot(set, set->paths[i]) = i + 1;
+}
+
+static void image_paths_add(struct image_paths* set, const char* path, int layer) {
+  int* slot = set->capacity ? image_paths_slot(set, path) : NULL;
+  if (slot && *slot) {
+    set->layers[*slot - 1] = layer;
+    return;
+  }
+  if (strlen(path) >= sizeof(set->paths[0])) return;
+  if (set->count == set->capacity) {
+    int capacity       = set->capacity ? set->capacity * 2 : 256;
+    char(*paths)[192]  = realloc(set->paths, capacity * sizeof(set->paths[0]));
+    if (paths) set->paths = paths;
+    int* layers = realloc(set->layers, capacity * sizeof(set->layers[0]));
+    if (layers) set->layers = layers;
+    int* slots = malloc(2 * capacity * sizeof(*slots));
+    if (!paths || !layers || !slots) {
+      free(slots);
+      return;
+    }
+    free(set->slots);
+    set->slots    = slots;
+    set->capacity = capacity;
+    image_paths_index(set);
+    slot = image_paths_slot(set, path);
+  }
+  strcpy(set->paths[set->count], path);
+  set->layers[set->count] = layer;
+  *slot                   = ++set->count;
+}
+
+// true if path is removed by a whiteout of removed (or, for an opaque directory, is under it)
+static bool whited_out(const char* path, const char* removed, bool opaque) {
+  size_t len = strlen(removed);
+  if (len == 0) return opaque;
+  return strncmp(path, removed, len) == 0 && (path[len] == '/' || (!opaque && path[len] == '\0'));
+}
+
+static void image_paths_remove(struct image_paths* set, const char* removed, bool opaque, int layer) {
+  int count = set->count;
+  for (int i = 0; i < set->count;)
+    if (set->layers[i] < layer && whited_out(set->paths[i], removed, opaque)) {
+      set->count--;
+      memcpy(set->paths[i], set->paths[set->count], sizeof(set->paths[0]));
+      set->layers[i] = set->layers[set->count];
+    } else
+      i++;
+  if (set->count != count) image_paths_index(set); // the positions moved, this scan was already as long
+}
+
+enum { IMAGE_ETC_OS_RELEASE, IMAGE_USR_OS_RELEASE, IMAGE_DPKG, IMAGE_APK, IMAGE_FILE_COUNT };
+
+struct image_scan {
+  struct {
+    const char* path;
+    int (*native_count)(const char*); // the counter of the package manager it is the database of
+    int layer;                        // -1 if it is not in the image
+    bool is_link;
+    int count;
+  } files[IMAGE_FILE_COUNT];
+  char os_release[2][4096]; // only the first bytes, the fields are at the top
+  size_t os_release_len[2];
+  struct image_paths pacman, modules; // local/<package>/desc files and module trees
+  int skipped_layers;
+};
+
+// counts the packages of a database while it streams by, with the same line parsers as the native counters
+static int image_count_lines(struct tar_stream* tar, void (*line_fn)(void*, const char*, size_t), void* ctx) {
+  char line[512]; // the lines the parsers look at are short, longer ones are cut
+  size_t line_len = 0, len;
+  while ((len = tar_read_data(tar, tar->data, sizeof(tar->data))) > 0)
+    for (const char *pos = tar->data, *end = tar->data + len; pos < end;) {
+      const char* nl = memchr(pos, '\n', end - pos);
+      size_t chunk   = (nl ? nl : end) - pos;
+      if (line_len + chunk > sizeof(line)) chunk = line_len < sizeof(line) ? sizeof(line) - line_len : 0;
+      memcpy(line + line_len, pos, chunk);
+      line_len += chunk;
+      if (!nl) break;
+      line_fn(ctx, line, line_len);
+      line_len = 0;
+      pos      = nl + 1;
+    }
+  if (line_len > 0) line_fn(ctx, line, line_len);
+  return 0;
+}
+
+static void image_scan_entry(struct image_scan* scan, struct tar_stream* tar, const struct tar_entry* entry, int layer) {
+  const char* name = strrchr(entry->path, '/');
+  name             = name ? name + 1 : entry->path;
+  if (strncmp(name, ".wh.", 4) == 0) { // whiteouts hide what the lower layers have there
+    char removed[sizeof(entry->path)];
+    bool opaque = strcmp(name, ".wh..wh..opq") == 0;
+    if (opaque)
+      snprintf(removed, sizeof(removed), "%.*s", name > entry->path ? (int)(name - entry->path - 1) : 0, entry->path);
+    else
+      snprintf(removed, sizeof(removed), "%.*s%s", (int)(name - entry->path), entry->path, name + 4);
+    for (int i = 0; i < IMAGE_FILE_COUNT; i++)
+      if (scan->files[i].layer < layer && whited_out(scan->files[i].path, removed, opaque)) scan->files[i].layer = -1;
+    image_paths_remove(&scan->pacman, removed, opaque, layer);
+    image_paths_remove(&scan->modules, removed, opaque, layer);
+    return;
+  }
+
+  const char* module_dirs[] = {"lib/modules/", "usr/lib/modules/"};
+  for (int i = 0; i < 2; i++) {
+    size_t len = strlen(module_dirs[i]);
+    if (strncmp(entry->path, module_dirs[i], len) != 0 || !entry->path[len]) continue;
+    char tree[192];
+    snprintf(tree, sizeof(tree), "%s%.*s", module_dirs[i], (int)strcspn(entry->path + len, "/"), entry->path + len);
+    image_paths_add(&scan->modules, tree, layer);
+  }
+
+  bool regular = entry->type == '0' || entry->type == '\0' || entry->type == '7';
+  const char pacman_dir[] = "var/lib/pacman/local/";
+  if (regular && strncmp(entry->path, pacman_dir, sizeof(pacman_dir) - 1) == 0 && strcmp(name, "desc") == 0 &&
+      strchr(entry->path + sizeof(pacman_dir) - 1, '/') == name - 1) {
+    image_paths_add(&scan->pacman, entry->path, layer);
+    return;
+  }
+
+  for (int i = 0; i < IMAGE_FILE_COUNT; i++) {
+    if (strcmp(entry->path, scan->files[i].path) != 0) continue;
+    if (!regular && entry->type != '2') return;
+    scan->files[i].layer   = layer;
+    scan->files[i].is_link = entry->type == '2';
+    scan->files[i].count   = 0;
+    if (scan->files[i].is_link) return;
+    if (i == IMAGE_ETC_OS_RELEASE || i == IMAGE_USR_OS_RELEASE) {
+      scan->os_release_len[i] = tar_read_data(tar, scan->os_release[i], sizeof(scan->os_release[i]));
+    } else if (i == IMAGE_DPKG) {
+      struct dpkg_scan dpkg = {0};
+      image_count_lines(tar, dpkg_line, &dpkg);
+      dpkg_line(&dpkg, "", 0);
+      scan->files[i].count = dpkg.count;
+    } else if (i == IMAGE_APK)
+      image_count_lines(tar, apk_line, &scan->files[i].count);
+    return;
+  }
+}
+
+// reads a small member of the image (a manifest) in memory, the result must be freed
+struct image_member {
+  char* path;
+  unsigned long long offset, size;
+};
+
+static char* read_image_member(int fd, const struct image_member* member) {
+  if (!member || member->size > 4 * 1024 * 1024) return NULL;
+  char* data = malloc(member->size + 1);
+  if (!data) return NULL;
+  if (pread(fd, data, member->size, member->offset) != (ssize_t)member->size) {
+    free(data);
+    return NULL;
+  }
+  data[member->size] = '\0';
+  return data;
+}
+
+static const struct image_member* find_image_member(const struct image_member* members, int count, const char* path) {
+  for (int i = 0; i < count; i++)
+    if (strcmp(members[i].path, path) == 0) return &members[i];
+  return NULL;
+}
+
+// a minimal json reader for the image manifests: every function takes the position of a value (after its whitespace)
+// and the end of the document, and returns a position in it or NULL if the document does not have what is asked
+static const char* json_space(const char* pos, const char* end) {
+  while (pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\t' || *pos == '\r')) pos++;
+  return pos;
+}
+
+// the end of the value at pos, the strings, objects and arrays in it are skipped whole
+static const char* json_value_end(const char* pos, const char* end) {
+  int depth = 0;
+  while (pos < end) {
+    char c = *pos++;
+    if (c == '"') {
+      while (pos < end && *pos != '"') pos += *pos == '\\' ? 2 : 1;
+      if (pos >= end) return NULL;
+      pos++;
+    } else if (c == '{' || c == '[')
+      depth++;
+    else if (c == '}' || c == ']') {
+      if (--depth < 0) return NULL;
+    } else if (depth == 0) { // a number, true, false or null
+      while (pos < end && !strchr(",}] \t\r\n", *pos)) pos++;
+      return pos;
+    }
+    if (depth == 0) return pos;
+  }
+  return NULL;
+}
+
+// the value of key in the object at pos, only its own members are looked at
+static const char* json_member(const char* pos, const char* end, const char* key) {
+  if (!pos || pos >= end || *pos != '{') return NULL;
+  size_t key_len = strlen(key);
+  for (pos = json_space(pos + 1, end); pos < end && *pos == '"';) {
+    const char* name  = pos + 1;
+    const char* value = json_value_end(pos, end);
+    if (!value) return NULL;
+    bool found = (size_t)(value - 1 - name) == key_len && memcmp(name, key, key_len) == 0;
+    value      = json_space(value, end);
+    if (value >= end || *value != ':') return NULL;
+    value = json_space(value + 1, end);
+    if (found) return value;
+    if (!(pos = json_value_end(value, end))) return NULL;
+    pos = json_space(pos, end);
+    if (pos >= end || *pos != ',') return NULL;
+    pos = json_space(pos + 1, end);
+  }
+  return NULL;
+}
+
+// the first element of the array at pos, and the one after the element at pos
+static const char* json_first(const char* pos, const char* end) {
+  if (!pos || pos >= end || *pos != '[') return NULL;
+  pos = json_space(pos + 1, end);
+  return pos < end && *pos != ']' ? pos : NULL;
+}
+
+static const char* json_next(const char* pos, const char* end) {
+  pos = json_value_end(pos, end);
+  pos = pos ? json_space(pos, end) : NULL;
+  return pos && pos < end && *pos == ',' ? json_space(pos + 1, end) : NULL;
+}
+
+// copies the string at pos to dst, false if it is not a string or does not fit
+static bool json_string(const char* pos, const char* end, char* dst, size_t size) {
+  if (!pos || pos >= end || *pos != '"') return false;
+  size_t len = 0;
+  for (pos++; pos < end && *pos != '"'; pos++) {
+    if (*pos == '\\' && ++pos >= end) return false;
+    if (len + 1 >= size) return false;
+    dst[len++] = *pos;
+  }
+  dst[len] = '\0';
+  return pos < end;
+}
 
-  #ifndef __APPLE__
-      pclose(fp);
-  #else
-      // remove("/tmp/uwufetch_brew_tmp");
-      fclose(fp);
-  #endif
+// "sha256:<hex>" is stored as blobs/sha256/<hex> in an OCI layout
+static void digest_path(char* dst, size_t size, const char* digest) {
+  const char* colon = strchr(digest, ':');
+  if (colon)
+    snprintf(dst, size, "blobs/%.*s/%s", (int)(colon - digest), digest, colon + 1);
+  else
+    snprintf(dst, size, "%s", digest);
+}
+
+// lists the layers of the first image, bottom first: from manifest.json (docker save) or index.json (OCI layout)
+static int list_image_layers(int fd, const struct image_member* members, int member_count, char (**layers)[256]) {
+  int count = 0, capacity = 0;
+  char* manifest = read_image_member(fd, find_image_member(members, member_count, "manifest.json"));
+  bool oci       = !manifest;
+  // an OCI index points to manifests (or other indexes) by digest
+  char* index = oci ? read_image_member(fd, find_image_member(members, member_count, "index.json")) : NULL;
+  for (int depth = 0; oci && index && depth < 4 && !manifest; depth++) {
+    const char* end       = index + strlen(index);
+    const char* manifests = json_member(json_space(index, end), end, "manifests");
+    char digest[256], path[300];
+    if (!json_string(json_member(json_first(manifests, end), end, "digest"), end, digest, sizeof(digest))) break;
+    digest_path(path, sizeof(path), digest);
+    char* blob           = read_image_member(fd, find_image_member(members, member_count, path));
+    const char* blob_end = blob ? blob + strlen(blob) : NULL;
+    if (blob && json_member(json_space(blob, blob_end), blob_end, "layers")) {
+      manifest = blob;
+    } else {
+      free(index);
+      index = blob;
+    }
+  }
+  free(index);
+  if (!manifest) return -1;
+
+  // an OCI manifest has {"layers": [{"digest": ...}]}, a docker one [{"Layers": ["<path>"]}]
+  const char* end  = manifest + strlen(manifest);
+  const char* top  = json_space(manifest, end);
+  const char* list = oci ? json_member(top, end, "layers") : json_member(json_first(top, end), end, "Layers");
+  char layer[256];
+  for (const char* element = json_first(list, end); element; element = json_next(element, end)) {
+    if (!json_string(oci ? json_member(element, end, "digest") : element, end, layer, sizeof(layer))) continue;
+    if (count == capacity) {
+      capacity           = capacity ? capacity * 2 : 16;
+      char(*grown)[256] = realloc(*layers, capacity * sizeof(**layers));
+      if (!grown) break;
+      *layers = grown;
     }
-  #ifdef __DEBUG__
+    if (oci)
+      digest_path((*layers)[count++], sizeof(**layers), layer);
     else
-      LOG_W("pkgman %s executable not found!", current->pkgman_name);
-  #endif
+      snprintf((*layers)[count++], sizeof(**layers), "%s", layer);
+  }
+  free(manifest);
+  return count;
+}
 
-    // adding a package manager with its package count to user_info->pkgman_name
-    user_info->pkgs += pkg_count;
-    if (pkg_count > 0) {
-      if (comma_separator++) strcat(user_info->pkgman_name, ", ");
-      char spkg_count[16];
-      sprintf(spkg_count, "%u", pkg_count);
-      strcat(user_info->pkgman_name, spkg_count);
-      strcat(user_info->pkgman_name, " ");
-      strcat(user_info->pkgman_name, current->pkgman_name);
-      LOG_V(user_info->pkgman_name);
+// inventories an image tarball, same record as a root directory
+static void scan_image(const char* path, FILE* out) {
+  const char* error = NULL;
+  int fd            = open(path, O_RDONLY | O_CLOEXEC);
+  struct tar_stream* tar       = malloc(sizeof(struct tar_stream));
+  struct image_scan* scan      = calloc(1, sizeof(struct image_scan));
+  struct image_member* members = NULL;
+  int member_count = 0, member_capacity = 0, layer_count = -1;
+  char(*layers)[256] = NULL;
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) error = strerror(errno);
+  if (!error && (!tar || !scan)) error = strerror(ENOMEM);
+  if (!error && (!tar_open(tar, fd, 0, st.st_size) || tar->gzip)) error = "compressed image archives are not supported";
+
+  // the layers are members of the archive, they are read in place
+  struct tar_entry entry;
+  while (!error && tar_next(tar, &entry)) {
+    if (entry.type != '0' && entry.type != '\0') continue;
+    if (member_count == member_capacity) {
+      member_capacity              = member_capacity ? member_capacity * 2 : 64;
+      struct image_member* grown   = realloc(members, member_capacity * sizeof(*members));
+      if (!grown) break;
+      members = grown;
     }
+    char* member_path = strdup(entry.path);
+    if (member_path) members[member_count++] = (struct image_member){member_path, tar->offset, entry.size};
   }
-#else  // _WIN32
-  // chocolatey for windows
-  FILE* fp = popen("choco list -l --no-color 2> nul", "r");
-  unsigned int pkg_count;
-  char buffer[7562] = {0};
-  while (fgets(buffer, BUFFER_SIZE, fp)) {
-    sscanf(buffer, "%u packages installed.", &pkg_count);
+  if (!error && (layer_count = list_image_layers(fd, members, member_count, &layers)) < 0)
+    error = "no manifest.json or index.json, not an image archive";
+
+  if (!error) {
+    const char* paths[IMAGE_FILE_COUNT] = {"etc/os-release", "usr/lib/os-release", "var/lib/dpkg/status", "lib/apk/db/installed"};
+    int (*counters[IMAGE_FILE_COUNT])(const char*) = {NULL, NULL, count_dpkg, count_apk};
+    for (int i = 0; i < IMAGE_FILE_COUNT; i++) {
+      scan->files[i].path         = paths[i];
+      scan->files[i].native_count = counters[i];
+      scan->files[i].layer        = -1;
+    }
+  }
+  for (int i = 0; !error && i < layer_count; i++) {
+    const struct image_member* layer = find_image_member(members, member_count, layers[i]);
+    if (!layer || !tar_open(tar, fd, layer->offset, layer->size)) {
+      LOG_W("skipping layer %s", layers[i]);
+      scan->skipped_layers++;
+      continue;
+    }
+    while (tar_next(tar, &entry)) image_scan_entry(scan, tar, &entry, i);
+    tar_close(tar);
   }
-  if (fp) pclose(fp);
 
-  user_info->pkgs = pkg_count;
-  char spkg_count[16];
-  sprintf(spkg_count, "%u", pkg_count);
-  strcat(user_info->pkgman_name, spkg_count);
-  strcat(user_info->pkgman_name, " ");
-  strcat(user_info->pkgman_name, "(chocolatey)");
-  LOG_V(user_info->pkgman_name);
-#endif // _WIN32
-  return 0;
+  if (error) {
+    fputs(",\"error\":", out);
+    write_json_string(out, error, strlen(error));
+  } else {
+    // /etc/os-release is usually a link to /usr/lib/os-release
+    int os_release = scan->files[IMAGE_ETC_OS_RELEASE].layer >= 0 && !scan->files[IMAGE_ETC_OS_RELEASE].is_link
+                       ? IMAGE_ETC_OS_RELEASE
+                       : IMAGE_USR_OS_RELEASE;
+    bool has_os_release = scan->files[os_release].layer >= 0 && !scan->files[os_release].is_link;
+    write_os_release(out, has_os_release ? scan->os_release[os_release] : NULL, scan->os_release_len[os_release]);
+
+    bool first = true;
+    for (size_t i = 0; i < sizeof(pkgmans) / sizeof(pkgmans[0]); i++) {
+      if (pkgmans[i].native_count == count_pacman && scan->pacman.count > 0)
+        write_pkg_count(out, &first, &pkgmans[i], scan->pacman.count);
+      for (int j = 0; j < IMAGE_FILE_COUNT; j++)
+        if (scan->files[j].native_count && scan->files[j].native_count == pkgmans[i].native_count &&
+            scan->files[j].layer >= 0 && !scan->files[j].is_link)
+          write_pkg_count(out, &first, &pkgmans[i], scan->files[j].count);
+    }
+    fputs(first ? ",\"pkgs\":{}" : "}", out);
+
+    struct module_tree_scan modules = {0};
+    for (int i = 0; i < scan->modules.count; i++)
+      collect_module_tree(&modules, -1, strrchr(scan->modules.paths[i], '/') + 1, DT_DIR);
+    write_module_trees(out, &modules);
+    if (scan->skipped_layers > 0) fprintf(out, ",\"skipped_layers\":%d", scan->skipped_layers);
+  }
+
+  for (int i = 0; i < member_count; i++) free(members[i].path);
+  free(members);
+  free(layers);
+  if (scan) {
+    free(scan->pacman.paths);
+    free(scan->pacman.layers);
+    free(scan->pacman.slots);
+    free(scan->modules.paths);
+    free(scan->modules.layers);
+    free(scan->modules.slots);
+  }
+  free(scan);
+  free(tar);
+  if (fd >= 0) close(fd);
+}
+
+char* scan_sysroot(const char* root, size_t* len) {
+  char* record = NULL;
+  FILE* out    = open_memstream(&record, len);
+  if (!out) return NULL;
+  fputs("{\"root\":", out);
+  write_json_string(out, root, strlen(root));
+
+  struct stat st;
+  if (stat(root, &st) == 0 && S_ISREG(st.st_mode)) { // docker save or OCI layout tarball
+    scan_image(root, out);
+    fputs("}\n", out);
+    fclose(out);
+    return record;
+  }
+  int fd = open(root, O_PATH | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    const char* error = strerror(errno);
+    fputs(",\"error\":", out);
+    write_json_string(out, error, strlen(error));
+    fputs("}\n", out);
+    fclose(out);
+    return record;
+  }
+  root_fd = fd;
+
+  // distro
+  const char* os_release_paths[] = {"/etc/os-release", "/usr/lib/os-release"};
+  char* data                     = NULL;
+  size_t data_len                = 0;
+  for (int i = 0; i < 2 && map_file(os_release_paths[i], &data, &data_len) < 0; i++)
+    ;
+  write_os_release(out, data, data_len);
+  unmap_file(data, data_len);
+
+  // packages, only from the databases: the package managers of the root can't run here
+  bool first = true;
+  for (size_t i = 0; i < sizeof(pkgmans) / sizeof(pkgmans[0]); i++) {
+    if (!pkgmans[i].native_count) continue;
+    int count = pkgmans[i].native_count(pkgmans[i].db_path);
+    if (count >= 0) write_pkg_count(out, &first, &pkgmans[i], count);
+  }
+  fputs(first ? ",\"pkgs\":{}" : "}", out);
+
+  // kernel module trees, one per installed kernel
+  struct module_tree_scan modules = {0};
+  walk_dir(AT_FDCWD, "/lib/modules", collect_module_tree, &modules);
+  walk_dir(AT_FDCWD, "/usr/lib/modules", collect_module_tree, &modules);
+  write_module_trees(out, &modules);
+  fputs("}\n", out);
+
+  root_fd = AT_FDCWD;
+  close(fd);
+  fclose(out);
+  return record;
 }
+#endif // __linux__
+
+#if !defined(_WIN32) && !defined(__BSD__) && !defined(__APPLE__)
+static const char* const dmi_model_files[] = {
+    "/sys/devices/virtual/dmi/id/product_version",
+    "/sys/devices/virtual/dmi/id/product_name",
+    "/sys/devices/virtual/dmi/id/board_name",
+};
+#endif
 
 void* get_model(void* argp) {
   if (!((struct thread_varg*)argp)->thread_flags[5]) return 0;
   LOG_I("getting model");
   struct info* user_info = ((struct thread_varg*)argp)->user_info;
-  char* buffer           = ((struct thread_varg*)argp)->buffer;
-  FILE* model_fp;
 #ifdef _WIN32
+  char* buffer = ((struct thread_varg*)argp)->buffer;
   // all the previous files obviously did not exist on windows
-  model_fp = popen("wmic computersystem get model", "r");
+  FILE* model_fp = popen("wmic computersystem get model", "r");
   while (fgets(buffer, BUFFER_SIZE, model_fp)) {
     if (strstr(buffer, "Model") != 0)
       continue;
     else {
-      sprintf(user_info->model, "%s", buffer);
-      user_info->model[strlen(user_info->model) - 2] = '\0';
+      if (strlen(buffer) >= 2) set_info(user_info, &user_info->model, buffer, strlen(buffer) - 2); // without "\r\n"
       break;
     }
   }
@@ -476,39 +3604,42 @@ void* get_model(void* argp) {
   #elif defined(__OPENBSD__)
     #define HOSTCTL "hw.product"
   #endif
-  model_fp = popen("sysctl " HOSTCTL, "r");
-  while (fgets(buffer, BUFFER_SIZE, model_fp))
-    if (sscanf(buffer,
-               HOSTCTL
+  const char* sysctl_argv[] = {"sysctl", HOSTCTL, NULL};
+  struct probe sysctl_probe = {.argv = sysctl_argv};
+  char model[BUFFER_SIZE]   = "";
+  run_probes(&sysctl_probe, 1);
+  probe_field(&sysctl_probe,
+              HOSTCTL
   #ifdef __OPENBSD__
-               "="
+              "=",
   #else
-               ": "
+              ":",
   #endif
-               "%[^\n]",
-               user_info->model))
-      break;
-  pclose(model_fp);
+              model, sizeof(model));
+  free_probes(&sysctl_probe, 1);
+  set_info(user_info, &user_info->model, model, strlen(model));
 #else
-  char model_filename[4][256] = {
-      "/sys/devices/virtual/dmi/id/product_version",
-      "/sys/devices/virtual/dmi/id/product_name",
-      "/sys/devices/virtual/dmi/id/board_name",
-      "getprop ro.product.vendor.marketname 2>/dev/null",
-  };
+  FILE* model_fp;
+  const char* const* model_filename = dmi_model_files;
+  // android has no dmi files, the market name comes from getprop. lscpu is the last resort
+  const char* getprop_argv[] = {"getprop", "ro.product.vendor.marketname", NULL};
+  const char* lscpu_argv[]   = {"lscpu", NULL};
+  struct probe probes[]      = {{.argv = getprop_argv}, {.argv = lscpu_argv}};
+  bool has_dmi               = input_exists(model_filename[1]);
+  if (!has_dmi) run_probes(probes, 2);
 
-  char tmp_model[4][BUFFER_SIZE] = {0}; // temporary variable to store the contents of all 3 files
+  char tmp_model[4][BUFFER_SIZE] = {0}; // temporary variable to store the contents of all 3 files and getprop
   int longest_model = 0, best_len = 0, currentlen = 0;
-  FILE* (*tocall[])(const char*, const char*) = {fopen, fopen, fopen, popen}; // open a process or a file, depending on the model_filename
-  int (*tocall_close[])(FILE*)                = {fclose, fclose, fclose, pclose};
   for (int i = 0; i < 4; i++) {
     // read file
-    model_fp = tocall[i](model_filename[i], "r");
-    if (model_fp) {
-      fgets(tmp_model[i], BUFFER_SIZE, model_fp);
-      tmp_model[i][strlen(tmp_model[i]) - 1] = '\0';
-      tocall_close[i](model_fp);
-    }
+    if (i < 3) {
+      model_fp = open_input(model_filename[i]);
+      if (model_fp) {
+        if (fgets(tmp_model[i], BUFFER_SIZE, model_fp)) tmp_model[i][strcspn(tmp_model[i], "\n")] = '\0';
+        fclose(model_fp);
+      }
+    } else if (probes[0].output)
+      snprintf(tmp_model[i], BUFFER_SIZE, "%.*s", (int)strcspn(probes[0].output, "\n"), probes[0].output);
     LOG_V(tmp_model[i]);
     // choose the file with the longest name
     currentlen = strlen(tmp_model[i]);
@@ -518,14 +3649,13 @@ void* get_model(void* argp) {
     }
   }
   if (strlen(tmp_model[longest_model]) == 0) {
-    model_fp = popen("lscpu 2>/dev/null", "r");
-    while (fgets(buffer, BUFFER_SIZE, model_fp))
-      if (sscanf(buffer, "Model name:%*[           |		]%[^\n]", tmp_model[longest_model]) == 1) break;
-    pclose(model_fp);
+    if (has_dmi) run_probes(&probes[1], 1);
+    probe_field(&probes[1], "Model name:", tmp_model[longest_model], BUFFER_SIZE);
     LOG_V(tmp_model[longest_model]);
     if (strcmp(tmp_model[longest_model], "Icestorm") == 0) sprintf(tmp_model[longest_model], "Apple MacBook Air (M1)");
   }
-  sprintf(user_info->model, "%s", tmp_model[longest_model]);
+  free_probes(probes, 2);
+  set_info(user_info, &user_info->model, tmp_model[longest_model], strlen(tmp_model[longest_model]));
   LOG_V(user_info->model);
 #endif
   return 0;
@@ -537,9 +3667,11 @@ void* get_ker(void* argp) {
   struct info* user_info = ((struct thread_varg*)argp)->user_info;
 
 #ifndef _WIN32
+  char kernel[BUFFER_SIZE];
   truncate_str(user_info->sys_var.release, user_info->target_width);
-  sprintf(user_info->kernel, "%s %s %s", user_info->sys_var.sysname, user_info->sys_var.release, user_info->sys_var.machine); // kernel name
-  truncate_str(user_info->kernel, user_info->target_width);
+  snprintf(kernel, sizeof(kernel), "%s %s %s", user_info->sys_var.sysname, user_info->sys_var.release, user_info->sys_var.machine); // kernel name
+  truncate_str(kernel, user_info->target_width);
+  set_info(user_info, &user_info->kernel, kernel, strlen(kernel));
   LOG_V(user_info->kernel);
 #else  // _WIN32
   // windows version
@@ -549,8 +3681,7 @@ void* get_ker(void* argp) {
     if (strstr(buffer, "SystemType") != 0)
       continue;
     else {
-      sprintf(user_info->kernel, "%s", buffer);
-      user_info->kernel[strlen(user_info->kernel) - 2] = '\0';
+      if (strlen(buffer) >= 2) set_info(user_info, &user_info->kernel, buffer, strlen(buffer) - 2); // without "\r\n"
       break;
     }
   }
@@ -595,82 +3726,913 @@ void* get_upt(void* argp) {
   return 0;
 }
 
+uint64_t hash_bytes(uint64_t hash, const void* data, size_t len) {
+  for (size_t i = 0; i < len; i++) hash = (hash ^ ((const unsigned char*)data)[i]) * 1099511628211ULL; // fnv-1a
+  return hash;
+}
+
+#ifndef _WIN32
+  #define CACHE_MAGIC "FFCACHE"
+
+// files and directories rewritten by the package managers on every transaction
+static const char* pkg_stamp_paths[] = {
+    PKGDB_PREFIX "/var/lib/dpkg/status", PKGDB_PREFIX "/lib/apk/db/installed", PKGDB_PREFIX "/var/db/pkg",
+    PKGDB_PREFIX "/var/lib/portage/world", PKGDB_PREFIX "/var/lib/flatpak/app", PKGDB_PREFIX "/var/lib/snapd/snaps",
+    "/run/current-system", "/nix/var/nix/profiles", PKGDB_PREFIX "/var/lib/pacman/local", "/var/lib/rpm",
+    PKGDB_PREFIX "/var/db/xbps", "/opt/local/var/macports/registry", "/home/linuxbrew/.linuxbrew/Cellar",
+    "/home/linuxbrew/.linuxbrew/Caskroom", "/opt/homebrew/Cellar", "/opt/homebrew/Caskroom", "/usr/local/Cellar",
+    "/usr/local/Caskroom"};
+// same, relative to the home directory
+static const char* pkg_home_stamp_paths[] = {".guix-profile", ".local/share/flatpak/app", ".nix-profile",
+                                             ".local/state/nix/profiles", ".linuxbrew/Cellar"};
+
+uint64_t hash_stat(uint64_t hash, const char* path) {
+  struct stat st;
+  uint64_t stamp[5] = {0};
+  if (path && stat(path, &st) == 0) {
+    stamp[0] = st.st_dev;
+    stamp[1] = st.st_ino;
+    stamp[2] = st.st_size;
+    stamp[3] = st.st_mtime;
+  #ifdef __linux__
+    stamp[4] = st.st_mtim.tv_nsec;
+  #endif
+  }
+  return hash_bytes(hash, stamp, sizeof(stamp));
+}
+
+void get_cache_keys(struct cache_keys* keys) {
+  keys->pkgs = 1469598103934665603ULL;
+  for (size_t i = 0; i < sizeof(pkg_stamp_paths) / sizeof(pkg_stamp_paths[0]); i++)
+    keys->pkgs = hash_stat(keys->pkgs, pkg_stamp_paths[i]);
+  char path[512];
+  keys->home_pkgs = 1469598103934665603ULL;
+  for (size_t i = 0; i < sizeof(pkg_home_stamp_paths) / sizeof(pkg_home_stamp_paths[0]); i++)
+    if (home_path(path, sizeof(path), pkg_home_stamp_paths[i])) keys->home_pkgs = hash_stat(keys->home_pkgs, path);
+
+  // a new boot id means the hardware may have changed too, the release catches kernel updates without a reboot id
+  keys->boot = 1469598103934665603ULL;
+  struct utsname uts;
+  if (uname(&uts) == 0) {
+    keys->boot = hash_bytes(keys->boot, uts.release, strlen(uts.release));
+    keys->boot = hash_bytes(keys->boot, uts.version, strlen(uts.version));
+  }
+  char boot_id[64];
+  int fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    ssize_t len = read(fd, boot_id, sizeof(boot_id));
+    if (len > 0) keys->boot = hash_bytes(keys->boot, boot_id, len);
+    close(fd);
+  }
+
+  keys->os = hash_stat(1469598103934665603ULL, "/etc/os-release");
+}
+#endif // _WIN32
+
+// how a cached field is stored in the blob
+enum cached_kind {
+  CACHED_BYTES,  // as it is in struct info
+  CACHED_STRING, // 32 bit length and the bytes
+  CACHED_LIST,   // 32 bit count and every string, in an array of struct info
+  CACHED_GPUS,   // 32 bit count and every string, in the gpu list
+};
+
+// the cached fields, each one is valid as long as its key did not change
+struct cached_field {
+  size_t offset, size; // size of the bytes, or of the array of a list
+  size_t flag;         // offset of the matching struct flags member
+  int key;             // index in struct cache_keys, -1 when only the daemon can tell whether the field is current
+  enum cached_kind kind;
+  size_t count; // offset of the int counting the strings of a list
+};
+#define CACHED_FIELD(field, flag, key) \
+  {offsetof(struct info, field), sizeof(((struct info*)0)->field), offsetof(struct flags, flag), key, CACHED_BYTES, 0}
+#define CACHED_STRING(field, flag, key) {offsetof(struct info, field), 0, offsetof(struct flags, flag), key, CACHED_STRING, 0}
+#define CACHED_LIST(field, count, flag, key)                                                                     \
+  {offsetof(struct info, field), sizeof(((struct info*)0)->field), offsetof(struct flags, flag), key, CACHED_LIST, \
+   offsetof(struct info, count)}
+static const struct cached_field cached_fields[] = {
+    CACHED_STRING(os_name, os, 2),
+    CACHED_STRING(model, model, 1),
+    CACHED_STRING(kernel, kernel, 1),
+    CACHED_STRING(cpu_model, cpu, 1),
+    {offsetof(struct info, gpu_model), 0, offsetof(struct flags, gpu), 1, CACHED_GPUS, offsetof(struct info, gpu_count)},
+    CACHED_FIELD(pkgs, pkgs, 0),
+    CACHED_STRING(pkgman_name, pkgs, 0),
+    CACHED_LIST(pkgman_list, pkgman_count, pkgs, 0),
+    CACHED_FIELD(pkgman_pkgs, pkgs, 0),
+    CACHED_LIST(screen_names, screen_count, resolution, -1),
+    CACHED_FIELD(screen_widths, resolution, -1),
+    CACHED_FIELD(screen_heights, resolution, -1),
+    CACHED_FIELD(screen_width, resolution, -1),
+    CACHED_FIELD(screen_height, resolution, -1)};
+#undef CACHED_FIELD
+#undef CACHED_STRING
+#undef CACHED_LIST
+
+struct cache_header {
+  char magic[8];
+  uint32_t version, payload_size;
+  uint64_t checksum; // of everything after it
+  struct cache_keys keys;
+  struct flags cached; // fields that were collected when the cache was written
+};
+
+static const char* const* cached_strings(const struct cached_field* field, const struct info* user_info, uint32_t* count) {
+  const char* at = (const char*)user_info + field->offset;
+  *count         = field->kind == CACHED_STRING ? 1 : *(const int*)((const char*)user_info + field->count);
+  return field->kind == CACHED_GPUS ? user_info->gpu_model : (const char* const*)at;
+}
+
+// writes the field at out unless it is NULL, returns its size in the blob
+static size_t pack_field(const struct cached_field* field, const struct info* user_info, char* out) {
+  if (field->kind == CACHED_BYTES) {
+    if (out) memcpy(out, (const char*)user_info + field->offset, field->size);
+    return field->size;
+  }
+  uint32_t count;
+  const char* const* strings = cached_strings(field, user_info, &count);
+  size_t size                = 0;
+  if (field->kind != CACHED_STRING) {
+    if (out) memcpy(out, &count, sizeof(count));
+    size += sizeof(count);
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t len = info_len(strings[i]);
+    if (out) {
+      memcpy(out + size, &len, sizeof(len));
+      memcpy(out + size + sizeof(len), strings[i], len);
+    }
+    size += sizeof(len) + len;
+  }
+  return size;
+}
+
+static char* pack_blob(const struct info* user_info, struct flags collected, bool host, size_t* len) {
+#ifdef _WIN32
+  (void)user_info, (void)collected, (void)host, (void)len;
+  return NULL; // no validity keys on windows yet
+#else
+  size_t payload_size = 0;
+  for (size_t i = 0; i < sizeof(cached_fields) / sizeof(cached_fields[0]); i++)
+    payload_size += pack_field(&cached_fields[i], user_info, NULL);
+  if (sizeof(struct cache_header) + payload_size > CACHE_MAX_SIZE) return NULL;
+  char* blob = malloc(sizeof(struct cache_header) + payload_size);
+  if (!blob) return NULL;
+  struct cache_header header = {CACHE_MAGIC, CACHE_VERSION, payload_size, 0, {0}, collected};
+  get_cache_keys(&header.keys);
+  if (host) { // the count of root has its HOME stores, the users count their packages themselves
+    header.keys.home_pkgs = 0;
+    header.cached.pkgs    = false;
+  }
+  char* payload = blob + sizeof(header);
+  for (size_t i = 0; i < sizeof(cached_fields) / sizeof(cached_fields[0]); i++)
+    payload += pack_field(&cached_fields[i], user_info, payload);
+  memcpy(blob, &header, sizeof(header));
+  *len            = sizeof(header) + payload_size;
+  header.checksum = hash_bytes(1469598103934665603ULL, blob + offsetof(struct cache_header, keys),
+                               *len - offsetof(struct cache_header, keys));
+  memcpy(blob, &header, sizeof(header));
+  return blob;
+#endif
+}
+
+char* pack_info(const struct info* user_info, struct flags collected, size_t* len) {
+  return pack_blob(user_info, collected, false, len);
+}
+
+char* pack_host_info(const struct info* user_info, struct flags collected, size_t* len) {
+  return pack_blob(user_info, collected, true, len);
+}
+
+void merge_info(struct info* dst, const struct info* src, struct flags fields) {
+  for (size_t i = 0; i < sizeof(cached_fields) / sizeof(cached_fields[0]); i++) {
+    const struct cached_field* field = &cached_fields[i];
+    if (!*(bool*)((char*)&fields + field->flag)) continue;
+    if (field->kind == CACHED_BYTES) {
+      memcpy((char*)dst + field->offset, (const char*)src + field->offset, field->size);
+      continue;
+    }
+    uint32_t count;
+    const char* const* strings = cached_strings(field, src, &count);
+    if (field->kind == CACHED_GPUS) dst->gpu_count = 0;
+    for (uint32_t j = 0; j < count; j++) {
+      if (field->kind == CACHED_GPUS)
+        add_gpu(dst, strings[j], info_len(strings[j]));
+      else
+        set_info(dst, (const char**)((char*)dst + field->offset) + j, strings[j], info_len(strings[j]));
+    }
+    if (field->kind == CACHED_LIST) *(int*)((char*)dst + field->count) = count;
+  }
+}
+
+#ifndef _WIN32
+static bool take_bytes(const char** pos, const char* end, void* out, size_t size) {
+  if ((size_t)(end - *pos) < size) return false;
+  if (out) memcpy(out, *pos, size);
+  *pos += size;
+  return true;
+}
+
+// reads the field at *pos into user_info, or only checks it when user_info is NULL
+static bool unpack_field(const struct cached_field* field, const char** pos, const char* end, struct info* user_info) {
+  char* at = user_info ? (char*)user_info + field->offset : NULL;
+  if (field->kind == CACHED_BYTES) return take_bytes(pos, end, at, field->size);
+  uint32_t count = 1;
+  if (field->kind != CACHED_STRING && !take_bytes(pos, end, &count, sizeof(count))) return false;
+  if (field->kind == CACHED_LIST && count > field->size / sizeof(const char*)) return false;
+  if (user_info && field->kind == CACHED_GPUS) user_info->gpu_count = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t len;
+    if (!take_bytes(pos, end, &len, sizeof(len)) || (size_t)(end - *pos) < len) return false;
+    if (user_info && field->kind == CACHED_GPUS)
+      add_gpu(user_info, *pos, len);
+    else if (user_info)
+      set_info(user_info, (const char**)at + i, *pos, len);
+    *pos += len;
+  }
+  if (user_info && field->kind == CACHED_LIST) *(int*)((char*)user_info + field->count) = count;
+  return true;
+}
+
+// check_keys is false for the daemon snapshot, whose fields are kept current by the daemon itself
+static bool unpack_blob(const char* blob, size_t len, struct info* user_info, struct flags* stale, struct flags* cached,
+                        bool check_keys) {
+  struct cache_header header;
+  if (len < sizeof(header)) return false;
+  memcpy(&header, blob, sizeof(header));
+  if (memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != CACHE_VERSION ||
+      len != sizeof(header) + header.payload_size ||
+      header.checksum != hash_bytes(1469598103934665603ULL, blob + offsetof(struct cache_header, keys),
+                                    len - offsetof(struct cache_header, keys))) {
+    LOG_W("cache is invalid or from another version");
+    return false;
+  }
+  // the whole payload is checked before anything is restored
+  const char *pos = blob + sizeof(header), *end = blob + len;
+  for (size_t i = 0; i < sizeof(cached_fields) / sizeof(cached_fields[0]); i++)
+    if (!unpack_field(&cached_fields[i], &pos, end, NULL)) return false;
+  if (pos != end) return false;
+
+  struct cache_keys current = header.keys;
+  if (check_keys) get_cache_keys(&current);
+  if (!header.keys.home_pkgs) current.home_pkgs = 0; // the host cache
+  const bool key_changed[] = {header.keys.pkgs != current.pkgs || header.keys.home_pkgs != current.home_pkgs,
+                              header.keys.boot != current.boot, header.keys.os != current.os};
+  // user, shell, ram and uptime are cheap and change without notice: always collected
+  *stale = (struct flags){.user = true, .shell = true, .ram = true, .uptime = true};
+  if (cached) *cached = header.cached;
+  pos = blob + sizeof(header);
+  for (size_t i = 0; i < sizeof(cached_fields) / sizeof(cached_fields[0]); i++) {
+    const struct cached_field* field = &cached_fields[i];
+    bool was_cached                  = *(bool*)((char*)&header.cached + field->flag);
+    if (!was_cached || (check_keys && (field->key < 0 || key_changed[field->key])))
+      *(bool*)((char*)stale + field->flag) = true;
+    // outdated fields are restored too, the caller decides whether to show them until they are collected again
+    unpack_field(field, &pos, end, was_cached ? user_info : NULL);
+  }
+  LOG_V(stale->pkgs);
+  LOG_V(stale->kernel);
+  LOG_V(stale->os);
+  return true;
+}
+#endif
+
+bool unpack_info(const char* blob, size_t len, struct info* user_info, struct flags* stale, struct flags* cached) {
+#ifdef _WIN32
+  (void)blob, (void)len, (void)user_info, (void)stale, (void)cached;
+  return false;
+#else
+  return unpack_blob(blob, len, user_info, stale, cached, true);
+#endif
+}
+
+#ifdef __linux__
+  #define SNAPSHOT_MAGIC 0x46465348U // "FFSH"
+  #define SNAPSHOT_DEBOUNCE_MS 250   // a transaction touches the databases many times, refreshing once is enough
+
+// shared memory segment published by the daemon, readers copy blob while sequence is even and unchanged
+struct snapshot {
+  uint32_t magic, version;
+  _Atomic uint32_t sequence; // odd while the daemon writes
+  pid_t pid;                 // daemon publishing the snapshot
+  uint32_t len;
+  char blob[CACHE_MAX_SIZE]; // pack_info() output
+};
+
+static void snapshot_name(char* name, size_t size, uid_t uid) { snprintf(name, size, "/freakyfetch-%u", (unsigned)uid); }
+
+static struct snapshot* snapshot_map = NULL;
+static bool snapshot_of_root         = false; // root's daemon serving another user, its count has root's HOME stores
+static pthread_once_t snapshot_once  = PTHREAD_ONCE_INIT;
+
+// maps the snapshot of this user's daemon, or the one of root's daemon
+static void map_snapshot(void) {
+  uid_t uids[] = {getuid(), 0};
+  for (size_t i = 0; i < sizeof(uids) / sizeof(uids[0]) && !snapshot_map; i++) {
+    char name[32];
+    snapshot_name(name, sizeof(name), uids[i]);
+    int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) continue;
+    struct stat st;
+    // /dev/shm is writable by everyone: a segment someone else created, or could write to, is not a daemon's
+    bool trusted = fstat(fd, &st) == 0 && st.st_uid == uids[i] && !(st.st_mode & (S_IWGRP | S_IWOTH)) &&
+                   st.st_size >= (off_t)sizeof(struct snapshot);
+    void* map = trusted ? mmap(NULL, sizeof(struct snapshot), PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) continue;
+    struct snapshot* snapshot = map;
+    // a daemon that died without cleaning up leaves a segment nobody updates anymore
+    if (snapshot->magic != SNAPSHOT_MAGIC || snapshot->version != CACHE_VERSION || (kill(snapshot->pid, 0) != 0 && errno == ESRCH)) {
+      munmap(map, sizeof(struct snapshot));
+      continue;
+    }
+    LOG_I("using the daemon snapshot %s", name);
+    snapshot_map     = snapshot;
+    snapshot_of_root = uids[i] != getuid();
+  }
+}
+
+bool read_snapshot(struct info* user_info, struct flags* stale) {
+  pthread_once(&snapshot_once, map_snapshot);
+  if (!snapshot_map) return false;
+  char* blob = malloc(sizeof(snapshot_map->blob));
+  if (!blob) return false;
+  bool read = false;
+  for (int tries = 0; tries < 10000 && !read; tries++) {
+    uint32_t sequence = atomic_load_explicit(&snapshot_map->sequence, memory_order_acquire);
+    if (sequence & 1) continue; // the daemon is writing
+    uint32_t len = snapshot_map->len;
+    if (len > sizeof(snapshot_map->blob)) break;
+    memcpy(blob, snapshot_map->blob, len);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&snapshot_map->sequence, memory_order_relaxed) == sequence)
+      read = unpack_blob(blob, len, user_info, stale, NULL, false);
+  }
+  free(blob);
+  if (read && snapshot_of_root) stale->pkgs = true; // the packages of this user are counted by this run
+  return read;
+}
+
+static void publish_snapshot(struct snapshot* snapshot, const struct info* user_info, struct flags collected) {
+  size_t len = 0;
+  char* blob = pack_info(user_info, collected, &len);
+  if (!blob) return;
+  if (len <= sizeof(snapshot->blob)) {
+    uint32_t sequence = atomic_load_explicit(&snapshot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&snapshot->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(snapshot->blob, blob, len);
+    snapshot->len = len;
+    atomic_store_explicit(&snapshot->sequence, sequence + 2, memory_order_release);
+    LOG_I("published snapshot %u", sequence + 2);
+  }
+  free(blob);
+}
+
+// an inotify watch and the fields to collect again when it fires
+struct daemon_watch {
+  int wd;
+  const char* name; // only events on this entry count, NULL for any entry
+  struct flags refresh;
+};
+
+static void add_daemon_watch(int inotify_fd, struct daemon_watch* watches, int* count, int max, const char* path,
+                             struct flags refresh) {
+  const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB;
+  if (*count >= max) return;
+  struct stat st;
+  struct daemon_watch* watch = &watches[*count];
+  watch->refresh             = refresh;
+  watch->name                = NULL;
+  if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode))
+    watch->wd = inotify_add_watch(inotify_fd, path, mask);
+  else { // files and symlinks are replaced by rename, so their directory is watched
+    char parent[PATH_MAX];
+    const char* slash = strrchr(path, '/');
+    if (!slash || slash == path) return;
+    snprintf(parent, sizeof(parent), "%.*s", (int)(slash - path), path);
+    watch->name = slash + 1;
+    watch->wd   = inotify_add_watch(inotify_fd, parent, mask);
+  }
+  if (watch->wd >= 0) (*count)++;
+}
+
+static void merge_flags(struct flags* dst, struct flags src) {
+  for (size_t i = 0; i < sizeof(struct flags) / sizeof(bool); i++) ((bool*)dst)[i] |= ((bool*)&src)[i];
+}
+
+static volatile sig_atomic_t daemon_stopping = 0;
+static void stop_daemon(int signal) {
+  (void)signal;
+  daemon_stopping = 1;
+}
+
+int run_daemon(struct flags flags) {
+  // only the fields that are the same for every user and every terminal are published
+  flags.user = flags.shell = flags.ram = flags.uptime = false;
+  char name[32];
+  snapshot_name(name, sizeof(name), getuid());
+  // never reuses a segment: one left by another user would keep its owner and mode
+  shm_unlink(name);
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0 || ftruncate(fd, sizeof(struct snapshot)) != 0) {
+    LOG_E("could not create the %s shared memory segment", name);
+    if (fd >= 0) close(fd);
+    return 1;
+  }
+  struct snapshot* snapshot = mmap(NULL, sizeof(struct snapshot), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (snapshot == MAP_FAILED) return 1;
+  struct sigaction action = {.sa_handler = stop_daemon};
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  struct info* user_info = malloc(sizeof(struct info));
+  if (!user_info) return 1;
+  init_info(user_info);
+  get_info(flags, user_info);
+  snapshot->version = CACHE_VERSION;
+  snapshot->pid     = getpid();
+  publish_snapshot(snapshot, user_info, flags);
+  snapshot->magic = SNAPSHOT_MAGIC;
+
+  struct daemon_watch watches[64];
+  int watch_count = 0, max_watches = sizeof(watches) / sizeof(watches[0]);
+  int inotify_fd  = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd >= 0) {
+    add_daemon_watch(inotify_fd, watches, &watch_count, max_watches, "/etc/os-release", (struct flags){.os = true});
+    add_daemon_watch(inotify_fd, watches, &watch_count, max_watches, "/usr/lib/os-release", (struct flags){.os = true});
+    add_daemon_watch(inotify_fd, watches, &watch_count, max_watches, "/sys/class/drm", (struct flags){.resolution = true});
+    for (size_t i = 0; i < sizeof(pkg_stamp_paths) / sizeof(pkg_stamp_paths[0]); i++)
+      add_daemon_watch(inotify_fd, watches, &watch_count, max_watches, pkg_stamp_paths[i], (struct flags){.pkgs = true});
+    char path[512];
+    for (size_t i = 0; i < sizeof(pkg_home_stamp_paths) / sizeof(pkg_home_stamp_paths[0]); i++)
+      if (home_path(path, sizeof(path), pkg_home_stamp_paths[i]))
+        add_daemon_watch(inotify_fd, watches, &watch_count, max_watches, path, (struct flags){.pkgs = true});
+    LOG_I("watching %d paths", watch_count);
+  }
+  // sysfs does not report changes through inotify, the kernel uevents tell about monitors and gpus coming and going
+  int uevent_fd                 = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+  struct sockaddr_nl uevent_addr = {.nl_family = AF_NETLINK, .nl_groups = 1};
+  if (uevent_fd >= 0 && bind(uevent_fd, (struct sockaddr*)&uevent_addr, sizeof(uevent_addr)) != 0) {
+    close(uevent_fd);
+    uevent_fd = -1;
+  }
+
+  struct flags pending = {0};
+  long long refresh_at = 0; // when the pending changes are collected (monotonic ms), 0 if there are none
+  char events[8192] __attribute__((aligned(__alignof__(struct inotify_event))));
+  while (!daemon_stopping) {
+    // the deadline is set by the first change, the ones after it do not push it back
+    long long left = refresh_at ? refresh_at - monotonic_ms() : -1;
+    if (refresh_at && left <= 0) {
+      struct flags refresh = pending;
+      for (size_t i = 0; i < sizeof(struct flags) / sizeof(bool); i++) ((bool*)&refresh)[i] &= ((bool*)&flags)[i];
+      LOG_I("refreshing after changes");
+      get_info(refresh, user_info);
+      publish_snapshot(snapshot, user_info, flags);
+      pending    = (struct flags){0};
+      refresh_at = 0;
+      continue;
+    }
+    struct pollfd fds[] = {{.fd = inotify_fd, .events = POLLIN}, {.fd = uevent_fd, .events = POLLIN}};
+    int ready           = poll(fds, 2, (int)left);
+    if (ready < 0 && errno != EINTR) break;
+    if (ready <= 0) continue;
+    ssize_t len;
+    if (fds[0].revents & POLLIN)
+      while ((len = read(inotify_fd, events, sizeof(events))) > 0)
+        for (char* pos = events; pos < events + len;) {
+          struct inotify_event* event = (struct inotify_event*)pos;
+          for (int i = 0; i < watch_count; i++)
+            if (watches[i].wd == event->wd && (!watches[i].name || (event->len && strcmp(watches[i].name, event->name) == 0))) {
+              merge_flags(&pending, watches[i].refresh);
+              if (!refresh_at) refresh_at = monotonic_ms() + SNAPSHOT_DEBOUNCE_MS;
+            }
+          pos += sizeof(struct inotify_event) + event->len;
+        }
+    if (fds[1].revents & POLLIN)
+      while ((len = recv(uevent_fd, events, sizeof(events) - 1, 0)) > 0) {
+        events[len] = '\0';
+        // "action@devpath" followed by NUL separated KEY=value pairs
+        for (char* pos = events; pos < events + len; pos += strlen(pos) + 1) {
+          struct flags refresh = {0};
+          if (strcmp(pos, "SUBSYSTEM=drm") == 0)
+            refresh.resolution = true;
+          else if (strcmp(pos, "SUBSYSTEM=pci") == 0)
+            refresh.gpu = true;
+          else
+            continue;
+          merge_flags(&pending, refresh);
+          if (!refresh_at) refresh_at = monotonic_ms() + SNAPSHOT_DEBOUNCE_MS;
+        }
+      }
+  }
+  LOG_I("stopping the daemon");
+  snapshot->magic = 0;
+  shm_unlink(name);
+  if (inotify_fd >= 0) close(inotify_fd);
+  if (uevent_fd >= 0) close(uevent_fd);
+  free_info(user_info);
+  free(user_info);
+  return 0;
+}
+#endif // __linux__
+
+#ifdef __linux__
+// the files and existence checks of the collectors, read ahead in one batch by get_info()
+static void os_inputs(struct input_batch* batch) {
+  batch_file(batch, "/etc/os-release", 0);
+  batch_exists(batch, "/usr/share/plymouth/themes/amogos");
+  batch_exists(batch, "/system/app/");
+  batch_exists(batch, "/system/priv-app/");
+  batch_exists(batch, "/Library/");
+}
+
+// about 2.5kB per cpu, a longer file is read again by get_cpu()
+static void cpu_inputs(struct input_batch* batch) {
+  long cpus = sysconf(_SC_NPROCESSORS_CONF);
+  batch_file(batch, "/proc/cpuinfo", (cpus > 0 ? cpus : 1) * 4096);
+}
+
+static void ram_inputs(struct input_batch* batch) { batch_file(batch, "/proc/meminfo", 0); }
+
+static void model_inputs(struct input_batch* batch) {
+  batch_exists(batch, dmi_model_files[1]);
+  for (size_t i = 0; i < sizeof(dmi_model_files) / sizeof(dmi_model_files[0]); i++) batch_file(batch, dmi_model_files[i], 0);
+}
+
+static void pkg_inputs(struct input_batch* batch) {
+  for (size_t i = 0; i < sizeof(pkgmans) / sizeof(pkgmans[0]); i++) batch_exists(batch, pkgmans[i].command_path);
+}
+  #define INPUTS(inputs) inputs
+#else
+  #define INPUTS(inputs) NULL
+#endif
+
+// what the collectors read besides their own files and commands, get_info() reads each of them once before they run
+enum {
+  SOURCE_OS_RELEASE = 1 << 0, // /etc/os-release, or the android and apple markers when it is missing
+  SOURCE_CPUINFO    = 1 << 1, // /proc/cpuinfo (sysctl hw.model on bsd)
+  SOURCE_UNAME      = 1 << 2,
+  SOURCE_SYSINFO    = 1 << 3,
+  SOURCE_ENV        = 1 << 4,
+};
+
+// how a collector is run: in memory on the calling thread, or on its own thread when it reads files or runs commands
+enum collector_cost { COST_MEMORY, COST_FILES, COST_COMMANDS };
+
+#define FIELD(name) (offsetof(struct flags, name) / sizeof(bool))
+
+struct input_batch;
+
+// a field of struct info: the collector that fills it, the fields it reads, and the sources it needs
+struct collector {
+  const char* name;
+  void* (*collect)(void*); // NULL for the fields filled by get_info() while it reads the sources
+  size_t field;            // its flag, as an index in struct flags
+  struct flags needs;
+  unsigned sources;
+  enum collector_cost cost;
+  void (*inputs)(struct input_batch*); // adds what it reads to the batch read ahead, NULL if it can't tell
+};
+
+static const struct collector collectors[] = {
+    {"get_os", NULL, FIELD(os), {0}, SOURCE_OS_RELEASE, COST_FILES, INPUTS(os_inputs)},
+    {"get_user", NULL, FIELD(user), {0}, SOURCE_ENV, COST_MEMORY, NULL},
+    {"get_shell", NULL, FIELD(shell), {0}, SOURCE_ENV, COST_MEMORY, NULL},
+#ifdef __APPLE__
+    {"get_cpu", get_cpu, FIELD(cpu), {0}, SOURCE_CPUINFO | SOURCE_OS_RELEASE, COST_FILES, NULL}, // the name is read with the os
+#else
+    {"get_cpu", get_cpu, FIELD(cpu), {0}, SOURCE_CPUINFO, COST_FILES, INPUTS(cpu_inputs)},
+#endif
+    {"get_ram", get_ram, FIELD(ram), {0}, 0, COST_FILES, INPUTS(ram_inputs)},
+    {"get_gpu", get_gpu, FIELD(gpu), {.os = true}, 0, COST_COMMANDS, NULL}, // android has no pci sysfs, getprop names it
+    {"get_res", get_res, FIELD(resolution), {0}, 0, COST_FILES, NULL},
+    {"get_pkg", get_pkg, FIELD(pkgs), {0}, 0, COST_COMMANDS, INPUTS(pkg_inputs)},
+    {"get_model", get_model, FIELD(model), {0}, 0, COST_COMMANDS, INPUTS(model_inputs)},
+    {"get_ker", get_ker, FIELD(kernel), {0}, SOURCE_UNAME, COST_MEMORY, NULL},
+    {"get_upt", get_upt, FIELD(uptime), {0}, SOURCE_SYSINFO, COST_MEMORY, NULL},
+};
+#define COLLECTOR_COUNT (sizeof(collectors) / sizeof(collectors[0]))
+#undef FIELD
+#undef INPUTS
+
+// adds to fields everything the collectors of fields read, returns the sources they need
+static unsigned resolve_collectors(struct flags* fields) {
+  bool* needed     = (bool*)fields;
+  unsigned sources = 0;
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t i = 0; i < COLLECTOR_COUNT; i++) {
+      if (!needed[collectors[i].field]) continue;
+      const bool* needs = (const bool*)&collectors[i].needs;
+      for (size_t j = 0; j < sizeof(struct flags) / sizeof(bool); j++)
+        if (needs[j] && !needed[j]) needed[j] = changed = true;
+    }
+  }
+  for (size_t i = 0; i < COLLECTOR_COUNT; i++)
+    if (needed[collectors[i].field]) sources |= collectors[i].sources;
+  return sources;
+}
+
+// a collector run, timed, with its own line buffer and its own arena for the strings it sets
+struct collector_run {
+  const struct collector* collector;
+  struct thread_varg args;
+  char buffer[BUFFER_SIZE];
+  struct arena arena;
+  const struct input_batch* inputs; // read ahead for the run
+  long long duration_us;
+  bool done;                 // set by the thread that ran it
+  struct collector_run* next; // in the queue of the workers
+};
+
+static void* run_collector(void* arg) {
+  struct collector_run* run = arg;
+  int span                  = begin_span("collector", run->collector->name);
+  collector_arena           = &run->arena;
+#ifndef _WIN32
+  const struct input_batch* previous = prefetched;
+  long long start_us                 = monotonic_us();
+  prefetched                         = run->inputs;
+  run->collector->collect(&run->args);
+  run->duration_us = monotonic_us() - start_us;
+  prefetched       = previous;
+#else
+  run->collector->collect(&run->args);
+#endif
+  collector_arena = NULL;
+  end_span(span);
+  return NULL;
+}
+
+#ifndef _WIN32
+  #define INLINE_COLLECTOR_US 500 // a collector expected to take less runs on the calling thread, a thread costs as much
+  #define COLLECTOR_WORKERS 4     // threads kept for the slow collectors, the calling thread takes from their queue too
+  #define COLLECTOR_WORKER_IDLE_S 5 // a worker left without a collector for this long exits
+
+// the duration of every collector averaged over the runs, kept across runs in a file (load_collector_history)
+static struct {
+  char path[4096]; // "" if the durations are only kept in memory
+  bool loaded, changed;
+  long long duration_us[COLLECTOR_COUNT], saved_us[COLLECTOR_COUNT]; // 0 if never measured
+} history;
+
+// the workers that run the slow collectors, started when first needed and kept for the next get_info() until they are
+// idle for COLLECTOR_WORKER_IDLE_S or stop_collector_workers() is called
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t queued, finished; // finished is also signaled when a worker exits
+  struct collector_run *head, *tail;
+  int workers, idle;
+  bool stopping;
+} pool = {.lock = PTHREAD_MUTEX_INITIALIZER, .queued = PTHREAD_COND_INITIALIZER, .finished = PTHREAD_COND_INITIALIZER};
+
+void load_collector_history(const char* path) {
+  pthread_mutex_lock(&pool.lock);
+  snprintf(history.path, sizeof(history.path), "%s", path);
+  history.loaded = false;
+  pthread_mutex_unlock(&pool.lock);
+}
+
+// with the pool lock held
+static void read_collector_history(void) {
+  if (history.loaded || !history.path[0]) return;
+  history.loaded = true;
+  FILE* file     = fopen(history.path, "r");
+  if (!file) return;
+  char name[32];
+  long long duration_us;
+  while (fscanf(file, "%31s %lld", name, &duration_us) == 2)
+    for (size_t i = 0; i < COLLECTOR_COUNT; i++)
+      if (strcmp(name, collectors[i].name) == 0 && duration_us > 0)
+        history.duration_us[i] = history.saved_us[i] = duration_us;
+  fclose(file);
+}
+
+// folds a measured duration in, with the pool lock held. A duration 4 times longer or shorter replaces the average:
+// the host changed (lshw was installed, a package manager was removed)
+static void record_duration(size_t collector, long long duration_us) {
+  long long* average = &history.duration_us[collector];
+  long long saved    = history.saved_us[collector];
+  if (duration_us < 1) duration_us = 1;
+  if (*average == 0 || duration_us > *average * 4 || duration_us * 4 < *average)
+    *average = duration_us;
+  else
+    *average = (*average * 3 + duration_us) / 4;
+  if (saved == 0 || *average > saved + saved / 8 || *average < saved - saved / 8) history.changed = true;
+}
+
+bool save_collector_history(void) {
+  pthread_mutex_lock(&pool.lock);
+  bool written = true;
+  if (history.changed && history.path[0]) {
+    char tmp_path[4200];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", history.path, (int)getpid());
+    FILE* out = fopen(tmp_path, "w");
+    written   = out != NULL;
+    for (size_t i = 0; out && i < COLLECTOR_COUNT; i++)
+      if (history.duration_us[i] > 0) fprintf(out, "%s %lld\n", collectors[i].name, history.duration_us[i]);
+    if (out) written = !ferror(out) && fclose(out) == 0 && rename(tmp_path, history.path) == 0;
+    if (!written) unlink(tmp_path);
+    if (written) {
+      memcpy(history.saved_us, history.duration_us, sizeof(history.saved_us));
+      history.changed = false;
+    }
+  }
+  pthread_mutex_unlock(&pool.lock);
+  return written;
+}
+
+// what a collector is expected to take: its average, or a guess from its cost class until it is measured
+static long long expected_us(size_t collector) {
+  static const long long guess_us[] = {[COST_MEMORY] = 0, [COST_FILES] = 1000, [COST_COMMANDS] = 100000};
+  return history.duration_us[collector] ? history.duration_us[collector] : guess_us[collectors[collector].cost];
+}
+
+static int compare_expected(const void* a, const void* b) {
+  long long x = expected_us((*(struct collector_run* const*)a)->collector - collectors),
+            y = expected_us((*(struct collector_run* const*)b)->collector - collectors);
+  return (x < y) - (x > y); // the slowest first
+}
+
+// with the pool lock held
+static struct collector_run* take_run(void) {
+  struct collector_run* run = pool.head;
+  if (run && !(pool.head = run->next)) pool.tail = NULL;
+  return run;
+}
+
+// runs what is queued, with the pool lock held (released while a collector runs)
+static void drain_runs(void) {
+  struct collector_run* run;
+  while ((run = take_run())) {
+    pthread_mutex_unlock(&pool.lock);
+    run_collector(run);
+    pthread_mutex_lock(&pool.lock);
+    run->done = true;
+    pthread_cond_broadcast(&pool.finished);
+  }
+}
+
+static void* collector_worker(void* arg) {
+  (void)arg;
+  pthread_mutex_lock(&pool.lock);
+  for (;;) {
+    drain_runs();
+    if (pool.stopping) break;
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += COLLECTOR_WORKER_IDLE_S;
+    pool.idle++;
+    int waited = pthread_cond_timedwait(&pool.queued, &pool.lock, &deadline);
+    pool.idle--;
+    if (waited == ETIMEDOUT && !pool.head) break;
+  }
+  LOG_I("STOPPING worker %d", pool.workers - 1);
+  pool.workers--;
+  pthread_cond_broadcast(&pool.finished);
+  pthread_mutex_unlock(&pool.lock);
+  return NULL;
+}
+
+void stop_collector_workers(void) {
+  pthread_mutex_lock(&pool.lock);
+  pool.stopping = true;
+  pthread_cond_broadcast(&pool.queued);
+  while (pool.workers > 0) pthread_cond_wait(&pool.finished, &pool.lock);
+  pool.stopping = false;
+  pthread_mutex_unlock(&pool.lock);
+}
+
+// a forked child has none of the workers
+static void lock_pool(void) { pthread_mutex_lock(&pool.lock); }
+static void unlock_pool(void) { pthread_mutex_unlock(&pool.lock); }
+static void reset_pool(void) {
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.queued, NULL);
+  pthread_cond_init(&pool.finished, NULL);
+  pool.head = pool.tail = NULL;
+  pool.workers = pool.idle = 0;
+  pool.stopping = false;
+}
+static void watch_forks(void) { pthread_atfork(lock_pool, unlock_pool, reset_pool); }
+
+// starts workers until count of them are idle or there are COLLECTOR_WORKERS, with the pool lock held
+static void start_workers(int count) {
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, watch_forks);
+  pthread_attr_t attr;
+  sigset_t all, previous;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  sigfillset(&all);
+  // the signals sent to the process are for the thread that waits, not for the workers. The ones a fault raises stay
+  // deliverable, a worker that crashes must not hang
+  sigdelset(&all, SIGSEGV);
+  sigdelset(&all, SIGBUS);
+  sigdelset(&all, SIGFPE);
+  sigdelset(&all, SIGILL);
+  sigdelset(&all, SIGABRT);
+  pthread_sigmask(SIG_SETMASK, &all, &previous);
+  for (int started = 0; started < count - pool.idle && pool.workers < COLLECTOR_WORKERS; started++) {
+    pthread_t tid;
+    if (pthread_create(&tid, &attr, collector_worker, NULL) != 0) break;
+    LOG_I("STARTING worker %d", pool.workers);
+    pool.workers++;
+  }
+  pthread_sigmask(SIG_SETMASK, &previous, NULL);
+  pthread_attr_destroy(&attr);
+}
+#endif
+
+static bool os_id_field(void* user_info, int id, const char* value, size_t len) {
+  (void)id;
+  len = unquote(&value, len);
+  set_info(user_info, &((struct info*)user_info)->os_name, value, len);
+  return false;
+}
+
 // Retrieves system information
 void get_info(struct flags flags, struct info* user_info) {
-  char buffer[BUFFER_SIZE]; // line buffer
+  int info_span    = begin_span("collector", "get_info");
+  unsigned sources = resolve_collectors(&flags); // flags now has the fields read by the requested ones too
   get_twidth(user_info);
+#ifndef _WIN32
+  set_probe_deadline(PROBE_RUN_TIMEOUT_MS); // a hung command can't hold the whole fetch
+#endif
+  struct input_batch* batch = NULL;
+#ifdef HAVE_PREFETCH
+  // the files of every collector that runs are opened and read at once, a recorded run reads its archive instead
+  if (input_mode != INPUTS_REPLAY && root_fd == AT_FDCWD && (batch = calloc(1, sizeof(*batch)))) {
+    for (size_t i = 0; i < COLLECTOR_COUNT; i++)
+      if (collectors[i].inputs && ((bool*)&flags)[collectors[i].field]) collectors[i].inputs(batch);
+    int prefetch_span = begin_span("collector", "prefetch");
+    prefetch_inputs(batch);
+    end_span(prefetch_span);
+    prefetched = batch;
+  }
+#endif
   // os version, cpu and board info
 #ifdef __OPENBSD__
-  FILE* os_release = popen("echo ID=openbsd", "r"); // os-release does not exist in OpenBSD
+  char openbsd_release[] = "ID=openbsd\n";
+  FILE* os_release       = fmemopen(openbsd_release, sizeof(openbsd_release) - 1, "r"); // os-release does not exist in OpenBSD
 #else
-  FILE* os_release  = fopen("/etc/os-release", "r"); // os name file
+  FILE* os_release  = sources & SOURCE_OS_RELEASE ? open_input("/etc/os-release") : NULL; // os name file
 #endif
-#ifndef __BSD__
-  FILE* cpuinfo = fopen("/proc/cpuinfo", "r"); // cpu name file for not-freebsd systems
-#else
-  FILE* cpuinfo     = popen("sysctl hw.model", "r"); // cpu name command for freebsd
+  FILE* cpuinfo = NULL;
+  if (sources & SOURCE_CPUINFO) {
+#ifdef __BSD__
+    const char* sysctl_argv[] = {"sysctl", "hw.model", NULL};
+    cpuinfo                   = probe_stream(sysctl_argv); // cpu name command for freebsd
+#elif !defined(__linux__) // get_cpu() reads it whole on linux
+    cpuinfo = open_input("/proc/cpuinfo"); // cpu name file for not-freebsd systems
 #endif
+  }
   // trying to get some kind of information about the name of the computer (hopefully a product full name)
   if (os_release) { // get normal vars if os_release exists
     if (flags.os) {
       LOG_I("getting os name from /etc/os-release");
-      while (fgets(buffer, BUFFER_SIZE, os_release) &&
-             !(sscanf(buffer, "\nID=\"%s\"", user_info->os_name) ||
-               sscanf(buffer, "\nID=%s", user_info->os_name)))
-        ;
-      // sometimes for some reason sscanf reads the last '\"' too
-      int os_name_len = strlen(user_info->os_name);
-      if (user_info->os_name[os_name_len - 1] == '\"') {
-        user_info->os_name[os_name_len - 1] = '\0';
-      }
+      static const struct field_key os_release_keys[] = {{"ID", 0}};
+      static struct field_table os_release_table       = FIELD_TABLE(os_release_keys);
+      size_t len;
+      char* data = read_stream(os_release, &len);
+      if (data) scan_fields(data, len, '=', &os_release_table, os_id_field, user_info);
+      free(data);
       // trying to detect amogos because in its os-release file ID value is just "debian", will be removed when amogos will have an os-release file with ID=amogos
       if (strcmp(user_info->os_name, "debian") == 0 ||
           strcmp(user_info->os_name, "raspbian") == 0) {
-        DIR* amogos_plymouth = opendir("/usr/share/plymouth/themes/amogos");
-        if (amogos_plymouth) {
-          closedir(amogos_plymouth);
-          sprintf(user_info->os_name, "amogos");
+        if (input_exists("/usr/share/plymouth/themes/amogos")) {
+          set_infof(user_info, &user_info->os_name, "amogos");
           LOG_V(user_info->os_name);
         }
       }
       LOG_V(user_info->os_name);
     }
-  } else { // try for android vars, next for Apple var, or unknown system
+  } else if (sources & SOURCE_OS_RELEASE) { // try for android vars, next for Apple var, or unknown system
            // android
-    DIR* system_app      = opendir("/system/app/");
-    DIR* system_priv_app = opendir("/system/priv-app/");
-    DIR* library         = opendir("/Library/");
-    if (system_app && system_priv_app) {
-      closedir(system_app);
-      closedir(system_priv_app);
-      if (flags.os) sprintf(user_info->os_name, "android");
+    if (input_exists("/system/app/") && input_exists("/system/priv-app/")) {
+      if (flags.os) set_infof(user_info, &user_info->os_name, "android");
       LOG_V(user_info->os_name);
-      if (flags.user) {
-        // username
-        FILE* whoami = popen("whoami", "r");
-        if (fscanf(whoami, "%s", user_info->user) == 3) {
-        }
-        LOG_V(user_info->user);
-        pclose(whoami);
-      }
-    } else if (library) { // Apple
-      closedir(library);
+    } else if (input_exists("/Library/")) { // Apple
 #ifdef __APPLE__
       if (flags.cpu) {
         sysctlbyname("machdep.cpu.brand_string", &cpu_buffer, &cpu_buffer_len, NULL,
                      0); // cpu name
-        sprintf(user_info->cpu_model, "%s", cpu_buffer);
+        set_infof(user_info, &user_info->cpu_model, "%s", cpu_buffer);
       }
       if (flags.os) {
   #ifndef __IPHONE__
-        sprintf(user_info->os_name, "macos");
+        set_infof(user_info, &user_info->os_name, "macos");
   #else
-        sprintf(user_info->os_name, "ios");
+        set_infof(user_info, &user_info->os_name, "ios");
   #endif
       }
 #endif
-    } else // if no option before is working, the system is unknown
-      sprintf(user_info->os_name, "unknown");
+    } else if (flags.os) // if no option before is working, the system is unknown
+      set_infof(user_info, &user_info->os_name, "unknown");
   }
 #ifndef __BSD__
 #endif
@@ -678,32 +4640,43 @@ void get_info(struct flags flags, struct info* user_info) {
   // getting username and hostname
   if (flags.user) {
     LOG_I("getting username and hostname");
-    gethostname(user_info->host, 256);
+    char host[256] = ""; // the size recorded by --capture
+    if (!replay_value("hostname", host, sizeof(host))) {
+      gethostname(host, sizeof(host));
+      capture_value("hostname", host, sizeof(host));
+    }
+    set_info(user_info, &user_info->host, host, strnlen(host, sizeof(host)));
     LOG_V(user_info->host);
-    char* tmp_user = getenv("USER");
+    const char* tmp_user = input_env("USER");
     LOG_V(tmp_user);
-    if (tmp_user == NULL)
-      sprintf(user_info->user, "%s", "");
-    else
-      sprintf(user_info->user, "%s", tmp_user);
+    set_info(user_info, &user_info->user, tmp_user ? tmp_user : "", tmp_user ? strlen(tmp_user) : 0);
+    // termux has no USER, whether the os is collected or not
+    if (!tmp_user && input_exists("/system/app/") && input_exists("/system/priv-app/")) {
+      const char* whoami_argv[] = {"whoami", NULL};
+      struct probe whoami       = {.argv = whoami_argv};
+      char user[128];
+      run_probes(&whoami, 1);
+      if (whoami.output && sscanf(whoami.output, "%127s", user) == 1) set_info(user_info, &user_info->user, user, strlen(user));
+      free_probes(&whoami, 1);
+    }
     LOG_V(user_info->user);
-    if (os_release) fclose(os_release);
   }
   if (flags.shell) {
     LOG_I("getting shell");
-    char* tmp_shell = getenv("SHELL"); // shell name
+    const char* tmp_shell = input_env("SHELL"); // shell name
+    size_t shell_len      = tmp_shell ? strnlen(tmp_shell, 63) : 0;
     LOG_V(tmp_shell);
-    if (!tmp_shell)
-      sprintf(user_info->shell, "%s", "");
-    else
-      snprintf(user_info->shell, sizeof user_info->shell, "%s", tmp_shell);
   #ifdef __linux__
-    if (strlen(user_info->shell) > 16) // android shell name was too long
-      memmove(&user_info->shell, &user_info->shell[27], strlen(user_info->shell));
+    if (shell_len > 16) { // android shell name was too long
+      tmp_shell += shell_len > 27 ? 27 : shell_len;
+      shell_len -= shell_len > 27 ? 27 : shell_len;
+    }
   #endif
+    set_info(user_info, &user_info->shell, tmp_shell, shell_len);
     LOG_V(user_info->shell);
   }
 #else  // if _WIN32
+  char buffer[BUFFER_SIZE]; // line buffer
   // cpu name
   if (flags.cpu) {
     cpuinfo = popen("wmic cpu get caption", "r");
@@ -711,8 +4684,7 @@ void get_info(struct flags flags, struct info* user_info) {
       if (strstr(buffer, "Caption") != 0)
         continue;
       else {
-        sprintf(user_info->cpu_model, "%s", buffer);
-        user_info->cpu_model[strlen(user_info->cpu_model) - 2] = '\0';
+        if (strlen(buffer) >= 2) set_info(user_info, &user_info->cpu_model, buffer, strlen(buffer) - 2); // without "\r\n"
         break;
       }
     }
@@ -724,8 +4696,10 @@ void get_info(struct flags flags, struct info* user_info) {
       if (strstr(buffer, "UserName") != 0)
         continue;
       else {
-        sscanf(buffer, "%[^\\]%s", user_info->host, user_info->user);
-        memmove(user_info->user, user_info->user + 1, sizeof(user_info->user) - 1);
+        char host[256] = "", user[128] = ""; // "HOST\user"
+        sscanf(buffer, "%255[^\\]%127s", host, user);
+        set_info(user_info, &user_info->host, host, strlen(host));
+        if (user[0]) set_info(user_info, &user_info->user, user + 1, strlen(user + 1));
         break;
       }
     }
@@ -733,43 +4707,79 @@ void get_info(struct flags flags, struct info* user_info) {
   // powershell version
   if (flags.shell) {
     FILE* shell_fp = popen("powershell $PSVersionTable", "r");
-    sprintf(user_info->shell, "PowerShell ");
-    char tmp_shell[64];
+    char tmp_shell[64] = "";
     while (fgets(buffer, BUFFER_SIZE, shell_fp) &&
-           sscanf(buffer, "PSVersion                      %s", tmp_shell) == 0)
+           sscanf(buffer, "PSVersion                      %63s", tmp_shell) == 0)
       ;
-    strcat(user_info->shell, tmp_shell);
+    set_infof(user_info, &user_info->shell, "PowerShell %s", tmp_shell);
   }
 #endif // _WIN32
 
 #ifdef _WIN32
-  if (flags.os) sprintf(user_info->os_name, "windows");
+  if (flags.os) set_infof(user_info, &user_info->os_name, "windows");
 #endif
-  get_sys(user_info);
-  // are threads overpowered? nah
-  void* (*fnptrs[])(void*) = {get_cpu, get_ram, get_gpu, get_res, get_pkg, get_model, get_ker, get_upt};
+  int sys_span = begin_span("collector", "get_sys");
+  if (sources & SOURCE_UNAME) get_uname(user_info);
+  if (sources & SOURCE_SYSINFO) get_sysinfo(user_info);
+  end_span(sys_span);
+  // are threads overpowered? only for the collectors that wait on files or commands, the slowest start first
   struct thread_varg args =
-      (struct thread_varg){buffer,
+      (struct thread_varg){NULL,
                            user_info,
                            cpuinfo,
                            {flags.cpu, flags.ram, flags.gpu, flags.resolution, flags.pkgs, flags.model, flags.kernel, flags.uptime}};
-#define THREAD_COUNT 8
-#ifndef _WIN32
-  pthread_t tids[THREAD_COUNT] = {0};
-#endif
-  for (int i = 0; i < THREAD_COUNT; i++) {
-    LOG_I("STARTING thread %d", i);
+  struct collector_run runs[COLLECTOR_COUNT];
+  int run_count = 0;
+  for (size_t i = 0; i < COLLECTOR_COUNT; i++) {
+    if (!collectors[i].collect || !((bool*)&flags)[collectors[i].field]) continue;
+    runs[run_count]             = (struct collector_run){.collector = &collectors[i], .args = args, .inputs = batch};
+    runs[run_count].args.buffer = runs[run_count].buffer;
+    run_count++;
+  }
 #ifdef _WIN32
-    fnptrs[i](&args);
+  for (int i = 0; i < run_count; i++) run_collector(&runs[i]);
 #else
-    pthread_create(&tids[i], NULL, fnptrs[i], &args);
-#endif
+  struct collector_run* slow[COLLECTOR_COUNT];
+  bool queued[COLLECTOR_COUNT] = {0};
+  int slow_count               = 0;
+  pthread_mutex_lock(&pool.lock);
+  read_collector_history();
+  for (int i = 0; i < run_count; i++)
+    if ((queued[i] = expected_us(runs[i].collector - collectors) >= INLINE_COLLECTOR_US)) slow[slow_count++] = &runs[i];
+  qsort(slow, slow_count, sizeof(*slow), compare_expected);
+  for (int i = 0; i < slow_count; i++) {
+    if (pool.tail)
+      pool.tail->next = slow[i];
+    else
+      pool.head = slow[i];
+    pool.tail = slow[i];
   }
-#ifndef _WIN32
-  for (int i = 0; i < THREAD_COUNT; i++) {
-    if (tids[i] != 0) pthread_join(tids[i], NULL);
-    LOG_I("JOINING thread %d", i);
+  if (slow_count > 1) { // this thread takes the last one
+    start_workers(slow_count - 1);
+    pthread_cond_broadcast(&pool.queued);
+  }
+  pthread_mutex_unlock(&pool.lock);
+  for (int i = 0; i < run_count; i++)
+    if (!queued[i]) run_collector(&runs[i]);
+  pthread_mutex_lock(&pool.lock);
+  drain_runs();
+  for (int i = 0; i < slow_count; i++)
+    while (!slow[i]->done) pthread_cond_wait(&pool.finished, &pool.lock);
+  if (input_mode != INPUTS_REPLAY) // replayed inputs take no time
+    for (int i = 0; i < run_count; i++) record_duration(runs[i].collector - collectors, runs[i].duration_us);
+  pthread_mutex_unlock(&pool.lock);
+#endif
+  // what the collectors set joins the rest, then everything is packed in one block
+  for (int i = 0; i < run_count; i++) merge_arena(&user_info->arena, &runs[i].arena);
+  compact_info(user_info);
+  if (os_release) fclose(os_release);
+  if (cpuinfo) fclose(cpuinfo);
+#ifdef HAVE_PREFETCH
+  prefetched = NULL;
+  if (batch && !batch->abandoned) {
+    if (batch->buffers) give_back_buffers(batch->buffers, batch->buffers_size);
+    free(batch);
   }
 #endif
-  fclose(cpuinfo);
+  end_span(info_span);
 }
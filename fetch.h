@@ -16,6 +16,8 @@
 #ifndef _FETCH_H_
 #define _FETCH_H_
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __DEBUG__
 bool* get_verbose_handle();
@@ -27,16 +29,17 @@ bool* get_verbose_handle();
   #define LOG_I(format, ...) LOG(0, format, ##__VA_ARGS__)
   #define LOG_W(format, ...) LOG(1, format, ##__VA_ARGS__)
   #define LOG_E(format, ...) LOG(2, format, ##__VA_ARGS__)
-  #define LOG_V(var)                       \
-    if (VERBOSE_ENABLED) {                 \
-      char format[1024] = "";              \
-      sprintf(format, "%s = %s", #var,     \
-              _Generic((var), int          \
-                       : "%d", float       \
-                       : "%f", char*       \
-                       : "\"%s\"", default \
-                       : "%p"));           \
-      LOG(3, format, var)                  \
+  #define LOG_V(var)                           \
+    if (VERBOSE_ENABLED) {                     \
+      char format[1024] = "";                  \
+      sprintf(format, "%s = %s", #var,         \
+              _Generic((var), int              \
+                       : "%d", float           \
+                       : "%f", char*           \
+                       : "\"%s\"", const char* \
+                       : "\"%s\"", default     \
+                       : "%p"));               \
+      LOG(3, format, var)                      \
     }
   #define LOG(type, format, ...)                      \
     if (VERBOSE_ENABLED) {                            \
@@ -55,6 +58,7 @@ bool* get_verbose_handle();
     }
 #else
   #define LOG_I(format, ...)
+  #define LOG_W(format, ...)
   #define LOG_E(format, ...)
   #define LOG_V(var)
   #define LOG(type, format, ...)
@@ -98,20 +102,40 @@ bool* get_verbose_handle();
   #endif // _WIN32
 #endif
 
-// info that will be printed with the logo
+// memory released all at once: allocations are taken in turn from the newest block, a new one is added when it is full
+struct arena_block;
+struct arena {
+  struct arena_block* head; // newest block, it links the older ones
+};
+
+// NULL if malloc fails
+void* arena_alloc(struct arena* arena, size_t size);
+void arena_free(struct arena* arena);
+
+// info that will be printed with the logo. The strings are never NULL and never written in place: each one is NUL
+// terminated with its length stored in front of it (info_len), and lives in arena unless it is empty. set_info() and
+// add_gpu() replace them, a struct info starts with init_info() and ends with free_info()
 struct info {
-  char user[128],  // username
-      host[256],   // hostname (computer name)
-      shell[64],   // shell name
-      model[256],  // model name
-      kernel[256], // kernel name (linux 5.x-whatever)
-      os_name[64], // os name (arch linux, windows, mac os)
-      cpu_model[256], gpu_model[256][256],
-      pkgman_name[64], // package managers string
-      image_name[128];
-  int target_width, // for the truncate_str function
-      screen_width, screen_height, ram_total, ram_used,
-      pkgs; // full package count
+  struct arena arena;
+  const char *user, // username
+      *host,        // hostname (computer name)
+      *shell,       // shell name
+      *model,       // model name
+      *kernel,      // kernel name (linux 5.x-whatever)
+      *os_name,     // os name (arch linux, windows, mac os)
+      *cpu_model,
+      *pkgman_name, // package managers string
+      *image_name;
+  const char** gpu_model;       // name of every gpu, gpu_count of them
+  const char* pkgman_list[24];  // name of every package manager that has packages, like "(pacman)"
+  const char* screen_names[16]; // connector of every connected output (eDP-1, HDMI-A-1, fb0)
+  int target_width,             // for the truncate_str function
+      screen_width, screen_height, // first output
+      screen_count, screen_widths[16], screen_heights[16], ram_total, ram_used,
+      pkgs,              // full package count
+      pkgman_count,      // entries in pkgman_list
+      pkgman_pkgs[24],   // package count of every entry of pkgman_list
+      gpu_count, gpu_capacity;
   long uptime;
 
 #ifndef _WIN32
@@ -133,9 +157,23 @@ struct info {
 #endif // _WIN32
 };
 
+void init_info(struct info* user_info);
+void free_info(struct info* user_info);
+// length of a string of struct info
+size_t info_len(const char* str);
+// points *field at a copy of the len bytes at value. In a collector the copy is taken from the arena of the
+// collector, merged in the one of user_info when get_info() returns
+void set_info(struct info* user_info, const char** field, const char* value, size_t len);
+void set_infof(struct info* user_info, const char** field, const char* format, ...);
+void add_gpu(struct info* user_info, const char* name, size_t len);
+// moves the strings and the gpu list into one block of their exact size and frees everything else in the arena
+void compact_info(struct info* user_info);
+
+#define BUFFER_SIZE 256 // the line buffer get_info() gives to the collectors
+
 // Args struct for get_something thread oriented functions
 struct thread_varg {
-  char* buffer;
+  char* buffer; // BUFFER_SIZE bytes
   struct info* user_info;
   FILE* cpuinfo;
   bool thread_flags[8];
@@ -146,7 +184,137 @@ struct flags {
   bool user, shell, model, kernel, os, cpu, gpu, resolution, ram, pkgs, uptime;
 };
 
+#ifndef _WIN32
+// external command run by run_probes()
+struct probe {
+  const char** argv;   // command and its arguments, NULL terminated
+  int timeout_ms;      // deadline of this command, 2 seconds if 0
+  bool inherit_stdout; // the command prints on our stdout instead of being captured
+  char* output;        // captured stdout, NUL terminated (released by free_probes)
+  size_t output_len, output_cap;
+  int status;          // exit status, -1 if the command could not run or was killed
+  int duration_ms;     // time until the output ended
+  bool timed_out;
+  pid_t pid;
+  int fd;
+  long long deadline;
+};
+
+// runs the commands at the same time without a shell, returns how many exited successfully
+int run_probes(struct probe* probes, int count);
+void free_probes(struct probe* probes, int count);
+// sets a deadline for all the commands started from now on, 0 removes it
+void set_probe_deadline(int timeout_ms);
+
+// times the collectors, the commands and the spans begun by the caller from now on (--timings)
+void enable_timings(void);
+// starts a span (the category groups them: collector, command, cache, render), -1 while timings are not enabled
+int begin_span(const char* category, const char* name);
+void end_span(int span);
+// a table of the spans with their page faults, context switches and forks, and the cpu time of the commands
+void print_timings(FILE* out);
+// the spans as a chrome trace-event json file
+bool write_timings_trace(const char* path);
+
+// keeps the durations of the collectors in path across runs: get_info() runs the ones that took less than half a
+// millisecond on the calling thread and starts the slowest first on a few reused workers. The durations adapt to every
+// run, save_collector_history() writes them back when they changed
+void load_collector_history(const char* path);
+bool save_collector_history(void);
+// stops the workers get_info() started and waits for them to exit, the next get_info() starts them again when needed.
+// Idle workers also exit on their own after a few seconds
+void stop_collector_workers(void);
+
+// records every input of the collectors (files, directory listings, links, commands and their timing, uname, sysinfo,
+// window size, environment) from now on, save_captured_inputs() writes them in an indexed archive at path
+bool capture_inputs(const char* path);
+bool save_captured_inputs(void);
+// serves the inputs recorded in path instead of reading the system, false if it is not a capture
+bool replay_inputs(const char* path);
+#else  // _WIN32
+  #define begin_span(category, name) (-1)
+  #define end_span(span) ((void)(span))
+#endif // _WIN32
+
+#define CACHE_VERSION 5 // bumped whenever struct info or the cached fields change
+#define CACHE_MAX_SIZE (64 << 10) // pack_info() output, more is hundreds of gpus and is not cached
+
+// what the cached fields depend on, a field is collected again when its key changes
+struct cache_keys {
+  uint64_t pkgs, // package database stamps: pkgs
+      home_pkgs, // stamps of the package databases in HOME: pkgs, 0 in the host cache
+      boot,      // boot id and kernel release: kernel, model, cpu and gpus
+      os;        // /etc/os-release inode and mtime: os name
+};
+
+void get_cache_keys(struct cache_keys*);
+// fnv-1a of data folded into hash, a new hash starts from 1469598103934665603ULL
+uint64_t hash_bytes(uint64_t hash, const void* data, size_t len);
+#ifndef _WIN32
+// folds the identity, size and modification time of path into hash, a missing path (or NULL) hashes differently from
+// every existing one
+uint64_t hash_stat(uint64_t hash, const char* path);
+#endif
+// serializes the cached fields with the current keys, the result must be freed
+char* pack_info(const struct info* user_info, struct flags collected, size_t* len);
+// same for the host cache, read by every user: its keys do not depend on the HOME of the one who wrote it and it has
+// no package count, which would have the stores in that HOME
+char* pack_host_info(const struct info* user_info, struct flags collected, size_t* len);
+// restores the cached fields, stale gets the ones to collect again and cached (if not NULL) the ones that were in the
+// blob; false if the blob is unusable
+bool unpack_info(const char* blob, size_t len, struct info* user_info, struct flags* stale, struct flags* cached);
+
+#ifdef __linux__
+// reads the snapshot published by a running daemon (run_daemon), only the first call makes syscalls; stale gets the
+// fields that are not in it, and the package count when the snapshot of root serves another user. Returns false if no
+// daemon is running
+bool read_snapshot(struct info* user_info, struct flags* stale);
+// collects the host-wide fields in flags, publishes them in shared memory and keeps them current until SIGTERM
+int run_daemon(struct flags flags);
+// inventories the root filesystem of a container or chroot (a directory or /proc/<pid>/root) without running
+// anything from it: one NDJSON record with the distro, the package count of every manager and the kernel module
+// trees. The file probes of the calling thread are resolved inside root until it returns. The record must be freed
+char* scan_sysroot(const char* root, size_t* len);
+#endif
+
+// a key looked up by scan_fields(), id is what the field callback gets
+struct field_key {
+  const char* key;
+  int id;
+};
+#define FIELD_SLOTS 64 // twice the most keys a table can have
+// the keys of scan_fields() hashed in an open addressing table, built by the first scan that uses it. Declared static
+// with FIELD_TABLE(keys), where keys is an array of 32 struct field_key at most
+struct field_table {
+  const struct field_key* keys;
+  int key_count;
+  _Atomic int state; // 0 until built, 1 while a scan builds it, 2 once built
+  signed char slots[FIELD_SLOTS];
+  size_t key_lens[FIELD_SLOTS / 2];
+};
+#define FIELD_TABLE(field_keys) {.keys = field_keys, .key_count = sizeof(field_keys) / sizeof(field_keys[0])}
+// calls field_fn(ctx, id, value, len) on every line of data whose key, before the first separator, is one of the keys
+// of table. The key and the value are trimmed of blanks, the value is not NUL terminated. The lines have no length
+// limit, the scan stops when field_fn returns false
+void scan_fields(const char* data, size_t len, char separator, struct field_table* table,
+                 bool (*field_fn)(void* ctx, int id, const char* value, size_t len), void* ctx);
+#ifdef __linux__
+// sets cpu_model from the /proc/cpuinfo text in data: the model name, or the core count on the boards that have none.
+// Empty if neither is there
+void parse_cpuinfo(struct info* user_info, const char* data, size_t len);
+#endif
+// strips the quotes around value, returns its new length
+size_t unquote(const char** value, size_t len);
+// reads what is left of stream in memory, NUL terminated; the result must be freed
+char* read_stream(FILE* stream, size_t* len);
+
+// copies the cached fields selected by fields from src to dst
+void merge_info(struct info* dst, const struct info* src, struct flags fields);
+// rebuilds pkgs and pkgman_name from pkgman_list and pkgman_pkgs
+void format_pkgman_name(struct info* user_info);
+
 void get_sys(struct info*);
+void* get_cpu(void*);
 void* get_ram(void*);
 void* get_gpu(void*);
 #ifdef _WIN32
@@ -15,8 +15,21 @@
 #define _GNU_SOURCE // for strcasestr
 
 #include "fetch.h"
+#include <ctype.h>
 #include <getopt.h>
 #include <stdbool.h>
+#include <stddef.h>
+#ifndef _WIN32
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <sys/file.h>
+  #include <sys/stat.h>
+  #include <sys/wait.h>
+  #include <time.h>
+  #ifdef __linux__
+    #include <stdatomic.h>
+  #endif
+#endif
 
 // COLORS
 #define NORMAL "\x1b[0m"
@@ -32,6 +45,9 @@
 #define WHITE "\x1b[37m"
 #define PINK "\x1b[38;5;201m"
 #define LPINK "\x1b[38;5;213m"
+#define BACKGROUND_GREEN "\x1b[0;42m"
+#define BACKGROUND_RED "\x1b[0;41m"
+#define BACKGROUND_WHITE "\x1b[0;47m"
 
 #ifdef _WIN32
   #define BLOCK_CHAR "\xdb"     // block char for colors
@@ -49,9 +65,10 @@ static bool* verbose_enabled = NULL;
 struct configuration {
   struct flags show; // all true by default
   bool show_image,   // false by default
-      show_colors;   // true by default
-  bool show_gpu[256];
-  bool show_gpus; // global gpu toggle
+      show_colors,   // true by default
+      use_cache;     // true by default
+  uint8_t hidden_gpus[32]; // a bit for every gpu index hidden with gpu=N
+  bool show_gpus;          // global gpu toggle
 };
 
 // user's config stored on the disk
@@ -59,15 +76,115 @@ struct user_config {
   char *config_directory, // configuration directory name
       *cache_content;     // cache file content
   int read_enabled, write_enabled;
+  uint64_t config_hash; // of the config file content, part of the motd frame key
+};
+
+enum {
+  CONFIG_DISTRO,
+  CONFIG_IMAGE,
+  CONFIG_USER,
+  CONFIG_OS,
+  CONFIG_HOST,
+  CONFIG_KERNEL,
+  CONFIG_CPU,
+  CONFIG_GPU,
+  CONFIG_GPUS,
+  CONFIG_RAM,
+  CONFIG_RESOLUTION,
+  CONFIG_SHELL,
+  CONFIG_PKGS,
+  CONFIG_UPTIME,
+  CONFIG_COLORS,
+  CONFIG_CACHE
+};
+
+static const struct field_key config_keys[] = {
+    {"distro", CONFIG_DISTRO}, {"image", CONFIG_IMAGE},   {"user", CONFIG_USER},   {"os", CONFIG_OS},
+    {"host", CONFIG_HOST},     {"kernel", CONFIG_KERNEL}, {"cpu", CONFIG_CPU},     {"gpu", CONFIG_GPU},
+    {"gpus", CONFIG_GPUS},     {"ram", CONFIG_RAM},       {"resolution", CONFIG_RESOLUTION},
+    {"shell", CONFIG_SHELL},   {"pkgs", CONFIG_PKGS},     {"uptime", CONFIG_UPTIME}, {"colors", CONFIG_COLORS},
+    {"cache", CONFIG_CACHE},
+};
+static struct field_table config_table = FIELD_TABLE(config_keys);
+
+struct config_scan {
+  struct configuration* config_flags;
+  struct info* user_info;
 };
 
+static bool config_field(void* ctx, int id, const char* value, size_t len) {
+  struct configuration* config_flags = ((struct config_scan*)ctx)->config_flags;
+  struct info* user_info             = ((struct config_scan*)ctx)->user_info;
+  // a boolean is the leading "true"/"false" letters, a comment may follow; anything else leaves the option as it is
+  size_t word = 0;
+  while (word < len && strchr("truefals", value[word])) word++;
+  bool is_true = word == 4 && memcmp(value, "true", 4) == 0, is_false = word == 5 && memcmp(value, "false", 5) == 0;
+  bool* option = NULL;
+  switch (id) {
+  case CONFIG_DISTRO: { // the first word
+    size_t distro_len = 0;
+    while (distro_len < len && !isspace((unsigned char)value[distro_len])) distro_len++;
+    if (distro_len > 0) set_info(user_info, &user_info->os_name, value, distro_len);
+    return true;
+  }
+  case CONFIG_IMAGE: { // a quoted path
+    if (len < 2 || value[0] != '"' || value[1] == '"') return true;
+    const char* quote = memchr(value + 1, '"', len - 1);
+    char image_name[128];
+    snprintf(image_name, sizeof(image_name), "%.*s", (int)((quote ? quote : value + len) - value - 1), value + 1);
+    if (image_name[0] == '~') // replacing the ~ character with the home directory
+      set_infof(user_info, &user_info->image_name, "/home/%s%s", user_info->user, image_name + 1);
+    else
+      set_info(user_info, &user_info->image_name, image_name, strlen(image_name));
+    config_flags->show_image = 1; // enable the image flag
+    return true;
+  }
+  case CONFIG_USER: // off unless "true"
+    if (word > 0) config_flags->show.user = is_true;
+    LOG_V(config_flags->show.user);
+    return true;
+  case CONFIG_GPU: {
+    if (len == 0 || !(value[0] == '-' || (value[0] >= '0' && value[0] <= '9'))) return true;
+    int gpu_cfg_count = atoi(value);
+    if (gpu_cfg_count > 255) {
+      LOG_E("gpu config index is too high, setting it to 255");
+      gpu_cfg_count = 255;
+    } else if (gpu_cfg_count < 0) {
+      LOG_E("gpu config index is too low, setting it to 0");
+      gpu_cfg_count = 0;
+    }
+    config_flags->hidden_gpus[gpu_cfg_count / 8] |= 1 << gpu_cfg_count % 8;
+    LOG_V(gpu_cfg_count);
+    return true;
+  }
+  case CONFIG_GPUS: // global gpu toggle
+    if (word == 0) return true;
+    config_flags->show_gpus = config_flags->show.gpu = !is_false; // enable getting gpu info
+    LOG_V(config_flags->show_gpus);
+    return true;
+  case CONFIG_OS: option = &config_flags->show.os; break;
+  case CONFIG_HOST: option = &config_flags->show.model; break;
+  case CONFIG_KERNEL: option = &config_flags->show.kernel; break;
+  case CONFIG_CPU: option = &config_flags->show.cpu; break;
+  case CONFIG_RAM: option = &config_flags->show.ram; break;
+  case CONFIG_RESOLUTION: option = &config_flags->show.resolution; break;
+  case CONFIG_SHELL: option = &config_flags->show.shell; break;
+  case CONFIG_PKGS: option = &config_flags->show.pkgs; break;
+  case CONFIG_UPTIME: option = &config_flags->show.uptime; break;
+  case CONFIG_COLORS: option = &config_flags->show_colors; break;
+  case CONFIG_CACHE: option = &config_flags->use_cache; break;
+  }
+  if (option && word > 0) *option = !is_false; // on unless "false"
+  return true;
+}
+
 // reads the config file
 struct configuration parse_config(struct info* user_info, struct user_config* user_config_file) {
   LOG_I("parsing config");
-  char buffer[256]; // buffer for the current line
   // enabling all flags by default
   struct configuration config_flags;
   memset(&config_flags, true, sizeof(config_flags));
+  memset(config_flags.hidden_gpus, 0, sizeof(config_flags.hidden_gpus));
 
   config_flags.show_image = false;
 
@@ -93,93 +210,17 @@ struct configuration parse_config(struct info* user_info, struct user_config* us
     config = fopen(user_config_file->config_directory, "r");
   if (config == NULL) return config_flags; // if config file does not exist, return the defaults
 
-  int gpu_cfg_count = 0;
-
   // reading the config file
-  while (fgets(buffer, sizeof(buffer), config)) {
-    sscanf(buffer, "distro=%s", user_info->os_name);
-    if (sscanf(buffer, "image=\"%[^\"]\"", user_info->image_name)) {
-      if (user_info->image_name[0] == '~') {                                                          // replacing the ~ character with the home directory
-        memmove(&user_info->image_name[0], &user_info->image_name[1], strlen(user_info->image_name)); // remove the first char
-        char temp[128] = "/home/";
-        strcat(temp, user_info->user);
-        strcat(temp, user_info->image_name);
-        sprintf(user_info->image_name, "%s", temp);
-      }
-      config_flags.show_image = 1; // enable the image flag
-    }
-
-    // reading other values
-    if (sscanf(buffer, "user=%[truefalse]", buffer)) {
-      config_flags.show.user = !strcmp(buffer, "true");
-      LOG_V(config_flags.show.user);
-    }
-    if (sscanf(buffer, "os=%[truefalse]", buffer)) {
-      config_flags.show.os = strcmp(buffer, "false");
-      LOG_V(config_flags.show.os);
-    }
-    if (sscanf(buffer, "host=%[truefalse]", buffer)) {
-      config_flags.show.model = strcmp(buffer, "false");
-      LOG_V(config_flags.show.model);
-    }
-    if (sscanf(buffer, "kernel=%[truefalse]", buffer)) {
-      config_flags.show.kernel = strcmp(buffer, "false");
-      LOG_V(config_flags.show.kernel);
-    }
-    if (sscanf(buffer, "cpu=%[truefalse]", buffer)) {
-      config_flags.show.cpu = strcmp(buffer, "false");
-      LOG_V(config_flags.show.cpu);
-    }
-    if (sscanf(buffer, "gpu=%d", &gpu_cfg_count)) {
-      if (gpu_cfg_count > 255) {
-        LOG_E("gpu config index is too high, setting it to 255");
-        gpu_cfg_count = 255;
-      } else if (gpu_cfg_count < 0) {
-        LOG_E("gpu config index is too low, setting it to 0");
-        gpu_cfg_count = 0;
-      }
-      config_flags.show_gpu[gpu_cfg_count] = false;
-      LOG_V(config_flags.show_gpu[gpu_cfg_count]);
-    }
-    if (sscanf(buffer, "gpus=%[truefalse]", buffer)) { // global gpu toggle
-      if (strcmp(buffer, "false") == 0) {
-        config_flags.show_gpus = false;
-        config_flags.show.gpu  = false; // enable getting gpu info
-      } else {
-        config_flags.show_gpus = true;
-        config_flags.show.gpu  = true;
-      }
-      LOG_V(config_flags.show_gpus);
-      LOG_V(config_flags.show.gpu);
-    }
-    if (sscanf(buffer, "ram=%[truefalse]", buffer)) {
-      config_flags.show.ram = strcmp(buffer, "false");
-      LOG_V(config_flags.show.ram);
-    }
-    if (sscanf(buffer, "resolution=%[truefalse]", buffer)) {
-      config_flags.show.resolution = strcmp(buffer, "false");
-      LOG_V(config_flags.show.resolution);
-    }
-    if (sscanf(buffer, "shell=%[truefalse]", buffer)) {
-      config_flags.show.shell = strcmp(buffer, "false");
-      LOG_V(config_flags.show.shell);
-    }
-    if (sscanf(buffer, "pkgs=%[truefalse]", buffer)) {
-      config_flags.show.pkgs = strcmp(buffer, "false");
-      LOG_V(config_flags.show.pkgs);
-    }
-    if (sscanf(buffer, "uptime=%[truefalse]", buffer)) {
-      config_flags.show.uptime = strcmp(buffer, "false");
-      LOG_V(config_flags.show.uptime);
-    }
-    if (sscanf(buffer, "colors=%[truefalse]", buffer)) {
-      config_flags.show_colors = strcmp(buffer, "false");
-      LOG_V(config_flags.show_colors);
-    }
-  }
+  size_t len;
+  char* data = read_stream(config, &len);
+  fclose(config);
+  if (!data) return config_flags;
+  user_config_file->config_hash = hash_bytes(1469598103934665603ULL, data, len);
+  struct config_scan scan       = {&config_flags, user_info};
+  scan_fields(data, len, '=', &config_table, config_field, &scan);
+  free(data);
   LOG_V(user_info->os_name);
   LOG_V(user_info->image_name);
-  fclose(config);
   return config_flags;
 }
 
@@ -187,17 +228,25 @@ struct configuration parse_config(struct info* user_info, struct user_config* us
 int print_image(struct info* user_info) {
   LOG_I("printing image");
 #ifndef __IPHONE__
-  char command[256];
   if (strlen(user_info->image_name) < 1) {
     char* repl_str = strcmp(user_info->os_name, "android") == 0 ? "/data/data/com.termux/files/usr/lib/freakyfetch/freaky.png"
                      : strcmp(user_info->os_name, "macos") == 0 ? "/usr/local/lib/freakyfetch/freaky.png"
                                                                 : "/usr/lib/freakyfetch/freaky.png";
-    sprintf(user_info->image_name, repl_str); // image command for android
+    set_infof(user_info, &user_info->image_name, "%s", repl_str); // image command for android
     LOG_V(user_info->image_name);
   }
-  sprintf(command, "viu -t -w 18 -h 9 %s 2> /dev/null", user_info->image_name); // creating the command to show the image
+  #ifndef _WIN32
+  const char* viu_argv[] = {"viu", "-t", "-w", "18", "-h", "9", user_info->image_name, NULL}; // creating the command to show the image
+  struct probe viu       = {.argv = viu_argv, .timeout_ms = 5000, .inherit_stdout = true};
+  fflush(stdout); // viu writes to the same terminal
+  run_probes(&viu, 1);
+  if (viu.status != 0) // if viu is not installed or the image is missing
+  #else
+  char command[256];
+  sprintf(command, "viu -t -w 18 -h 9 %s 2> nul", user_info->image_name);
   LOG_V(command);
-  if (system(command) != 0) // if viu is not installed or the image is missing
+  if (system(command) != 0)
+  #endif
     printf("\033[0E\033[3C%s\n"
            "   There was an\n"
            "    error: viu\n"
@@ -219,21 +268,6 @@ int print_image(struct info* user_info) {
   return 9;
 }
 
-// Replaces all terms in a string with another term.
-void replace(char* original, char* search, char* replacer) {
-  char* ch;
-  char buffer[1024];
-  int offset = 0;
-  while ((ch = strstr(original + offset, search))) {
-    strncpy(buffer, original, ch - original);
-    buffer[ch - original] = 0;
-    sprintf(buffer + (ch - original), "%s%s", replacer, ch + strlen(search));
-    original[0] = 0;
-    strcpy(original, buffer);
-    offset = ch - original + strlen(replacer);
-  }
-}
-
 // Replaces all terms in a string with another term, case insensitive
 void replace_ignorecase(char* original, char* search, char* replacer) {
   char* ch;
@@ -271,7 +305,7 @@ char* strsep(char** stringp, const char* delim) {
 // freakifies distro name
 void freak_name(struct info* user_info) {
 #define STRING_TO_FREAK(original, freakified) \
-  if (strcmp(user_info->os_name, original) == 0) sprintf(user_info->os_name, "%s", freakified)
+  if (strcmp(user_info->os_name, original) == 0) set_infof(user_info, &user_info->os_name, "%s", freakified)
   // linux
   STRING_TO_FREAK("alpine", "Freakpine");
   else STRING_TO_FREAK("amogos", "Freaky Imposter");
@@ -316,7 +350,7 @@ void freak_name(struct info* user_info) {
   // Windows
   else STRING_TO_FREAK("windows", "Freakdows");
 
-  else sprintf(user_info->os_name, "%s", "Ultra Freaky OS");
+  else set_infof(user_info, &user_info->os_name, "%s", "Ultra Freaky OS");
 #undef STRING_TO_FREAK
 }
 
@@ -441,41 +475,103 @@ void freak_pkgman(char* pkgman_name) {
 #undef PKGMAN_TO_FREAK
 }
 
-// freakifies everything
-void freakify_all(struct info* user_info) {
+// freakifies a copy of a field of user_info, and sets the field to it
+static void freak_field(struct info* user_info, const char** field, void (*freak)(char*)) {
+  char value[1024]; // the size replace_ignorecase() works with
+  snprintf(value, sizeof(value), "%s", *field);
+  freak(value);
+  set_info(user_info, field, value, strlen(value));
+}
+
+static void freak_gpus(struct info* user_info) {
+  for (int i = 0; i < user_info->gpu_count; i++) freak_field(user_info, &user_info->gpu_model[i], freak_hw);
+}
+static void freak_cpu(struct info* user_info) { freak_field(user_info, &user_info->cpu_model, freak_hw); }
+static void freak_model(struct info* user_info) { freak_field(user_info, &user_info->model, freak_hw); }
+static void freak_kernel_field(struct info* user_info) { freak_field(user_info, &user_info->kernel, freak_kernel); }
+static void freak_pkgman_field(struct info* user_info) { freak_field(user_info, &user_info->pkgman_name, freak_pkgman); }
+
+// freakifies the shown fields
+void freakify_all(struct info* user_info, struct flags shown) {
   LOG_I("freakifing everything");
   if (strcmp(user_info->os_name, "windows"))
     MOVE_CURSOR = "\033[21C"; // to print windows logo on not windows systems
-  freak_kernel(user_info->kernel);
-  for (int i = 0; user_info->gpu_model[i][0]; i++) freak_hw(user_info->gpu_model[i]);
-  freak_hw(user_info->cpu_model);
+  static const struct {
+    size_t field; // flag of the field in struct flags
+    void (*freakify)(struct info*);
+  } post[] = {
+      {offsetof(struct flags, kernel), freak_kernel_field}, {offsetof(struct flags, gpu), freak_gpus},
+      {offsetof(struct flags, cpu), freak_cpu},             {offsetof(struct flags, model), freak_model},
+      {offsetof(struct flags, pkgs), freak_pkgman_field},
+  };
+  for (size_t i = 0; i < sizeof(post) / sizeof(post[0]); i++)
+    if (*(bool*)((char*)&shown + post[i].field)) post[i].freakify(user_info);
   LOG_V(user_info->cpu_model);
-  freak_hw(user_info->model);
   LOG_V(user_info->model);
-  freak_pkgman(user_info->pkgman_name);
   LOG_V(user_info->pkgman_name);
 }
 
-// prints all the collected info and returns the number of printed lines
-int print_info(struct configuration* config_flags, struct info* user_info) {
+// values that change between two runs, the motd frame keeps a fixed-width slot for them
+enum { SLOT_RAM, SLOT_UPTIME };
+#define SLOT_WIDTH 24
+
+struct frame_slot {
+  uint32_t offset, width; // position in the frame and visible width
+  int kind;
+};
+
+struct frame_slots {
+  struct frame_slot slot[2];
+  int count;
+};
+
+static void format_dynamic(char* value, size_t size, int kind, struct info* user_info) {
+  if (kind == SLOT_RAM) {
+    snprintf(value, size, "%i MiB/%i MiB", user_info->ram_used, user_info->ram_total);
+    return;
+  }
+  switch (user_info->uptime) { // formatting the uptime which is store in seconds
+  case 0 ... 3599:
+    snprintf(value, size, "%lim", user_info->uptime / 60 % 60);
+    break;
+  case 3600 ... 86399:
+    snprintf(value, size, "%lih, %lim", user_info->uptime / 3600, user_info->uptime / 60 % 60);
+    break;
+  default:
+    snprintf(value, size, "%lid, %lih, %lim", user_info->uptime / 86400, user_info->uptime / 3600 % 24, user_info->uptime / 60 % 60);
+  }
+}
+
+// prints a line ending with a dynamic value, which gets a slot in the frame if slots is set
+static void print_dynamic(FILE* out, int max_width, struct frame_slots* slots, int kind, const char* label, struct info* user_info) {
+  char value[64], line[256];
+  format_dynamic(value, sizeof(value), kind, user_info);
+  int prefix_len = snprintf(line, sizeof(line), "%s%s%s%s%s", MOVE_CURSOR, NORMAL, BOLD, label, NORMAL);
+  if (slots) {
+    snprintf(line + prefix_len, sizeof(line) - prefix_len, "%-*.*s", SLOT_WIDTH, SLOT_WIDTH, value);
+    int width = max_width < 0 ? SLOT_WIDTH : max_width - prefix_len; // the line may be cut by the terminal width
+    if (width > SLOT_WIDTH) width = SLOT_WIDTH;
+    if (width > 0 && slots->count < 2) slots->slot[slots->count++] = (struct frame_slot){ftell(out) + prefix_len, width, kind};
+  } else
+    snprintf(line + prefix_len, sizeof(line) - prefix_len, "%s", value);
+  fprintf(out, "%.*s\n", max_width, line);
+}
+
+// prints all the collected info to out and returns the number of printed lines, slots gets the dynamic values
+int print_info(FILE* out, struct configuration* config_flags, struct info* user_info, struct frame_slots* slots) {
   int line_count = 0;
 #ifdef _WIN32
+  int max_width = user_info->ws_col - 4;
+#else
+  int max_width = user_info->win.ws_col - 4;
+#endif
   // prints without overflowing the terminal width
-  #define responsively_printf(buf, format, ...)     \
-    {                                               \
-      sprintf(buf, format, __VA_ARGS__);            \
-      printf("%.*s\n", user_info->ws_col - 4, buf); \
-      line_count++;                                 \
-    }
-#else // _WIN32
-  // prints without overflowing the terminal width
-  #define responsively_printf(buf, format, ...)         \
-    {                                                   \
-      sprintf(buf, format, __VA_ARGS__);                \
-      printf("%.*s\n", user_info->win.ws_col - 4, buf); \
-      line_count++;                                     \
-    }
-#endif                  // _WIN32
+#define responsively_printf(buf, format, ...)  \
+  {                                            \
+    sprintf(buf, format, __VA_ARGS__);         \
+    fprintf(out, "%.*s\n", max_width, buf);    \
+    line_count++;                              \
+  }
   char print_buf[1024]; // for responsively print
 
   // print collected info - from host to cpu info
@@ -491,37 +587,35 @@ int print_info(struct configuration* config_flags, struct info* user_info) {
   if (config_flags->show.cpu)
     responsively_printf(print_buf, "%s%s%sCPU    %s%s", MOVE_CURSOR, NORMAL, BOLD, NORMAL, user_info->cpu_model);
 
-  for (int i = 0; i < 256; i++) {
-    if (config_flags->show_gpu[i])
-      if (user_info->gpu_model[i][0])
-        responsively_printf(print_buf, "%s%s%sGPU    %s%s", MOVE_CURSOR, NORMAL, BOLD, NORMAL, user_info->gpu_model[i]);
+  for (int i = 0; i < user_info->gpu_count; i++) {
+    if (i >= 256 || !(config_flags->hidden_gpus[i / 8] & 1 << i % 8))
+      responsively_printf(print_buf, "%s%s%sGPU    %s%s", MOVE_CURSOR, NORMAL, BOLD, NORMAL, user_info->gpu_model[i]);
   }
 
-  if (config_flags->show.ram) // print ram
-    responsively_printf(print_buf, "%s%s%sMEMORY   %s%i MiB/%i MiB", MOVE_CURSOR, NORMAL, BOLD, NORMAL, (user_info->ram_used), user_info->ram_total);
-  if (config_flags->show.resolution) // print resolution
-    if (user_info->screen_width != 0 || user_info->screen_height != 0)
+  if (config_flags->show.ram) { // print ram
+    print_dynamic(out, max_width, slots, SLOT_RAM, "MEMORY   ", user_info);
+    line_count++;
+  }
+  if (config_flags->show.resolution) { // print resolution, one line per output when there are more of them
+    if (user_info->screen_count > 1) {
+      for (int i = 0; i < user_info->screen_count; i++)
+        responsively_printf(print_buf, "%s%s%sRESOLUTION%s  %dx%d (%s)", MOVE_CURSOR, NORMAL, BOLD, NORMAL, user_info->screen_widths[i], user_info->screen_heights[i], user_info->screen_names[i]);
+    } else if (user_info->screen_width != 0 || user_info->screen_height != 0)
       responsively_printf(print_buf, "%s%s%sRESOLUTION%s  %dx%d", MOVE_CURSOR, NORMAL, BOLD, NORMAL, user_info->screen_width, user_info->screen_height);
+  }
   if (config_flags->show.shell) // print shell name
     responsively_printf(print_buf, "%s%s%sSHELL    %s%s", MOVE_CURSOR, NORMAL, BOLD, NORMAL, user_info->shell);
   if (config_flags->show.pkgs) // print pkgs
     responsively_printf(print_buf, "%s%s%sPKGS     %s%d: %s", MOVE_CURSOR, NORMAL, BOLD, NORMAL, user_info->pkgs, user_info->pkgman_name);
   // #endif
   if (config_flags->show.uptime) {
-    switch (user_info->uptime) { // formatting the uptime which is store in seconds
-    case 0 ... 3599:
-      responsively_printf(print_buf, "%s%s%sUPTIME %s%lim", MOVE_CURSOR, NORMAL, BOLD, NORMAL, user_info->uptime / 60 % 60);
-      break;
-    case 3600 ... 86399:
-      responsively_printf(print_buf, "%s%s%sUPTIME %s%lih, %lim", MOVE_CURSOR, NORMAL, BOLD, NORMAL, user_info->uptime / 3600, user_info->uptime / 60 % 60);
-      break;
-    default:
-      responsively_printf(print_buf, "%s%s%sUPTIME %s%lid, %lih, %lim", MOVE_CURSOR, NORMAL, BOLD, NORMAL, user_info->uptime / 86400, user_info->uptime / 3600 % 24, user_info->uptime / 60 % 60);
-    }
+    print_dynamic(out, max_width, slots, SLOT_UPTIME, "UPTIME ", user_info);
+    line_count++;
   }
+#undef responsively_printf
   // clang-format off
 	if (config_flags->show_colors)
-		printf("%s"	BOLD BLACK BLOCK_CHAR BLOCK_CHAR RED BLOCK_CHAR
+		fprintf(out, "%s"	BOLD BLACK BLOCK_CHAR BLOCK_CHAR RED BLOCK_CHAR
 								BLOCK_CHAR GREEN BLOCK_CHAR BLOCK_CHAR YELLOW
 								BLOCK_CHAR BLOCK_CHAR BLUE BLOCK_CHAR BLOCK_CHAR
 								MAGENTA BLOCK_CHAR BLOCK_CHAR CYAN BLOCK_CHAR
@@ -530,132 +624,463 @@ int print_info(struct configuration* config_flags, struct info* user_info) {
   return line_count;
 }
 
-// writes cache to cache file
-void write_cache(struct info* user_info) {
-  LOG_I("writing cache");
-  char cache_file[512];
-  sprintf(cache_file, "%s/.cache/freakyfetch.cache", getenv("HOME")); // default cache file location
-  LOG_V(cache_file);
-  FILE* cache_fp = fopen(cache_file, "w");
+// builds the cache file path
+static bool cache_path(char* path, size_t size) {
+  if (!getenv("HOME")) return false;
+  return snprintf(path, size, "%s/.cache/freakyfetch.cache", getenv("HOME")) < (int)size; // default cache file location
+}
+
+#ifndef _WIN32
+  #define HOST_CACHE_DIR "/run/freakyfetch"
+  #define HOST_CACHE_FILE HOST_CACHE_DIR "/host.cache" // host-wide fields published by root for every user
+#endif
+
+// replaces cache_file in one go, a concurrent reader sees either the old or the new cache. mode is set whatever the
+// umask: 0644 for the host cache every user reads, 0600 for the files of one user
+static bool write_cache_file(const char* cache_file, const char* blob, size_t len, mode_t mode) {
+  char tmp_file[540];
+  snprintf(tmp_file, sizeof(tmp_file), "%s.%d", cache_file, (int)getpid());
+  FILE* cache_fp = fopen(tmp_file, "wb");
   if (cache_fp == NULL) {
+    LOG_E("Failed to write to %s!", tmp_file);
+    return false;
+  }
+  bool written = fwrite(blob, 1, len, cache_fp) == len;
+  if (fclose(cache_fp) != 0) written = false;
+#ifndef _WIN32
+  if (written) chmod(tmp_file, mode);
+#else
+  (void)mode;
+#endif
+  if (!written || rename(tmp_file, cache_file) != 0) {
     LOG_E("Failed to write to %s!", cache_file);
-    return;
+    remove(tmp_file);
+    return false;
   }
-  // writing all info to the cache file
-  fprintf( // writing most of the values to config file
-      cache_fp,
-      "user=%s\nhost=%s\nversion_name=%s\nhost_model=%s\nkernel=%s\ncpu=%"
-      "s\nscreen_width=%d\nscreen_height=%d\nshell=%s\npkgs=%d\npkgman_name=%"
-      "s\n",
-      user_info->user, user_info->host, user_info->os_name, user_info->model, user_info->kernel,
-      user_info->cpu_model, user_info->screen_width, user_info->screen_height, user_info->shell,
-      user_info->pkgs, user_info->pkgman_name);
+  return true;
+}
 
-  for (int i = 0; user_info->gpu_model[i][0]; i++) // writing gpu names to file
-    fprintf(cache_fp, "gpu=%s\n", user_info->gpu_model[i]);
+// writes the fields in collected to the cache file, root also publishes them for the other users
+void write_cache(struct info* user_info, struct flags collected) {
+  LOG_I("writing cache");
+  char cache_file[512];
+  size_t len = 0;
+  char* blob = pack_info(user_info, collected, &len);
+  if (!blob) return;
+  if (cache_path(cache_file, sizeof(cache_file))) {
+    LOG_V(cache_file);
+    write_cache_file(cache_file, blob, len, 0600);
+  }
+  free(blob);
+#ifndef _WIN32
+  if (geteuid() == 0 && (mkdir(HOST_CACHE_DIR, 0755) == 0 || errno == EEXIST) &&
+      (blob = pack_host_info(user_info, collected, &len))) {
+    LOG_I("publishing the host cache");
+    write_cache_file(HOST_CACHE_FILE, blob, len, 0644);
+    free(blob);
+  }
+#endif
+}
 
+static int read_cache_file(const char* cache_file, struct info* user_info, struct flags* stale, struct flags* cached) {
+  LOG_V(cache_file);
+  FILE* cache_fp = fopen(cache_file, "rb");
+  if (cache_fp == NULL) return 0;
+  char* blob = malloc(CACHE_MAX_SIZE);
+  size_t len = blob ? fread(blob, 1, CACHE_MAX_SIZE, cache_fp) : 0;
   fclose(cache_fp);
-  return;
+  int read = blob && unpack_info(blob, len, user_info, stale, cached);
+  free(blob);
+  return read;
 }
 
-// reads cache file if it exists
-int read_cache(struct info* user_info) {
+// reads the cache file if it exists and is valid, stale gets the fields to collect again and cached the ones it had
+int read_cache(struct info* user_info, struct flags* stale, struct flags* cached) {
   LOG_I("reading cache");
   char cache_file[512];
-  sprintf(cache_file, "%s/.cache/freakyfetch.cache", getenv("HOME")); // cache file location
-  LOG_V(cache_file);
-  FILE* cache_fp = fopen(cache_file, "r");
-  if (cache_fp == NULL) return 0;
-  char buffer[256];                                 // line buffer
-  int gpuc = 0;                                     // gpu counter
-  while (fgets(buffer, sizeof(buffer), cache_fp)) { // reading the file
-    sscanf(buffer, "user=%99[^\n]", user_info->user);
-    sscanf(buffer, "host=%99[^\n]", user_info->host);
-    sscanf(buffer, "version_name=%99[^\n]", user_info->os_name);
-    sscanf(buffer, "host_model=%99[^\n]", user_info->model);
-    sscanf(buffer, "kernel=%99[^\n]", user_info->kernel);
-    sscanf(buffer, "cpu=%99[^\n]", user_info->cpu_model);
-    if (sscanf(buffer, "gpu=%99[^\n]", user_info->gpu_model[gpuc]) != 0) gpuc++;
-    sscanf(buffer, "screen_width=%i", &user_info->screen_width);
-    sscanf(buffer, "screen_height=%i", &user_info->screen_height);
-    sscanf(buffer, "shell=%99[^\n]", user_info->shell);
-    sscanf(buffer, "pkgs=%i", &user_info->pkgs);
-    sscanf(buffer, "pkgman_name=%99[^\n]", user_info->pkgman_name);
-  }
-  LOG_V(user_info->user);
-  LOG_V(user_info->host);
-  LOG_V(user_info->os_name);
-  LOG_V(user_info->model);
-  LOG_V(user_info->kernel);
-  LOG_V(user_info->cpu_model);
-  LOG_V(user_info->gpu_model[gpuc]);
-  LOG_V(user_info->screen_width);
-  LOG_V(user_info->screen_height);
-  LOG_V(user_info->shell);
-  LOG_V(user_info->pkgs);
-  LOG_V(user_info->pkgman_name);
-  fclose(cache_fp);
+  int found = cache_path(cache_file, sizeof(cache_file)) && read_cache_file(cache_file, user_info, stale, cached);
+#ifndef _WIN32
+  // the fields that are missing or outdated here may still be valid in the host cache
+  if (found && !(stale->os || stale->model || stale->kernel || stale->cpu || stale->gpu)) return found;
+  struct info host_info;
+  struct flags host_stale, host_cached;
+  LOG_I("reading host cache");
+  init_info(&host_info);
+  if (!read_cache_file(HOST_CACHE_FILE, &host_info, &host_stale, &host_cached)) {
+    free_info(&host_info);
+    return found;
+  }
+  if (!found) *stale = *cached = (struct flags){0};
+  // root's count has the stores in its HOME (nix, flatpak, guix, brew), every user counts their own
+  host_cached.pkgs   = false;
+  host_stale.pkgs    = true;
+  struct flags adopt = {0};
+  bool *from_host = (bool*)&adopt, *outdated = (bool*)stale, *in_cache = (bool*)cached;
+  bool *host_outdated = (bool*)&host_stale, *in_host_cache = (bool*)&host_cached;
+  for (size_t i = 0; i < sizeof(struct flags) / sizeof(bool); i++) {
+    from_host[i] = in_host_cache[i] && !host_outdated[i] && (!found || outdated[i]);
+    if (from_host[i]) {
+      outdated[i] = false;
+      in_cache[i] = true;
+    } else if (!found)
+      outdated[i] = host_outdated[i];
+  }
+  merge_info(user_info, &host_info, adopt);
+  free_info(&host_info);
   return 1;
+#else
+  return found;
+#endif
 }
 
-// prints logo (as ascii art) of the given system.
-int print_ascii(struct info* user_info) {
-  FILE* file;
-  char ascii_file[1024];
-  // First tries to get ascii art file from local directory. Useful for debugging
-  sprintf(ascii_file, "./res/ascii/freaky.txt");
-  LOG_V(ascii_file);
-  file = fopen(ascii_file, "r");
-  if (!file) { // if the file does not exist in the local directory, open it from the installation directory
-    if (strcmp(user_info->os_name, "android") == 0)
-      sprintf(ascii_file, "/data/data/com.termux/files/usr/lib/freakyfetch/ascii/freaky.txt");
-    else if (strcmp(user_info->os_name, "macos") == 0)
-      sprintf(ascii_file, "/usr/local/lib/freakyfetch/ascii/freaky.txt");
-    else
-      sprintf(ascii_file, "/usr/lib/freakyfetch/ascii/freaky.txt");
-    LOG_V(ascii_file);
-
-    file = fopen(ascii_file, "r");
-    if (!file) {
-      // Prevent infinite loops
-      if (strcmp(user_info->os_name, "unknown") == 0) {
-        LOG_E("No\nunknown\nascii\nfile\n\n\n\n");
-        return 7;
+#ifndef _WIN32
+  #define SINGLE_FLIGHT_WAIT_MS 5000 // longer than the deadline of the commands run by get_info()
+
+// per-user directory for the files shared by the concurrent runs
+static bool runtime_path(char* path, size_t size, const char* file) {
+  char dir[256];
+  if (getenv("XDG_RUNTIME_DIR"))
+    snprintf(dir, sizeof(dir), "%s/freakyfetch", getenv("XDG_RUNTIME_DIR"));
+  else
+    snprintf(dir, sizeof(dir), "/tmp/freakyfetch-%u", (unsigned)getuid());
+  struct stat st;
+  // /tmp is shared, the directory must be ours and not a symlink planted by someone else
+  if ((mkdir(dir, 0700) != 0 && errno != EEXIST) || lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid())
+    return false;
+  return snprintf(path, size, "%s/%s", dir, file) < (int)size;
+}
+
+// concurrent runs collect once: the first one takes the lock and shares what it collected, the others wait for it
+// and only collect what it could not give them
+void get_info_coalesced(struct flags* collect, struct info* user_info) {
+  char lock_file[300], result_file[300];
+  bool shared = collect->os || collect->model || collect->kernel || collect->cpu || collect->gpu || collect->pkgs;
+  int lock_fd = -1;
+  if (shared && runtime_path(lock_file, sizeof(lock_file), "collect.lock") && runtime_path(result_file, sizeof(result_file), "result"))
+    lock_fd = open(lock_file, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (lock_fd >= 0 && flock(lock_fd, LOCK_EX | LOCK_NB) != 0) {
+    LOG_I("another run is collecting, waiting for it");
+    bool locked = false;
+    for (int waited = 0; waited < SINGLE_FLIGHT_WAIT_MS && !locked; waited += 10) {
+      nanosleep(&(struct timespec){0, 10 * 1000000}, NULL);
+      locked = flock(lock_fd, LOCK_EX | LOCK_NB) == 0;
+    }
+    struct info* result = locked ? malloc(sizeof(struct info)) : NULL;
+    struct flags result_stale, result_cached, adopt = {0};
+    bool shared_result = false;
+    if (result) init_info(result);
+    if (result && read_cache_file(result_file, result, &result_stale, &result_cached)) {
+      bool *needed = (bool*)collect, *from_result = (bool*)&adopt;
+      for (size_t i = 0; i < sizeof(struct flags) / sizeof(bool); i++) {
+        from_result[i] = needed[i] && ((bool*)&result_cached)[i] && !((bool*)&result_stale)[i];
+        needed[i]      = needed[i] && !from_result[i];
       }
-      sprintf(user_info->os_name, "unknown"); // current os is not supported
-      LOG_V(user_info->os_name);
-      return print_ascii(user_info);
+      merge_info(user_info, result, adopt);
+      shared_result = true;
+    }
+    if (result) free_info(result);
+    free(result);
+    // what is left is collected without the lock, so the other waiters read the result at once instead of in turn.
+    // Without a result this run collects for them as the first one would have
+    if (!locked || shared_result) { // or the other run is stuck, not waiting any longer
+      close(lock_fd);
+      lock_fd = -1;
     }
   }
-  char buffer[256]; // line buffer
-  int line_count = 1;
-  printf("\n");
-  while (fgets(buffer, 256, file)) { // replacing color placecholders
-    replace(buffer, "{NORMAL}", NORMAL);
-    replace(buffer, "{BOLD}", BOLD);
-    replace(buffer, "{BLACK}", BLACK);
-    replace(buffer, "{RED}", RED);
-    replace(buffer, "{GREEN}", GREEN);
-    replace(buffer, "{SPRING_GREEN}", SPRING_GREEN);
-    replace(buffer, "{YELLOW}", YELLOW);
-    replace(buffer, "{BLUE}", BLUE);
-    replace(buffer, "{MAGENTA}", MAGENTA);
-    replace(buffer, "{CYAN}", CYAN);
-    replace(buffer, "{WHITE}", WHITE);
-    replace(buffer, "{PINK}", PINK);
-    replace(buffer, "{LPINK}", LPINK);
-    replace(buffer, "{BLOCK}", BLOCK_CHAR);
-    replace(buffer, "{BLOCK_VERTICAL}", BLOCK_CHAR);
-    replace(buffer, "{BACKGROUND_GREEN}", "\e[0;42m");
-    replace(buffer, "{BACKGROUND_RED}", "\e[0;41m");
-    replace(buffer, "{BACKGROUND_WHITE}", "\e[0;47m");
-    printf("%s", buffer); // print the line after setting the color
-    line_count++;
+  get_info(*collect, user_info);
+  // the lock is still held, so the runs that are waiting see the result as soon as they get it
+  if (lock_fd >= 0 && (collect->os || collect->model || collect->kernel || collect->cpu || collect->gpu || collect->pkgs)) {
+    size_t len = 0;
+    char* blob = pack_info(user_info, *collect, &len);
+    if (blob) write_cache_file(result_file, blob, len, 0600);
+    free(blob);
   }
-  // Always set color to NORMAL, so there's no need to do this in every ascii file.
-  printf(NORMAL);
-  fclose(file);
-  return line_count;
+  if (lock_fd >= 0) close(lock_fd);
+}
+
+  #define MOTD_MAGIC "FFMOTD1"
+  #define MOTD_REVALIDATE_S 60 // how often a served frame checks that the cached data is still current
+  #define MOTD_MAX_SIZE (64 << 10)
+
+// a fully rendered frame, valid as long as the terminal width, the config, the options and the cached data are the same
+struct frame_header {
+  char magic[8];
+  uint64_t key;
+  int64_t rendered_at; // monotonic time is not kept across boots, wall clock seconds
+  uint32_t len;
+  struct frame_slots slots;
+};
+
+static bool motd_path(char* path, size_t size) {
+  if (!getenv("HOME")) return false;
+  return snprintf(path, size, "%s/.cache/freakyfetch.motd", getenv("HOME")) < (int)size;
+}
+
+static bool history_path(char* path, size_t size) {
+  if (!getenv("HOME")) return false;
+  return snprintf(path, size, "%s/.cache/freakyfetch.history", getenv("HOME")) < (int)size;
+}
+
+// the data generation is the identity of the cache files: anything that refreshes them replaces them
+static uint64_t cache_generation(uint64_t hash) {
+  char cache_file[512];
+  hash = hash_stat(hash, cache_path(cache_file, sizeof(cache_file)) ? cache_file : NULL);
+  return hash_stat(hash, HOST_CACHE_FILE);
+}
+
+// the frame depends on the whole terminal size: the width cuts the lines and the image logos are scaled to the cells
+static uint64_t frame_key(struct user_config* user_config_file, int argc, char* argv[]) {
+  struct winsize win = {0};
+  ioctl(STDOUT_FILENO, TIOCGWINSZ, &win);
+  uint16_t size[] = {win.ws_col, win.ws_row, win.ws_xpixel, win.ws_ypixel};
+  uint64_t key    = hash_bytes(user_config_file->config_hash, size, sizeof(size));
+  key             = hash_bytes(key, FREAKYFETCH_VERSION, sizeof(FREAKYFETCH_VERSION));
+  for (int i = 1; i < argc; i++) key = hash_bytes(key, argv[i], strlen(argv[i]) + 1); // with the NUL between them
+  return cache_generation(key);
+}
+
+// prints the stored frame if it is still valid, patching the dynamic values in
+static bool print_motd_frame(uint64_t key, struct info* user_info, bool* revalidate) {
+  char path[512];
+  if (!motd_path(path, sizeof(path))) return false;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  char* frame = malloc(MOTD_MAX_SIZE);
+  ssize_t len = frame ? read(fd, frame, MOTD_MAX_SIZE) : -1;
+  close(fd);
+  struct frame_header header;
+  if (len < (ssize_t)sizeof(header) || (memcpy(&header, frame, sizeof(header)), memcmp(header.magic, MOTD_MAGIC, 8) != 0) ||
+      header.key != key || len != (ssize_t)(sizeof(header) + header.len) || header.slots.count > 2) {
+    free(frame);
+    return false;
+  }
+  LOG_I("printing the stored motd frame");
+  char* body = frame + sizeof(header);
+  if (header.slots.count > 0) {
+    char buffer[256]; // line buffer
+    struct thread_varg vargp = {buffer, user_info, NULL, {false, true, false, false, false, false, false, true}};
+    get_sys(user_info);
+    get_ram(&vargp);
+    get_upt(&vargp);
+  }
+  for (int i = 0; i < header.slots.count; i++) {
+    struct frame_slot* slot = &header.slots.slot[i];
+    char value[64];
+    if (slot->offset + slot->width > header.len || slot->width > SLOT_WIDTH) continue;
+    format_dynamic(value, sizeof(value), slot->kind, user_info);
+    size_t value_len = strlen(value) < slot->width ? strlen(value) : slot->width;
+    memset(body + slot->offset, ' ', slot->width);
+    memcpy(body + slot->offset, value, value_len);
+  }
+  fwrite(body, 1, header.len, stdout);
+  *revalidate = time(NULL) - header.rendered_at > MOTD_REVALIDATE_S;
+  free(frame);
+  return true;
+}
+
+static void write_motd_frame(uint64_t key, const char* frame, size_t len, struct frame_slots* slots) {
+  char path[512];
+  if (!motd_path(path, sizeof(path)) || sizeof(struct frame_header) + len > MOTD_MAX_SIZE) return;
+  struct frame_header header = {MOTD_MAGIC, key, time(NULL), len, *slots};
+  char* blob                 = malloc(sizeof(header) + len);
+  if (!blob) return;
+  memcpy(blob, &header, sizeof(header));
+  memcpy(blob + sizeof(header), frame, len);
+  write_cache_file(path, blob, sizeof(header) + len, 0600);
+  free(blob);
+}
+
+// the frame was checked just now, it is good for MOTD_REVALIDATE_S more seconds
+static void touch_motd_frame(void) {
+  char path[512];
+  if (!motd_path(path, sizeof(path))) return;
+  int fd = open(path, O_WRONLY | O_CLOEXEC);
+  if (fd < 0) return;
+  int64_t now = time(NULL);
+  if (pwrite(fd, &now, sizeof(now), offsetof(struct frame_header, rendered_at)) != sizeof(now)) {
+    LOG_W("could not touch %s", path);
+  }
+  close(fd);
+}
+
+// collects the shown fields again in a detached process and replaces the cache, nobody waits for it;
+// with only_outdated, the cache is checked first and only the fields whose keys changed are collected
+void refresh_cache_detached(struct flags show, bool only_outdated) {
+  LOG_I("refreshing the cache in the background");
+  char lock_file[540];
+  if (!cache_path(lock_file, sizeof(lock_file) - 5)) return;
+  strcat(lock_file, ".lock");
+  fflush(stdout); // the child must not print the frame again
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid < 0) return;
+  if (pid > 0) { // the intermediate child exits right away, so the refresh is never a child of the shell
+    waitpid(pid, NULL, 0);
+    return;
+  }
+  if (setsid() < 0 || fork() != 0) _exit(0);
+  int null_fd = open("/dev/null", O_RDWR);
+  if (null_fd >= 0) {
+    dup2(null_fd, STDIN_FILENO);
+    dup2(null_fd, STDOUT_FILENO);
+    dup2(null_fd, STDERR_FILENO);
+    if (null_fd > STDERR_FILENO) close(null_fd);
+  }
+  // only one refresh at a time, the others would collect the same things
+  int lock_fd = open(lock_file, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (lock_fd < 0 || flock(lock_fd, LOCK_EX | LOCK_NB) != 0) _exit(0);
+  struct info fresh_info;
+  struct flags stale, cached, collect = show;
+  init_info(&fresh_info);
+  if (only_outdated && read_cache(&fresh_info, &stale, &cached)) {
+    bool *needed = (bool*)&collect, *outdated = (bool*)&stale;
+    for (size_t i = 0; i < sizeof(struct flags) / sizeof(bool); i++) needed[i] = needed[i] && outdated[i];
+    if (!(collect.os || collect.model || collect.kernel || collect.cpu || collect.gpu || collect.pkgs)) {
+      touch_motd_frame();
+      _exit(0);
+    }
+    get_info(collect, &fresh_info);
+    bool* collected = (bool*)&collect;
+    for (size_t i = 0; i < sizeof(struct flags) / sizeof(bool); i++) collected[i] = collected[i] || !outdated[i];
+  } else
+    get_info(show, &fresh_info);
+  write_cache(&fresh_info, collect);
+  save_collector_history();
+  _exit(0);
+}
+#endif
+
+#ifndef _WIN32
+// called by the package managers after a transaction: "<manager>:+" and "<manager>:-" read the installed or removed
+// package names on stdin (one per line) and update the stored count, "<manager>" counts everything again.
+// "<manager>:pre" runs before the transaction and notes whether the stored count is valid, the delta applies to no other
+int pkg_hook(const char* arg) {
+  LOG_I("running the package hook for %s", arg);
+  char pkgman[16] = "", marker[300];
+  int sign        = 0;
+  const char* mode = strchr(arg, ':');
+  snprintf(pkgman, sizeof(pkgman), "(%.*s)", mode ? (int)(mode - arg) : (int)strlen(arg), arg);
+  if (mode) sign = strcmp(mode, ":+") == 0 ? 1 : strcmp(mode, ":-") == 0 ? -1 : 0;
+  bool has_marker = runtime_path(marker, sizeof(marker), "pkg-hook.valid");
+
+  struct info user_info;
+  struct flags stale = {0}, cached = {0}, collected = {0};
+  init_info(&user_info);
+  bool cache_read = read_cache(&user_info, &stale, &cached);
+  if (mode && strcmp(mode, ":pre") == 0) {
+    // the marker holds the generation of the cache files, a cache written since then was not checked here
+    if (has_marker && cache_read && cached.pkgs && !stale.pkgs) {
+      char generation[32];
+      int len = snprintf(generation, sizeof(generation), "%llu", (unsigned long long)cache_generation(0));
+      write_cache_file(marker, generation, len, 0600);
+    } else if (has_marker)
+      unlink(marker);
+    free_info(&user_info);
+    return 0;
+  }
+  // the databases changed in the transaction, the keys of before it are only known through the marker
+  bool valid_before = false;
+  if (has_marker) {
+    char generation[32] = "";
+    FILE* marker_fp     = fopen(marker, "r");
+    if (marker_fp) {
+      valid_before = fgets(generation, sizeof(generation), marker_fp) &&
+                     strtoull(generation, NULL, 10) == (unsigned long long)cache_generation(0);
+      fclose(marker_fp);
+    }
+    unlink(marker);
+  }
+  int entry = -1;
+  for (int i = 0; i < user_info.pkgman_count && cache_read && cached.pkgs && valid_before; i++)
+    if (strcmp(user_info.pkgman_list[i], pkgman) == 0) entry = i;
+
+  int delta = 0;
+  if (sign != 0) {
+    char line[512];
+    while (fgets(line, sizeof(line), stdin))
+      if (line[0] != '\n' && line[strlen(line) - 1] == '\n') delta += sign;
+  }
+  // the delta only applies to a count that was valid before the transaction
+  if (entry >= 0 && sign != 0 && user_info.pkgman_pkgs[entry] + delta >= 0) {
+    LOG_I("applying a delta of %d to %s", delta, pkgman);
+    user_info.pkgman_pkgs[entry] += delta;
+    format_pkgman_name(&user_info);
+  } else {
+    LOG_I("counting the packages again");
+    get_info((struct flags){.pkgs = true}, &user_info);
+  }
+  // the other fields keep their own validity
+  if (cache_read) {
+    bool *valid = (bool*)&collected, *outdated = (bool*)&stale, *in_cache = (bool*)&cached;
+    for (size_t i = 0; i < sizeof(struct flags) / sizeof(bool); i++) valid[i] = in_cache[i] && !outdated[i];
+  }
+  collected.pkgs = true;
+  write_cache(&user_info, collected);
+  free_info(&user_info);
+  return 0;
+}
+#endif
+
+#ifdef __linux__
+struct sysroot_pool {
+  char** roots;
+  int root_count;
+  atomic_int next; // the workers take the next root when they are done, slow roots don't hold the others
+};
+
+static void* scan_sysroots_worker(void* argp) {
+  struct sysroot_pool* pool = argp;
+  int i;
+  while ((i = atomic_fetch_add(&pool->next, 1)) < pool->root_count) {
+    size_t len;
+    char* record = scan_sysroot(pool->roots[i], &len);
+    if (!record) continue;
+    fwrite(record, 1, len, stdout); // one call per record so that the lines are not mixed
+    free(record);
+  }
+  return 0;
+}
+
+// prints one NDJSON record per root, scanning them on every core
+int scan_sysroots(char** roots, int root_count) {
+  struct sysroot_pool pool = {roots, root_count, 0};
+  long cores               = sysconf(_SC_NPROCESSORS_ONLN);
+  int worker_count         = cores < 1 ? 1 : cores < root_count ? cores : root_count;
+  pthread_t workers[worker_count > 0 ? worker_count : 1];
+  int started = 0;
+  for (; started < worker_count; started++)
+    if (pthread_create(&workers[started], NULL, scan_sysroots_worker, &pool) != 0) break;
+  scan_sysroots_worker(&pool); // also the fallback if no thread could start
+  for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+  return 0;
+}
+#endif
+
+// a logo of res/ascii, with its placeholders already replaced by the colors
+struct logo {
+  const char* id; // distro id, the name of the file
+  const char* text;
+  size_t len;
+  int height; // lines to go up after printing it
+};
+#include "logos.h" // the logos sorted by id, generated by logopack at build time
+
+static int compare_logo(const void* id, const void* logo) {
+  return strcmp(id, ((const struct logo*)logo)->id);
+}
+
+// prints logo (as ascii art) of the given system to out, the freaky one if it has none.
+int print_ascii(FILE* out, struct info* user_info) {
+  const size_t logo_count = sizeof(logos) / sizeof(*logos);
+  const struct logo* logo = bsearch(user_info->os_name, logos, logo_count, sizeof(*logos), compare_logo);
+  if (!logo) logo = bsearch("freaky", logos, logo_count, sizeof(*logos), compare_logo);
+  if (!logo) {
+    LOG_E("No\nascii\nlogo\n\n\n\n\n");
+    return 7;
+  }
+  LOG_V(logo->id);
+  fwrite(logo->text, 1, logo->len, out);
+  return logo->height;
 }
 
 /* prints distribution list
@@ -673,6 +1098,9 @@ void usage(char* arg) {
   LOG_I("printing usage");
   printf("Usage: %s <args>\n"
          "    -c  --config        use custom config path\n"
+#ifdef __linux__
+         "        --daemon        keeps the info current in shared memory for the other runs (also as freakyfetchd)\n"
+#endif
          "    -h, --help          prints this help page\n"
 #ifndef __IPHONE__
          "    -i, --image         prints logo as image and use a custom image "
@@ -685,12 +1113,32 @@ void usage(char* arg) {
 #endif
          "                        read README.md for more info%s\n"
          "    -l, --list          lists all supported distributions\n"
+#ifndef _WIN32
+         "        --capture FILE  records every input read by this run in FILE, for --replay\n"
+#endif
+#ifndef _WIN32
+         "        --motd          prints a stored frame when nothing changed, for login scripts\n"
+#endif
+#ifndef _WIN32
+         "        --pkg-hook      updates the cached package count, run by the package manager hooks\n"
+#endif
+#ifdef __linux__
+         "        --sysroot       prints one NDJSON inventory line per root directory or image tarball given after the options\n"
+#endif
+#ifndef _WIN32
+         "        --timings[=FILE] prints how long every collector, command, cache access and render phase took on stderr,\n"
+         "                        or writes them as a chrome trace to FILE\n"
+#endif
          "    -V, --version       prints the current uwufetch version\n"
 #ifdef __DEBUG__
          "    -v, --verbose       logs everything\n"
 #endif
-         "    -w, --write-cache   writes to the cache file (~/.cache/uwufetch.cache)\n"
-         "    -r, --read-cache    reads from the cache file (~/.cache/uwufetch.cache)\n",
+         "    -w, --write-cache   collects everything again and rewrites the cache file (~/.cache/freakyfetch.cache)\n"
+         "    -r, --read-cache    prints from the cache file right away and refreshes it in the background\n"
+#ifndef _WIN32
+         "        --replay FILE   reads everything from a --capture file instead of this system\n"
+#endif
+         ,
          arg,
 #ifndef __IPHONE__
          BLUE,
@@ -700,16 +1148,33 @@ void usage(char* arg) {
          NORMAL);
 }
 
+#ifndef _WIN32
+static const char* timings_path = NULL; // set by --timings, empty for the summary on stderr
+
+static void report_timings(void) {
+  fflush(stdout);
+  if (!*timings_path)
+    print_timings(stderr);
+  else if (!write_timings_trace(timings_path))
+    fprintf(stderr, "could not write %s\n", timings_path);
+}
+#endif
+
 // the main function is on the bottom of the file to avoid double function declarations
 int main(int argc, char* argv[]) {
 #ifdef __DEBUG__
   verbose_enabled = get_verbose_handle();
 #endif
+  struct info user_info;
+  init_info(&user_info);
   struct user_config user_config_file = {0};
-  struct info user_info               = {0};
   struct configuration config_flags   = parse_config(&user_info, &user_config_file);
   char* custom_distro_name            = NULL;
   char* custom_image_name             = NULL;
+  bool motd                           = false; // print a stored frame when nothing it depends on changed
+  bool sysroot                        = false; // inventory the root directories in the arguments
+  const char* capture_path            = NULL;  // where the inputs of get_info() are recorded
+  const char* replay_path             = NULL;  // where they are served from instead of the system
 
 #ifdef _WIN32
   // packages disabled by default because chocolatey is too slow
@@ -719,11 +1184,32 @@ int main(int argc, char* argv[]) {
   int opt                      = 0;
   struct option long_options[] = {
       {"config", required_argument, NULL, 'c'},
+#ifdef __linux__
+      {"daemon", no_argument, NULL, 'D'},
+#endif
       {"distro", required_argument, NULL, 'd'},
       {"help", no_argument, NULL, 'h'},
       {"image", optional_argument, NULL, 'i'},
       {"list", no_argument, NULL, 'l'},
+#ifndef _WIN32
+      {"capture", required_argument, NULL, 'C'},
+#endif
+#ifndef _WIN32
+      {"motd", no_argument, NULL, 'M'},
+#endif
+#ifndef _WIN32
+      {"pkg-hook", required_argument, NULL, 'P'}, // no short option, only the package manager hooks use it
+#endif
       {"read-cache", no_argument, NULL, 'r'},
+#ifndef _WIN32
+      {"replay", required_argument, NULL, 'R'},
+#endif
+#ifdef __linux__
+      {"sysroot", no_argument, NULL, 'S'}, // the roots are the remaining arguments
+#endif
+#ifndef _WIN32
+      {"timings", optional_argument, NULL, 'T'}, // --timings=FILE for a trace file
+#endif
       {"version", no_argument, NULL, 'V'},
 #ifdef __DEBUG__
       {"verbose", no_argument, NULL, 'v'},
@@ -756,6 +1242,35 @@ int main(int argc, char* argv[]) {
     case 'l':
       list(argv[0]);
       return 0;
+#ifdef __linux__
+    case 'D':
+      return run_daemon(config_flags.show);
+#endif
+#ifndef _WIN32
+    case 'C':
+      capture_path = optarg;
+      break;
+    case 'M':
+      motd = true;
+      break;
+    case 'R':
+      replay_path = optarg;
+      break;
+    case 'P':
+      return pkg_hook(optarg);
+#endif
+#ifdef __linux__
+    case 'S':
+      sysroot = true;
+      break;
+#endif
+#ifndef _WIN32
+    case 'T':
+      if (!timings_path) atexit(report_timings); // the summary is printed whichever way main returns
+      timings_path = optarg ? optarg : "";
+      enable_timings();
+      break;
+#endif
     case 'r':
       user_config_file.read_enabled = true;
       break;
@@ -776,42 +1291,134 @@ int main(int argc, char* argv[]) {
     }
   }
 
-  if (user_config_file.read_enabled) {
-    // if no cache file found write to it
-    if (!read_cache(&user_info)) {
-      user_config_file.read_enabled  = false;
-      user_config_file.write_enabled = true;
-    } else {
-      int buf_sz = 256;
-      char buffer[buf_sz]; // line buffer
-      struct thread_varg vargp = {
-          buffer, &user_info, NULL, {true, true, true, true, true, true, true, true}};
-      if (config_flags.show.ram) get_ram(&vargp);
-      if (config_flags.show.uptime) {
-        LOG_I("getting additional not-cached info");
-        get_sys(&user_info);
-        get_upt(&vargp);
-      }
+#ifdef __linux__
+  if (sysroot) return scan_sysroots(argv + optind, argc - optind);
+  const char* program_name = strrchr(argv[0], '/') ? strrchr(argv[0], '/') + 1 : argv[0];
+  if (strcmp(program_name, "freakyfetchd") == 0) return run_daemon(config_flags.show);
+#endif
+#ifndef _WIN32
+  // recorded inputs stand for the whole system, nothing is taken from the caches or a daemon
+  bool recorded_inputs = capture_path || replay_path;
+  if (capture_path && !capture_inputs(capture_path)) return 1;
+  if (replay_path && !replay_inputs(replay_path)) {
+    fprintf(stderr, "%s: %s is not a capture file\n", argv[0], replay_path);
+    return 1;
+  }
+  // the durations of the collectors in earlier runs decide which ones get a thread
+  char history_file[512];
+  if (!recorded_inputs && history_path(history_file, sizeof(history_file))) load_collector_history(history_file);
+  // logins print the same frame over and over, it is rendered once and reused
+  uint64_t motd_key = 0;
+  if (motd && !recorded_inputs && !config_flags.show_image && !user_config_file.write_enabled && !custom_image_name) {
+    bool revalidate = false;
+    motd_key        = frame_key(&user_config_file, argc, argv);
+    int motd_span   = begin_span("cache", "print_motd_frame");
+    bool printed    = print_motd_frame(motd_key, &user_info, &revalidate);
+    end_span(motd_span);
+    if (printed) {
+      if (revalidate) refresh_cache_detached(config_flags.show, true);
+      return 0;
+    }
+  }
+#endif
+  struct flags collect = config_flags.show, stale = {0}, cached = {0};
+  bool use_cache       = config_flags.use_cache || user_config_file.read_enabled || user_config_file.write_enabled;
+#ifndef _WIN32
+  if (recorded_inputs) use_cache = false;
+#endif
+#ifdef __linux__
+  // a running daemon already has everything, only what is specific to this run is collected
+  int snapshot_span = begin_span("cache", "read_snapshot");
+  bool snapshot      = !user_config_file.write_enabled && !recorded_inputs && read_snapshot(&user_info, &stale);
+  end_span(snapshot_span);
+  if (snapshot) {
+    bool *show = (bool*)&config_flags.show, *outdated = (bool*)&stale, *needed = (bool*)&collect;
+    for (size_t i = 0; i < sizeof(struct flags) / sizeof(bool); i++) needed[i] = show[i] && outdated[i];
+    use_cache = false;
+  }
+#endif
+  int cache_span       = begin_span("cache", "read_cache");
+  bool cache_read      = use_cache && !user_config_file.write_enabled && read_cache(&user_info, &stale, &cached);
+  end_span(cache_span);
+  bool refresh         = false; // outdated fields are shown from the cache and collected again after printing
+  if (cache_read) { // only the fields that are shown and outdated (or never cached) are collected again
+    bool *show = (bool*)&config_flags.show, *outdated = (bool*)&stale, *needed = (bool*)&collect;
+    for (size_t i = 0; i < sizeof(struct flags) / sizeof(bool); i++) needed[i] = show[i] && outdated[i];
+#ifndef _WIN32
+    if (user_config_file.read_enabled) { // stale-while-revalidate: nothing that is in the cache is waited for
+  #define DEFER(field)                      \
+    if (collect.field && cached.field) {    \
+      collect.field = false;                \
+      refresh       = true;                 \
     }
+      DEFER(os) DEFER(model) DEFER(kernel) DEFER(cpu) DEFER(gpu) DEFER(pkgs)
+  #undef DEFER
+    }
+#endif
   }
-  if (!user_config_file.read_enabled)
-    get_info(config_flags.show, &user_info);
-  LOG_V(user_info.gpu_model[1]);
+#ifndef _WIN32
+  if (recorded_inputs)
+    get_info(collect, &user_info);
+  else
+    get_info_coalesced(&collect, &user_info);
+#else
+  get_info(collect, &user_info);
+#endif
+  LOG_V(user_info.gpu_count);
 
-  if (user_config_file.write_enabled) {
-    write_cache(&user_info);
+  // rewriting the cache only if a field tied to a cache key was collected again
+  if (use_cache && (!cache_read || collect.os || collect.model || collect.kernel || collect.cpu || collect.gpu || collect.pkgs)) {
+    bool *collected = (bool*)&collect, *outdated = (bool*)&stale;
+    if (cache_read) // the fields that were still valid stay valid
+      for (size_t i = 0; i < sizeof(struct flags) / sizeof(bool); i++) collected[i] = collected[i] || !outdated[i];
+    int write_span = begin_span("cache", "write_cache");
+    write_cache(&user_info, collect);
+    end_span(write_span);
   }
-  if (custom_distro_name) sprintf(user_info.os_name, "%s", custom_distro_name);
-  if (custom_image_name) sprintf(user_info.image_name, "%s", custom_image_name);
+  if (custom_distro_name) set_infof(&user_info, &user_info.os_name, "%s", custom_distro_name);
+  if (custom_image_name) set_infof(&user_info, &user_info.image_name, "%s", custom_image_name);
+
+  freakify_all(&user_info, config_flags.show);
 
-  freakify_all(&user_info);
+  FILE* out = stdout;
+#ifndef _WIN32
+  // in motd mode the frame is rendered in memory first, to be stored
+  char* frame              = NULL;
+  size_t frame_len         = 0;
+  struct frame_slots slots = {0};
+  if (motd_key != 0 && !(out = open_memstream(&frame, &frame_len))) out = stdout;
+#endif
 
   // print ascii or image and align cursor for print_info()
-  printf("\033[%dA", config_flags.show_image ? print_image(&user_info) : print_ascii(&user_info));
+  int logo_span = begin_span("render", config_flags.show_image ? "print_image" : "print_ascii");
+  fprintf(out, "\033[%dA", config_flags.show_image ? print_image(&user_info) : print_ascii(out, &user_info));
+  end_span(logo_span);
 
   // print info and move cursor down if the number of printed lines is smaller that the default image height
-  int to_move = 9 - print_info(&config_flags, &user_info);
-  printf("\033[%d%c", to_move < 0 ? -to_move : to_move, to_move < 0 ? 'A' : 'B');
+  int info_span = begin_span("render", "print_info");
+  int to_move   = 9 - print_info(out, &config_flags, &user_info, out != stdout ? &slots : NULL);
+  end_span(info_span);
+  fprintf(out, "\033[%d%c", to_move < 0 ? -to_move : to_move, to_move < 0 ? 'A' : 'B');
+#ifndef _WIN32
+  if (out != stdout && fclose(out) == 0) {
+    // the key is taken again, the cache files may have been replaced by this run
+    int frame_span = begin_span("cache", "write_motd_frame");
+    write_motd_frame(frame_key(&user_config_file, argc, argv), frame, frame_len, &slots);
+    end_span(frame_span);
+    fwrite(frame, 1, frame_len, stdout);
+  }
+  free(frame);
+#endif
+#ifndef _WIN32
+  if (!recorded_inputs) save_collector_history();
+  stop_collector_workers();
+  if (refresh) refresh_cache_detached(config_flags.show, false);
+  if (capture_path && !save_captured_inputs()) {
+    fprintf(stderr, "%s: could not write %s\n", argv[0], capture_path);
+    return 1;
+  }
+#endif
+  free_info(&user_info);
   LOG_I("Execution completed successfully!");
   return 0;
 }
@@ -0,0 +1,178 @@
+/*
+ *  freakyfetch is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// build step of freakyfetch: compiles the res/ascii/<id>.txt logos into logos.h, the table print_ascii() looks the
+// logos up in. Every placeholder becomes the color macro it stands for, so the compiler of freakyfetch joins each logo
+// into one string literal with the escape codes of its target, and printing a logo is a single fwrite.
+//   usage: logopack OUTPUT LOGO...
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// placeholders of the logos and the macros of freakyfetch.c they are replaced with
+static const struct {
+  const char *placeholder, *macro;
+} placeholders[] = {
+    {"{NORMAL}", "NORMAL"},
+    {"{BOLD}", "BOLD"},
+    {"{BLACK}", "BLACK"},
+    {"{RED}", "RED"},
+    {"{GREEN}", "GREEN"},
+    {"{SPRING_GREEN}", "SPRING_GREEN"},
+    {"{YELLOW}", "YELLOW"},
+    {"{BLUE}", "BLUE"},
+    {"{MAGENTA}", "MAGENTA"},
+    {"{CYAN}", "CYAN"},
+    {"{WHITE}", "WHITE"},
+    {"{PINK}", "PINK"},
+    {"{LPINK}", "LPINK"},
+    {"{BLOCK}", "BLOCK_CHAR"},
+    {"{BLOCK_VERTICAL}", "BLOCK_CHAR"},
+    {"{BACKGROUND_GREEN}", "BACKGROUND_GREEN"},
+    {"{BACKGROUND_RED}", "BACKGROUND_RED"},
+    {"{BACKGROUND_WHITE}", "BACKGROUND_WHITE"},
+};
+
+#define ID_CHARS "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789._-"
+
+struct logo {
+  char id[64]; // file name without the directory and .txt
+  const char* path;
+};
+
+static int compare_logos(const void* a, const void* b) {
+  return strcmp(((const struct logo*)a)->id, ((const struct logo*)b)->id);
+}
+
+// reads the whole file at path, NULL if it cannot
+static char* read_file(const char* path, size_t* len) {
+  FILE* in = fopen(path, "rb");
+  if (!in) return NULL;
+  size_t size = 4096;
+  char* text  = malloc(size);
+  *len        = 0;
+  for (size_t read; text && (read = fread(text + *len, 1, size - *len, in)) > 0;) {
+    *len += read;
+    if (*len == size) {
+      char* grown = realloc(text, size *= 2);
+      if (!grown) free(text);
+      text = grown;
+    }
+  }
+  if (text && ferror(in)) {
+    free(text);
+    text = NULL;
+  }
+  fclose(in);
+  return text;
+}
+
+// writes the logo at path as string literals and color macros, returns the lines the cursor goes up after it or -1
+static int write_logo(FILE* out, const char* path) {
+  size_t len;
+  char* text = read_file(path, &len);
+  if (!text) return -1;
+  int height      = 1; // the newline printed before the logo
+  bool in_literal = false;
+  fputs("\"\\n\"", out);
+  for (size_t pos = 0; pos < len; pos++) {
+    if (pos == 0 || text[pos - 1] == '\n') {
+      fputs("\n   ", out);
+      height++;
+    }
+    size_t i = 0, count = sizeof(placeholders) / sizeof(*placeholders);
+    for (; i < count; i++) {
+      size_t placeholder_len = strlen(placeholders[i].placeholder);
+      if (len - pos >= placeholder_len && memcmp(text + pos, placeholders[i].placeholder, placeholder_len) == 0) break;
+    }
+    if (i < count) {
+      fprintf(out, "%s %s", in_literal ? "\"" : "", placeholders[i].macro);
+      in_literal = false;
+      pos += strlen(placeholders[i].placeholder) - 1;
+      continue;
+    }
+    unsigned char c = text[pos];
+    if (!in_literal) fputs(" \"", out);
+    in_literal = true;
+    if (c == '"' || c == '\\')
+      fprintf(out, "\\%c", c);
+    else if (c == '\n')
+      fputs("\\n\"", out);
+    else if (c < 0x20 || c == 0x7f || c == '?') // octal escapes end after three digits, '?' avoids trigraphs
+      fprintf(out, "\\%03o", c);
+    else
+      fputc(c, out);
+    if (c == '\n') in_literal = false; // every line of the logo gets its own line in logos.h
+  }
+  if (in_literal) fputc('"', out);
+  fputs(" NORMAL", out); // the color is always reset, so the logos do not have to
+  free(text);
+  return height;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s OUTPUT LOGO...\n", argv[0]);
+    return 1;
+  }
+  int count          = argc - 2;
+  struct logo* logos = calloc(count, sizeof(*logos));
+  if (!logos) return 1;
+  for (int i = 0; i < count; i++) {
+    const char* path = argv[i + 2];
+    const char* name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    size_t len       = strlen(name);
+    if (len > 4 && strcmp(name + len - 4, ".txt") == 0) len -= 4;
+    if (len == 0 || len >= sizeof(logos[i].id) || strspn(name, ID_CHARS) < len) {
+      fprintf(stderr, "%s: bad logo name %s\n", argv[0], path);
+      return 1;
+    }
+    memcpy(logos[i].id, name, len);
+    logos[i].path = path;
+  }
+  // print_ascii() finds the ids with bsearch
+  qsort(logos, count, sizeof(*logos), compare_logos);
+
+  FILE* out = fopen(argv[1], "w");
+  if (!out) {
+    perror(argv[1]);
+    return 1;
+  }
+  int heights[count];
+  fprintf(out, "// generated by logopack from res/ascii, do not edit\n\n");
+  for (int i = 0; i < count; i++) {
+    fprintf(out, "static const char logo_%d[] = ", i);
+    if ((heights[i] = write_logo(out, logos[i].path)) < 0) {
+      perror(logos[i].path);
+      fclose(out);
+      remove(argv[1]); // make would take a partial table for an up to date one
+      return 1;
+    }
+    fprintf(out, ";\n\n");
+  }
+  fprintf(out, "static const struct logo logos[] = {\n");
+  for (int i = 0; i < count; i++)
+    fprintf(out, "    {\"%s\", logo_%d, sizeof(logo_%d) - 1, %d},\n", logos[i].id, i, i, heights[i]);
+  fprintf(out, "};\n");
+  if (fclose(out) != 0) {
+    perror(argv[1]);
+    remove(argv[1]);
+    return 1;
+  }
+  free(logos);
+  return 0;
+}